@@ -0,0 +1,57 @@
+#ifndef IC_ARENA
+#define IC_ARENA
+
+#include <stddef.h>
+
+// Арена - память одного задания (запроса сервера, изображения
+// пакетного режима, задачи планировщика), выделяемая сдвигом
+// указателя в заранее полученных блоках. По завершении задания
+// арена откатывается к отметке, блоки остаются за ней, поэтому
+// в установившемся режиме системный аллокатор не вызывается.
+// Арена принадлежит одному потоку
+typedef struct _Arena Arena;
+
+// Состояние арены для отката
+typedef struct {
+    void* chunk;
+    size_t used;
+} ArenaMark;
+
+// Размер блока арены по умолчанию
+#define IC_ARENA_CHUNK_SIZE (64 * 1024)
+
+// Создание арены с блоками по chunk_size байт (0 - по
+// умолчанию). Возвращает NULL при ошибке
+Arena* arena_create(size_t chunk_size);
+
+void arena_destroy(Arena* arena);
+
+// Выделение size байт с выравниванием 16. Возвращает NULL при
+// ошибке
+void* arena_alloc(Arena* arena, size_t size);
+
+// Отметка текущего состояния ({ NULL, 0 } для NULL)
+ArenaMark arena_mark(const Arena* arena);
+
+// Откат к отметке: всё выделенное после неё освобождается.
+// Для NULL ничего не делает
+void arena_rewind(Arena* arena, ArenaMark mark);
+
+// Арена текущего потока, из которой выделяет scratch_alloc.
+// Возвращает прежнюю арену потока
+Arena* arena_enter(Arena* arena);
+
+Arena* arena_current(void);
+
+// Временная память: из арены текущего потока, а без неё - из
+// системного аллокатора. Освобождается только scratch_free и
+// только в пределах задания, в котором выделена
+void* scratch_alloc(size_t size);
+
+void* scratch_calloc(size_t count, size_t size);
+
+// Освобождение временной памяти. Память арены возвращается
+// сразу, если это последнее выделение, иначе - при откате
+void scratch_free(void* pointer);
+
+#endif // !IC_ARENA
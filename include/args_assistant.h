@@ -3,14 +3,51 @@
 
 #include "filters.h"
 
+// Выход режима -multi: файл и цепочка, дающая его
+typedef struct {
+    const char* path;
+    Filter* chain;
+} OutputChain;
+
+// Параметры запуска, не относящиеся к фильтрам
+typedef struct {
+    int threads; // Число рабочих потоков (0 - по числу ядер)
+    int numa; // Привязать рабочие потоки к узлам NUMA
+    int parallel_io; // Читать и писать строки BMP полосами
+                     // рабочих потоков
+    int jobs; // Изображений в работе одновременно в пакетном
+              // режиме (0 - по числу потоков)
+    int io_uring; // Файлов в работе через io_uring в пакетном
+                  // режиме (0 - без io_uring)
+    int profile; // Печатать замеры стадий
+    const char* profile_json; // Файл для замеров в JSON или NULL
+    const char* trace; // Файл трассы Chrome или NULL
+    int counters; // Аппаратные счётчики в замерах стадий
+    const char* cache; // Каталог кэша результатов или NULL
+    int cache_size; // Предельный размер кэша, МБ (0 - по
+                    // умолчанию для режима)
+    int stage_cache; // Кэшировать промежуточные стадии цепочки
+    int max_memory; // Бюджет памяти, МБ (0 - без ограничения)
+    OutputChain* outputs; // Выходы режима -multi
+    int output_count;
+} Options;
+
 int parse_args(
     int argc,
     char** argv,
     char** ifile,
     char** ofile,
-    Filter** head
+    Filter** head,
+    Options* options
 );
 
+// Разбор цепочки фильтров из слов командной строки, например
+// { "-blur", "2", "-gs" }. Ошибки печатаются в stderr
+int parse_filter_chain(int count, char** words, Filter** head);
+
+// Освобождение цепочек выходов режима -multi
+void free_output_chains(Options* options);
+
 void printhelp();
 
 void printversion();
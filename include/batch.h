@@ -0,0 +1,34 @@
+#ifndef IC_BATCH
+#define IC_BATCH
+
+#include "execution.h"
+#include "filters.h"
+
+// Пакетная обработка: одна цепочка фильтров применяется ко всем
+// изображениям источника source, который может быть:
+//   - директорией (все файлы *.bmp в ней);
+//   - шаблоном с символами * ? [ (glob);
+//   - @файлом со списком путей, по одному в строке;
+//   - отдельным файлом.
+// Имена результатов строятся по шаблону output: %n - имя
+// входного файла без расширения, %f - имя с расширением, %i -
+// номер изображения, %% - знак процента. Шаблон без % считается
+// директорией, куда результаты пишутся под исходными именами.
+// Загрузка, обработка и сохранение идут конвейером: пока
+// изображения обрабатываются группами до jobs штук (0 - по числу
+// потоков) на потоках execution, отдельные потоки загружают
+// следующие и сохраняют предыдущие. С io_depth > 0 эти потоки
+// держат в работе до io_depth файлов через io_uring (uring.h),
+// если ядро его поддерживает. Ошибка в одном файле не прерывает
+// пакет. Возвращает число неудачных файлов или -1, если пакет не
+// удалось начать
+int batch_run(
+    const char* source,
+    const char* output,
+    Filter* filter_list,
+    const Execution* execution,
+    int jobs,
+    int io_depth
+);
+
+#endif // !IC_BATCH
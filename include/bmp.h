@@ -2,9 +2,12 @@
 #define BMP_READER_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 
+#include "scheduler.h"
+
 #pragma pack(push, 1) // Выключаем выравнивание структур для
                       // правильного чтения BMP
 
@@ -47,26 +50,165 @@ typedef struct {
 } RGBPixel;
 
 // Структура для представления BMP изображения
-typedef struct {
+typedef struct _BMPImage {
     BMPFileHeader file_header;
     BMPInfoHeader info_header;
     RGBPixel**
         pixels; // Двумерный массив пикселей [height][width]
+    size_t capacity;      // Вместимость буфера пикселей
+    int32_t row_capacity; // Вместимость массива строк
+    struct _BMPImage* parent; // Владелец пикселей, если это
+                              // представление (view)
 } BMPImage;
 
 #pragma pack(pop) // Восстанавливаем выравнивание
 
+// Прямоугольная область изображения. Координаты отсчитываются
+// от верхнего левого угла
+typedef struct {
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+} BMPRegion;
+
 // Функции для работы с BMP
 
 // Создание нового BMP изображения
 BMPImage* bmp_create(int32_t width, int32_t height);
 
+// Создание изображения без обнуления пикселей: содержимое не
+// определено, а страницы нового буфера еще не затронуты, и
+// первым к ним обращается тот поток, который их заполнит
+BMPImage*
+bmp_create_uninitialized(int32_t width, int32_t height);
+
+// Изменение размеров изображения без перевыделения памяти.
+// Новые размеры должны укладываться в вместимость буфера,
+// содержимое пикселей после вызова не определено
+int bmp_reshape(BMPImage* image, int32_t width, int32_t height);
+
+// Создание представления прямоугольной области изображения без
+// копирования пикселей. Координаты (x, y) отсчитываются от
+// верхнего левого угла. Представление забирает parent во
+// владение и освобождает его вместе с собой
+BMPImage* bmp_create_view(
+    BMPImage* parent,
+    int32_t x,
+    int32_t y,
+    int32_t width,
+    int32_t height
+);
+
+// Отделение представления: освобождает само представление и
+// возвращает владение исходным изображением
+BMPImage* bmp_detach_view(BMPImage* view);
+
+// Заимствующее представление области parent в структуре view,
+// строки которого размещаются в массиве rows. Ничего не
+// выделяет и ничем не владеет: view не освобождается через
+// bmp_free и не может быть приёмником. view и parent могут
+// совпадать
+void bmp_borrow_view(
+    BMPImage* view,
+    RGBPixel** rows,
+    const BMPImage* parent,
+    const BMPRegion* region
+);
+
 // Загрузка BMP изображения из файла
 BMPImage* bmp_load(const char* filename);
 
+// Загрузка только заданной области BMP изображения: читаются
+// лишь строки и столбцы, покрывающие область
+BMPImage*
+bmp_load_region(const char* filename, const BMPRegion* region);
+
+// То же, что bmp_load_region (region может быть NULL - всё
+// изображение), но строки читаются полосами рабочих потоков
+// scheduler через pread. Каждый поток распаковывает и первым
+// затрагивает ту полосу, которую потом получит в тайлах
+BMPImage* bmp_load_parallel(
+    const char* filename,
+    const BMPRegion* region,
+    Scheduler* scheduler
+);
+
+// Чтение заголовков BMP файла без загрузки пикселей
+int bmp_read_headers(
+    const char* filename,
+    BMPFileHeader* file_header,
+    BMPInfoHeader* info_header
+);
+
 // Сохранение BMP изображения в файл
 int bmp_save(BMPImage* image, const char* filename);
 
+// То же, что bmp_save, но строки большого изображения
+// упаковываются в отображение файла полосами рабочих потоков
+// scheduler (scheduler_parallel_bands)
+int bmp_save_parallel(
+    BMPImage* image,
+    const char* filename,
+    Scheduler* scheduler
+);
+
+// Копирование BMP файла без декодирования, если bmp_save после
+// bmp_load записал бы те же байты. Копирует ядро
+// (copy_file_range, sendfile). Возвращает ALL_OK при успехе и
+// IC_BMP_ERROR_NOT_CANONICAL, если файл нужно декодировать -
+// назначение тогда не тронуто
+int bmp_copy_file(const char* source, const char* destination);
+
+// Запись BMP файла частями строк, когда изображение целиком в
+// памяти не держится. Строки можно записывать в любом порядке,
+// результат совпадает с bmp_save для того же изображения
+typedef struct _BMPWriter BMPWriter;
+
+// Создание файла с заголовками file_header и info_header (поля
+// размеров пересчитываются по ширине и высоте). Возвращает NULL
+// при ошибке
+BMPWriter* bmp_writer_open(
+    const char* filename,
+    const BMPFileHeader* file_header,
+    const BMPInfoHeader* info_header
+);
+
+// Запись области source изображения image (шириной во весь
+// файл) в строки файла, начиная со строки row (сверху)
+int bmp_writer_rows(
+    BMPWriter* writer,
+    const BMPImage* image,
+    const BMPRegion* source,
+    int32_t row
+);
+
+// Закрытие файла. Возвращает ALL_OK, если все строки записаны
+int bmp_writer_close(BMPWriter* writer);
+
+// Декодирование BMP изображения из памяти. Возвращает NULL при
+// ошибке
+BMPImage* bmp_decode(const uint8_t* data, size_t size);
+
+// Декодирование только области region (NULL - всё изображение)
+// BMP изображения из памяти. Возвращает NULL при ошибке
+BMPImage* bmp_decode_region(
+    const uint8_t* data,
+    size_t size,
+    const BMPRegion* region
+);
+
+// Размер файла, который запишет bmp_save
+size_t bmp_encoded_size(const BMPImage* image);
+
+// Кодирование BMP изображения в буфер data размером не меньше
+// bmp_encoded_size(image)
+void bmp_encode_into(const BMPImage* image, uint8_t* data);
+
+// Кодирование BMP изображения в новый буфер *data (освобождается
+// free) размером *size. Содержимое совпадает с файлом bmp_save
+int bmp_encode(const BMPImage* image, uint8_t** data, size_t* size);
+
 // Очистка памяти, занятой изображением
 void bmp_free(BMPImage* image);
 
@@ -0,0 +1,57 @@
+#ifndef IC_BUDGET
+#define IC_BUDGET
+
+#include <stdint.h>
+
+#include "execution.h"
+#include "filters.h"
+
+// Выполнение цепочки в пределах бюджета памяти. Планировщик
+// оценивает пиковую память буферов (вход, второй буфер, рабочие
+// буферы тайлов в каждом потоке и собственная память фильтров)
+// и выбирает способ выполнения, сторону тайла и число потоков
+
+// Способ выполнения цепочки
+typedef enum {
+    BUDGET_WHOLE, // Изображение (область интереса) целиком
+    BUDGET_BANDS  // Полосами строк результата: каждая полоса
+                  // загружается с полями, проходит цепочку и
+                  // сразу записывается в файл
+} BudgetMode;
+
+typedef struct {
+    BudgetMode mode;
+    int threads;       // Рабочих потоков
+    int tile_size;     // Сторона тайла
+    int32_t band_rows; // Строк результата в полосе (BUDGET_BANDS)
+    uint64_t estimate; // Оценка пиковой памяти буферов, байт
+} BudgetPlan;
+
+// Планирование цепочки head для изображения width x height в
+// пределах budget байт при не более чем threads потоках.
+// Предпочитается выполнение целиком, при нехватке памяти
+// сначала уменьшается тайл, затем число потоков, затем
+// изображение делится на полосы. Возвращает 0 при успехе; если
+// бюджета не хватает ни на что, в plan->estimate записывается
+// наименьшая оценка
+int budget_plan(
+    const Filter* head,
+    int32_t width,
+    int32_t height,
+    uint64_t budget,
+    int threads,
+    BudgetPlan* plan
+);
+
+// Выполнение цепочки полосами: результат для ifile записывается
+// в path без изображения целиком в памяти. Ошибки печатаются в
+// stderr. Возвращает 0 при успехе
+int budget_run_bands(
+    const char* ifile,
+    const char* path,
+    Filter* filter_list,
+    const BudgetPlan* plan,
+    const Execution* execution
+);
+
+#endif // !IC_BUDGET
@@ -0,0 +1,104 @@
+#ifndef IC_CACHE
+#define IC_CACHE
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "filters.h"
+#include "hash.h"
+
+// Кэш результатов на диске. Ключ - хеш пикселей и заголовков
+// входного изображения и канонической записи цепочки фильтров,
+// значение - готовый выходной файл. Записи добавляются
+// атомарным переименованием, поэтому кэш можно делить между
+// параллельно работающими процессами. Размер ограничивается
+// вытеснением давно не использованных записей
+
+// Версия формата ключа. Увеличивается при изменении результата
+// любого фильтра, чтобы старые записи перестали совпадать
+#define IC_CACHE_VERSION 1
+
+// Размер кэша по умолчанию, МБ
+#define IC_CACHE_DEFAULT_SIZE 1024
+
+typedef struct {
+    char hex[33];   // 128 бит в шестнадцатеричной записи
+    int64_t pixels; // Пикселей во входном изображении
+} CacheKey;
+
+// Потоковое вычисление ключа из произвольных данных
+typedef struct {
+    Hash64 low;
+    Hash64 high;
+} CacheHasher;
+
+void cache_hasher_init(CacheHasher* hasher);
+
+void cache_hasher_update(
+    CacheHasher* hasher,
+    const void* data,
+    size_t size
+);
+
+void cache_hasher_int(CacheHasher* hasher, int32_t value);
+
+// Поля заголовков, которые копируются в выходной файл: все,
+// кроме размеров, пересчитываемых при сохранении, и полей,
+// значения которых проверяются при загрузке
+void cache_hasher_headers(
+    CacheHasher* hasher,
+    const BMPFileHeader* file_header,
+    const BMPInfoHeader* info_header
+);
+
+// Каноническая запись одного фильтра цепочки
+void cache_hasher_filter(CacheHasher* hasher, const Filter* filter);
+
+// Ключ по данным, поданным на текущий момент. Поле pixels не
+// заполняется
+void cache_hasher_key(const CacheHasher* hasher, CacheKey* key);
+
+// Вычисление ключа для входного файла и цепочки фильтров.
+// Возвращает 0 при успехе
+int cache_key(
+    const char* input,
+    const Filter* filter_list,
+    CacheKey* key
+);
+
+// Копирование записи key в output. Возвращает 0, если запись
+// нашлась и скопирована
+int cache_fetch(
+    const char* directory,
+    const CacheKey* key,
+    const char* output
+);
+
+// Добавление готового файла output под ключом key и вытеснение
+// старых записей сверх max_bytes. Возвращает 0 при успехе
+int cache_store(
+    const char* directory,
+    const CacheKey* key,
+    const char* output,
+    uint64_t max_bytes
+);
+
+// Чтение записи key в новый буфер *data (освобождается free).
+// Возвращает 0, если запись нашлась
+int cache_read(
+    const char* directory,
+    const CacheKey* key,
+    uint8_t** data,
+    size_t* size
+);
+
+// Добавление блока данных под ключом key, как в cache_store
+int cache_write(
+    const char* directory,
+    const CacheKey* key,
+    const uint8_t* data,
+    size_t size,
+    uint64_t max_bytes
+);
+
+#endif // !IC_CACHE
@@ -17,13 +17,15 @@ void kernel_free(Kernel* w);
 void kernel_print(Kernel* w);
 
 void convolute_pixel(
-    BMPImage* iimage,
+    const BMPImage* iimage,
     BMPImage* oimage,
     Kernel* w,
     int32_t i,
     int32_t j
 );
 
-BMPImage* convolute(BMPImage* iimage, Kernel* w);
+// Свёртка iimage с ядром w с записью результата в oimage.
+// Приёмник должен вмещать изображение размера iimage
+int convolute(const BMPImage* iimage, BMPImage* oimage, Kernel* w);
 
 #endif // !CONVOLUTION_H
@@ -0,0 +1,38 @@
+#ifndef IC_COUNTERS
+#define IC_COUNTERS
+
+#include <stdint.h>
+
+// Аппаратные счётчики производительности (perf_event_open в
+// Linux). Счётчики открываются для каждого потока отдельно, а
+// читаются суммой по всем потокам процесса. Если система их не
+// предоставляет (нет прав, контейнер, другая ОС), замеры просто
+// не ведутся
+
+// Значения счётчиков
+typedef struct {
+    uint64_t cycles;
+    uint64_t instructions;
+    uint64_t cache_misses; // Промахи последнего уровня кэша
+    uint64_t branch_misses;
+} CounterValues;
+
+// Включение счётчиков и открытие их для текущего потока.
+// Возвращает 0 при успехе, иначе описание причины можно получить
+// через counters_error
+int counters_start(void);
+
+// Причина недоступности счётчиков
+const char* counters_error(void);
+
+// Открытие счётчиков для текущего потока, если они включены.
+// Вызывается потоками, созданными после counters_start
+void counters_attach_thread(void);
+
+// Сумма счётчиков всех потоков
+void counters_read(CounterValues* values);
+
+// Закрытие всех счётчиков
+void counters_stop(void);
+
+#endif // !IC_COUNTERS
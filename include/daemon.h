@@ -0,0 +1,19 @@
+#ifndef IC_DAEMON
+#define IC_DAEMON
+
+#include "execution.h"
+
+// Режим сервера: прием запросов через Unix domain socket на
+// пути socket_path. Запрос - строка вида
+//   <input.bmp> <output.bmp> [фильтры как в командной строке]
+// Ответ - строка
+//   OK load=<мс> filter=<мс> save=<мс> total=<мс>
+// или
+//   ERROR <описание>
+// Соединение может передавать запросы один за другим, каждое
+// обслуживается своим потоком, а фильтры выполняются на общих
+// рабочих потоках execution. Работа завершается по SIGINT или
+// SIGTERM. Возвращает 0 при штатном завершении
+int daemon_run(const char* socket_path, const Execution* execution);
+
+#endif // !IC_DAEMON
@@ -0,0 +1,45 @@
+#ifndef IC_DAG
+#define IC_DAG
+
+#include "bmp.h"
+#include "execution.h"
+#include "filters.h"
+#include "roi.h"
+
+// Несколько цепочек фильтров с общим входом, объединённые в
+// дерево по общим префиксам. Каждый общий префикс выполняется
+// один раз, после чего результат расходится по ветвям. Буфер
+// стадии освобождается (или передаётся дальше), как только его
+// забирает последний потребитель
+typedef struct _Dag Dag;
+
+Dag* dag_create(void);
+
+// Добавление цепочки chain с результатом в файл output. Цепочка
+// копируется. Возвращает 0 при успехе
+int dag_add(Dag* dag, const char* output, const Filter* chain);
+
+// Загрузка входного изображения: декодируется только область,
+// нужная хотя бы одной из цепочек
+BMPImage* dag_load(
+    const Dag* dag,
+    const char* filename,
+    RoiWindow* window,
+    BMPRegion* region
+);
+
+// Выполнение всех цепочек. Забирает image во владение.
+// Возвращает число выходов, которые не удалось получить
+int dag_run(
+    Dag* dag,
+    BMPImage* image,
+    const RoiWindow* window,
+    const Execution* execution
+);
+
+// Число стадий в дереве и сумма длин всех цепочек
+void dag_stats(const Dag* dag, int* stages, int* requested);
+
+void dag_free(Dag* dag);
+
+#endif // !IC_DAG
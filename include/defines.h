@@ -24,6 +24,23 @@
 #define IC_ARGV_HELP "-help"
 #define IC_ARGV_VERSION "-version"
 #define IC_ARGV_INFO "-info"
+#define IC_ARGV_THREADS "-threads"
+#define IC_ARGV_NUMA "-numa"
+#define IC_ARGV_PARALLEL_IO "-parallel-io"
+#define IC_ARGV_IO_URING "-io-uring"
+#define IC_ARGV_BATCH "-batch"
+#define IC_ARGV_JOBS "-jobs"
+#define IC_ARGV_SERVE "-serve"
+#define IC_ARGV_MULTI "-multi"
+#define IC_ARGV_OUTPUT "-o"
+#define IC_ARGV_PROFILE "-profile"
+#define IC_ARGV_PROFILE_JSON "-profile-json"
+#define IC_ARGV_TRACE "-trace"
+#define IC_ARGV_COUNTERS "-counters"
+#define IC_ARGV_CACHE "-cache"
+#define IC_ARGV_CACHE_SIZE "-cache-size"
+#define IC_ARGV_STAGE_CACHE "-stage-cache"
+#define IC_ARGV_MAX_MEMORY "-max-memory"
 
 // Корректные коды возврата
 #define ALL_OK 0b0
@@ -42,9 +59,19 @@
 #define IC_BMP_ERROR_WRITING_HEADER 0b10011
 #define IC_BMP_ERROR_ALLOCATING_BUFFER 0b10101
 #define IC_BMP_ERROR_WRITING_ROW 0b10111
+#define IC_BMP_ERROR_NOT_CANONICAL 0b11011
+
+// Ошибки работы с буферами изображений
+#define IC_BMP_ERROR_CAPACITY 0b11001
 
 // Ошибки ядра
-#define IC_ERROR_KERNEL_FAILURE 0b100001;
+#define IC_ERROR_KERNEL_FAILURE 0b100001
+
+// Ошибки библиотеки
+#define IC_ERROR_INVALID_ARGUMENT 0b100011
+#define IC_ERROR_INVALID_CHAIN 0b100101
+#define IC_ERROR_DECODING 0b100111
+#define IC_ERROR_FILTER_FAILURE 0b101001
 
 // Результаты обработки аргументов
 #define IC_ARGS_ASSISTANT_OK 0b00
@@ -52,6 +79,9 @@
 #define IC_ARGS_ASSISTANT_VERSION 0b10
 #define IC_ARGS_ASSISTANT_INFO 0b11
 #define IC_ARGS_ASSISTANT_ERROR 0b100
+#define IC_ARGS_ASSISTANT_BATCH 0b101
+#define IC_ARGS_ASSISTANT_SERVE 0b110
+#define IC_ARGS_ASSISTANT_MULTI 0b111
 
 // Сообщения о сообщениях об ошибках
 #define IC_MESSAGE_ERROR_OPENING_FILE "IC_ERROR_OPENING_FILE"
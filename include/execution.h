@@ -0,0 +1,30 @@
+#ifndef IC_EXECUTION
+#define IC_EXECUTION
+
+#include "bmp.h"
+#include "filters.h"
+#include "profile.h"
+#include "roi.h"
+#include "scheduler.h"
+#include "stage_cache.h"
+
+// Параметры выполнения цепочки фильтров
+typedef struct {
+    Scheduler* scheduler; // Потоки для тайлов (NULL - один поток)
+    int quiet; // Не печатать сообщения о стадиях и ошибках
+    Profile* profile; // Замеры стадий (NULL - без замеров)
+    StageCache* stages; // Кэш префиксов цепочки (NULL - без него)
+    int tile_size; // Сторона тайла (0 - IC_TILE_SIZE)
+} Execution;
+
+// Применение цепочки к буферу, занимающему окно кадра. Окно
+// обновляется по мере обрезки, execution может быть NULL.
+// Реализация в filters.c
+int apply_filters_window(
+    BMPImage** image,
+    Filter* filter_list,
+    RoiWindow* window,
+    const Execution* execution
+);
+
+#endif // !IC_EXECUTION
@@ -2,19 +2,10 @@
 #define IC_FILTERS
 
 #include "bmp.h"
+#include "scheduler.h"
 #include <stdint.h>
 
-#define MAX_FILTER_PARAMS 3
-
-// Наименования фильтров
-#define IC_ARGV_FILTER_CROP "-crop"
-#define IC_ARGV_FILTER_GS "-gs"
-#define IC_ARGV_FILTER_NEG "-neg"
-#define IC_ARGV_FILTER_SHARP "-sharp"
-#define IC_ARGV_FILTER_EDGE "-edge"
-#define IC_ARGV_FILTER_BLUR "-blur"
-#define IC_ARGV_FILTER_MED "-med"
-#define IC_ARGV_FILTER_CRYSTAL "-crystal"
+#define MAX_FILTER_PARAMS 4
 
 // Хеши аргументов (порядок важен!)
 // TODO: Использовать настоящие хеш-функции
@@ -38,20 +29,58 @@ typedef struct _Filter {
 // Функции для работы с фильтрами
 void free_filter_list(Filter* head);
 
-// Функции фильтров
-BMPImage* filter_crop(BMPImage* image, int width, int height);
+// Функции фильтров. Фильтры, меняющие окрестность пикселя,
+// пишут результат в переданный приёмник, вместимость которого
+// должна быть не меньше размеров результата. Обрезка забирает
+// изображение во владение и возвращает его представление
+BMPImage* filter_crop(
+    BMPImage* image,
+    int x,
+    int y,
+    int width,
+    int height
+);
 int filter_grayscale(BMPImage* image);
 int filter_negative(BMPImage* image);
-int filter_sharpening(BMPImage* image);
-BMPImage*
-filter_edge_detection(BMPImage* image, float threshold);
-BMPImage* filter_gaussian_blur(BMPImage* image, float sigma);
-BMPImage* filter_median(BMPImage* image, int window);
-BMPImage* filter_crystallize(BMPImage* image, float center_x, float center_y, float radius);
+int filter_sharpening(const BMPImage* image, BMPImage* result);
+int filter_edge_detection(
+    const BMPImage* image,
+    BMPImage* edges,
+    float threshold
+);
+int filter_gaussian_blur(
+    const BMPImage* image,
+    BMPImage* blurred,
+    float sigma
+);
+int filter_median(
+    const BMPImage* image,
+    BMPImage* result,
+    int window
+);
+int filter_crystallize(
+    const BMPImage* image,
+    BMPImage* result,
+    float center_x,
+    float center_y,
+    float radius,
+    Scheduler* scheduler
+);
+
+// Память, которую filter_crystallize выделяет сверх приёмника
+uint64_t filter_crystallize_workspace(
+    int32_t width,
+    int32_t height,
+    float radius,
+    int workers
+);
 
 // Основная функция применения цепочки фильтров
 int apply_filters(BMPImage** image, Filter* filter_list);
 
+// Размер ядра Гаусса для заданного sigma
+int filter_gaussian_kernel_size(float sigma);
+
 // Вспомогательные функции
 float rgb_to_grayscale(uint8_t r, uint8_t g, uint8_t b);
 uint8_t clamp_float_to_uint8(float value);
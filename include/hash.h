@@ -0,0 +1,28 @@
+#ifndef IC_HASH
+#define IC_HASH
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 64-битный некриптографический хеш по алгоритму XXH64. Данные
+// можно подавать частями: результат не зависит от того, как они
+// разбиты
+
+typedef struct {
+    uint64_t total_length;
+    uint64_t lanes[4];
+    uint8_t buffer[32]; // Хвост, не набравший полного блока
+    uint32_t buffered;
+    uint64_t seed;
+} Hash64;
+
+void hash64_init(Hash64* state, uint64_t seed);
+
+void hash64_update(Hash64* state, const void* data, size_t size);
+
+uint64_t hash64_digest(const Hash64* state);
+
+// Хеш блока данных целиком
+uint64_t hash64(const void* data, size_t size, uint64_t seed);
+
+#endif // !IC_HASH
@@ -0,0 +1,55 @@
+#ifndef IC_LIBIMAGECRAFT
+#define IC_LIBIMAGECRAFT
+
+// Интерфейс библиотеки libimagecraft. Функции ничего не печатают
+// в stdout, не завершают процесс и возвращают ALL_OK или код
+// ошибки из defines.h. Цепочку фильтров и планировщик можно
+// использовать из нескольких потоков одновременно: при
+// применении они только читаются
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bmp.h"
+#include "defines.h"
+#include "execution.h"
+#include "filters.h"
+
+// Разбор цепочки фильтров из строки в синтаксисе командной
+// строки, например "-blur 2 -med 3 -gs". Ошибки разбора
+// печатаются в stderr
+int imagecraft_parse_chain(const char* text, Filter** chain);
+
+// Освобождение цепочки фильтров
+void imagecraft_free_chain(Filter* chain);
+
+// Применение цепочки к изображению. *image может быть заменено
+// другим изображением, старое при этом освобождается. execution
+// может быть NULL (выполнение в текущем потоке)
+int imagecraft_apply(
+    BMPImage** image,
+    Filter* chain,
+    const Execution* execution
+);
+
+// Декодирование BMP из памяти, применение цепочки и
+// кодирование результата в новый буфер *output (освобождается
+// free)
+int imagecraft_process_memory(
+    const uint8_t* input,
+    size_t input_size,
+    Filter* chain,
+    const Execution* execution,
+    uint8_t** output,
+    size_t* output_size
+);
+
+// Обработка файла: декодируется только нужная цепочке область
+int imagecraft_process_file(
+    const char* input,
+    const char* output,
+    Filter* chain,
+    const Execution* execution
+);
+
+#endif // !IC_LIBIMAGECRAFT
@@ -1,10 +1,16 @@
 #ifndef IC_PATHS
 #define IC_PATHS
 
+#include <stddef.h>
+
 char* ic_strdup(const char* s);
 
 int create_output_directory_recursive(const char* path);
 
-char* get_directory_from_path(const char* filepath);
+char* get_directory_from_path(
+    const char* filepath,
+    char* dir,
+    size_t size
+);
 
 #endif // !IC_PATHS
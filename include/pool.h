@@ -0,0 +1,40 @@
+#ifndef IC_POOL
+#define IC_POOL
+
+#include <stddef.h>
+
+// Пул буферов изображений, общий для всех потоков. Размеры
+// округляются до классов: степени двойки до IC_POOL_HUGE_PAGE,
+// дальше - кратные IC_POOL_HUGE_PAGE. Освобожденный блок
+// остается в пуле и выдается следующему запросу того же класса,
+// поэтому задания с изображениями одного размера не обращаются
+// к системному аллокатору. Блоки от IC_POOL_HUGE_PAGE выровнены
+// по IC_POOL_HUGE_PAGE и помечены для прозрачных больших страниц
+
+// Размер большой страницы
+#define IC_POOL_HUGE_PAGE ((size_t)2 * 1024 * 1024)
+
+// Предел памяти, удерживаемой пулом, по умолчанию (МБ)
+#ifndef IC_POOL_LIMIT_MB
+#define IC_POOL_LIMIT_MB 256
+#endif
+
+// Размер блока, выделяемого под bytes байт
+size_t pool_block_size(size_t bytes);
+
+// Блок не меньше bytes байт (ровно pool_block_size(bytes)).
+// Возвращает NULL при ошибке
+void* pool_acquire(size_t bytes);
+
+// Возврат блока в пул. bytes - любой размер того же класса,
+// например запрошенный при выделении
+void pool_release(void* block, size_t bytes);
+
+// Предел удерживаемой пулом памяти в байтах. Лишние блоки
+// возвращаются системе
+void pool_set_limit(size_t bytes);
+
+// Возврат системе всех удерживаемых блоков
+void pool_trim(void);
+
+#endif // !IC_POOL
@@ -0,0 +1,66 @@
+#ifndef IC_PROFILE
+#define IC_PROFILE
+
+#include <stdint.h>
+
+#include "counters.h"
+
+#define PROFILE_NAME_SIZE 128
+
+// Замеры одной стадии: загрузки, фильтра (или отрезка фильтров,
+// выполненного по тайлам) или сохранения
+typedef struct {
+    char name[PROFILE_NAME_SIZE];
+    double wall_ms; // Время по часам
+    double cpu_ms;  // Процессорное время всех потоков процесса
+    int64_t heap_bytes; // Изменение занятой кучи за стадию
+    int64_t peak_rss_kb; // Пиковый RSS процесса после стадии
+    int64_t pixels;     // Обработано пикселей
+    int has_hardware;   // Аппаратные счётчики замерены
+    CounterValues hardware; // Приращение счётчиков за стадию
+} ProfileStage;
+
+// Профиль запуска. Не потокобезопасен: стадии замеряются по
+// очереди из одного потока
+typedef struct {
+    ProfileStage* stages;
+    int count;
+    int capacity;
+    int hardware; // Вести аппаратные счётчики (counters_start)
+
+    // Начало текущего замера
+    double wall_start;
+    double cpu_start;
+    int64_t heap_start;
+    CounterValues hardware_start;
+} Profile;
+
+// Значение heap_bytes и peak_rss_kb, если система его не
+// сообщает
+#define PROFILE_UNKNOWN INT64_MIN
+
+void profile_init(Profile* profile);
+
+void profile_free(Profile* profile);
+
+// Начало замера стадии
+void profile_begin(Profile* profile);
+
+// Завершение замера стадии name. Возвращает 0 при успехе
+int profile_end(
+    Profile* profile,
+    const char* name,
+    int64_t pixels
+);
+
+// Пиковый RSS процесса за всё время работы в КБ или
+// PROFILE_UNKNOWN
+int64_t profile_peak_rss_kb(void);
+
+// Таблица стадий в stdout
+void profile_print(const Profile* profile);
+
+// Запись профиля в JSON файл. Возвращает 0 при успехе
+int profile_write_json(const Profile* profile, const char* path);
+
+#endif // !IC_PROFILE
@@ -0,0 +1,109 @@
+#ifndef IC_REGISTRY
+#define IC_REGISTRY
+
+#include "bmp.h"
+#include "filters.h"
+#include "scheduler.h"
+#include <stdint.h>
+
+// Вид зависимости пикселя результата от входного изображения
+typedef enum {
+    FILTER_KIND_POINT,        // Только от пикселя в той же точке
+    FILTER_KIND_NEIGHBORHOOD, // От окрестности радиуса radius
+    FILTER_KIND_GLOBAL        // От всего изображения
+} FilterKind;
+
+// Тип параметра фильтра
+typedef enum {
+    FILTER_PARAM_INT,  // Целое число
+    FILTER_PARAM_FIXED // Дробное число, хранится умноженным на
+                       // FILTER_FIXED_SCALE
+} FilterParamType;
+
+#define FILTER_FIXED_SCALE 1000
+
+// Ограничения на значение параметра
+#define FILTER_PARAM_ANY 0b000
+#define FILTER_PARAM_POSITIVE 0b001
+#define FILTER_PARAM_NON_NEGATIVE 0b010
+#define FILTER_PARAM_ODD 0b100
+
+// Описание параметра фильтра
+typedef struct {
+    const char* name;
+    FilterParamType type;
+    int constraints;
+    int minimum; // Наименьшее значение в единицах хранения (0 -
+                 // без проверки)
+} FilterParam;
+
+// Описание фильтра: всё, что планировщику, ROI и разбору
+// аргументов нужно знать о нём
+typedef struct {
+    const char* name; // Аргумент командной строки
+    int type;         // ARGV_TYPE_FILTER_*
+
+    // Схема параметров. Короткая форма из min_param_count
+    // значений заполняет последние параметры, остальные равны 0
+    int param_count;
+    int min_param_count;
+    FilterParam params[MAX_FILTER_PARAMS];
+
+    FilterKind kind;
+    int in_place; // Работает на месте, приёмник не нужен
+    int resizes;  // Результат - область входа другого размера
+
+    // Радиус окрестности (для FILTER_KIND_NEIGHBORHOOD)
+    int (*radius)(const Filter* filter);
+
+    // Область кадра frame_width x frame_height, которая
+    // становится результатом (для resizes). Возвращает 0 при
+    // успехе
+    int (*output_region)(
+        const Filter* filter,
+        int32_t frame_width,
+        int32_t frame_height,
+        BMPRegion* region
+    );
+
+    // Применение с записью в приёмник (для !in_place).
+    // Глобальные фильтры могут делить работу между потоками
+    // scheduler (NULL - выполнение в текущем потоке)
+    int (*apply)(
+        const BMPImage* image,
+        BMPImage* result,
+        const Filter* filter,
+        Scheduler* scheduler
+    );
+
+    // Применение на месте (для in_place && !resizes)
+    int (*apply_in_place)(BMPImage* image, const Filter* filter);
+    // Память сверх приёмника, которую фильтр выделяет для
+    // изображения width x height при workers потоках, байт
+    // (NULL - пренебрежимо мала)
+    uint64_t (*workspace)(
+        const Filter* filter,
+        int32_t width,
+        int32_t height,
+        int workers
+    );
+} FilterDescriptor;
+
+// Поиск описания по аргументу командной строки
+const FilterDescriptor* filter_registry_find(const char* name);
+
+// Поиск описания по типу фильтра
+const FilterDescriptor* filter_registry_get(int type);
+
+// Число зарегистрированных фильтров и доступ по индексу
+int filter_registry_count(void);
+const FilterDescriptor* filter_registry_at(int index);
+
+// Радиус фильтра, зависящего от всего изображения
+#define FILTER_RADIUS_GLOBAL -1
+
+// Радиус окрестности фильтра с учетом его вида: 0 для
+// поточечных, FILTER_RADIUS_GLOBAL для глобальных
+int filter_radius(const Filter* filter);
+
+#endif // !IC_REGISTRY
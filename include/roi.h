@@ -0,0 +1,83 @@
+#ifndef IC_ROI
+#define IC_ROI
+
+#include "bmp.h"
+#include "filters.h"
+#include <stdint.h>
+
+// Положение обрабатываемого буфера внутри кадра - полного
+// изображения, которое получилось бы на текущей стадии цепочки
+typedef struct {
+    int32_t x; // Смещение буфера в кадре
+    int32_t y;
+    int32_t frame_width; // Размеры кадра
+    int32_t frame_height;
+} RoiWindow;
+
+// Расширение области на радиус с обрезкой по границам кадра
+void roi_grow_region(
+    BMPRegion* region,
+    int radius,
+    int32_t frame_width,
+    int32_t frame_height
+);
+
+// Планирование области интереса: обход цепочки с конца и
+// вычисление области исходного изображения, которая нужна для
+// результата. Возвращает 1, если область меньше изображения
+int roi_plan(
+    const Filter* head,
+    int32_t width,
+    int32_t height,
+    BMPRegion* region
+);
+
+// Планирование для части результата: область исходного
+// изображения, нужная для области area кадра результата (NULL -
+// весь результат). Размеры кадра результата записываются в
+// result_width и result_height, если они не NULL. Возвращает 0
+// при успехе
+int roi_plan_area(
+    const Filter* head,
+    int32_t width,
+    int32_t height,
+    const BMPRegion* area,
+    BMPRegion* region,
+    int32_t* result_width,
+    int32_t* result_height
+);
+
+// Обрезка в окне: переводит область кадра crop, которая станет
+// результатом стадии, в координаты буфера и обновляет окно под
+// кадр результата. Возвращает 0 при успехе
+int roi_crop_window(
+    RoiWindow* window,
+    int32_t buffer_width,
+    int32_t buffer_height,
+    const BMPRegion* crop,
+    BMPRegion* view
+);
+
+// Загрузка изображения для цепочки head: декодируется только
+// область region, нужная результату, окно описывает её
+// положение в кадре. Строки читают рабочие потоки scheduler
+// (bmp_load_parallel) или текущий поток при NULL. Возвращает
+// NULL при ошибке
+BMPImage* roi_load(
+    const char* filename,
+    const Filter* head,
+    RoiWindow* window,
+    BMPRegion* region,
+    Scheduler* scheduler
+);
+
+// То же, что roi_load, для файла, уже прочитанного в память
+BMPImage* roi_decode(
+    const uint8_t* data,
+    size_t size,
+    const Filter* head,
+    RoiWindow* window,
+    BMPRegion* region
+);
+
+#endif // !IC_ROI
@@ -0,0 +1,65 @@
+#ifndef IC_SCHEDULER
+#define IC_SCHEDULER
+
+// Планировщик задач с перехватом работы (work stealing): у
+// каждого рабочего потока своя двусторонняя очередь, из хвоста
+// которой он берёт задачи сам, а простаивающие потоки крадут
+// задачи из головы очереди случайно выбранного соседа
+
+// Функция задачи: index - номер задачи в группе, worker - номер
+// исполняющего рабочего потока (для буферов на поток)
+typedef void (*TaskFunction)(void* context, int index, int worker);
+
+typedef struct Scheduler Scheduler;
+
+// Создание планировщика с заданным числом рабочих потоков
+// (0 - по числу доступных ядер)
+Scheduler* scheduler_create(int workers);
+
+// Остановка рабочих потоков и освобождение планировщика
+void scheduler_destroy(Scheduler* scheduler);
+
+// Число потоков, которое scheduler_create(0) создаёт по числу
+// доступных ядер
+int scheduler_online_workers(void);
+
+// Число рабочих потоков (1 для NULL)
+int scheduler_workers(const Scheduler* scheduler);
+
+// Выполнение count задач function(context, index, worker) и
+// ожидание их завершения. Рабочий поток, вызвавший функцию
+// изнутри задачи, во время ожидания сам выполняет задачи. Без
+// планировщика задачи выполняются в текущем потоке с worker 0
+void scheduler_parallel_for(
+    Scheduler* scheduler,
+    int count,
+    TaskFunction function,
+    void* context
+);
+
+// То же, что scheduler_parallel_for, но задачи с соседними
+// номерами попадают в очередь одного рабочего потока: задача
+// index - в очередь index * workers / count. Полосы строк, по
+// которым нумеруются задачи, закрепляются за потоками, и поток,
+// первым затронувший страницы полосы, её же и обрабатывает.
+// Перехват работы по-прежнему выравнивает нагрузку
+void scheduler_parallel_bands(
+    Scheduler* scheduler,
+    int count,
+    TaskFunction function,
+    void* context
+);
+
+// Привязка рабочих потоков к узлам NUMA: поток worker - к
+// процессорам узла worker * nodes / workers. Вместе с первым
+// касанием полос (scheduler_parallel_bands) память полосы
+// оказывается на узле обрабатывающего её потока. Возвращает
+// число узлов или 0, если привязка недоступна (один узел, не
+// Linux)
+int scheduler_bind_numa(Scheduler* scheduler);
+
+// Номер рабочего потока, выполняющего текущий код (-1 вне
+// рабочих потоков)
+int scheduler_current_worker(void);
+
+#endif // !IC_SCHEDULER
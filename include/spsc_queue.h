@@ -0,0 +1,28 @@
+#ifndef IC_SPSC_QUEUE
+#define IC_SPSC_QUEUE
+
+// Ограниченная очередь указателей с одним производителем и одним
+// потребителем. Передача элементов идёт без блокировок; мьютекс
+// нужен только чтобы уснуть на пустой или полной очереди
+typedef struct SpscQueue SpscQueue;
+
+// Создание очереди вместимостью не меньше capacity
+SpscQueue* spsc_queue_create(int capacity);
+
+void spsc_queue_free(SpscQueue* queue);
+
+// Добавление элемента, при полной очереди - ожидание места.
+// Вызывает только производитель
+void spsc_queue_push(SpscQueue* queue, void* item);
+
+// Извлечение элемента, при пустой очереди - ожидание. Возвращает
+// 0, если очередь закрыта и пуста. Вызывает только потребитель
+int spsc_queue_pop(SpscQueue* queue, void** item);
+
+// Извлечение без ожидания. Возвращает 0, если очередь пуста
+int spsc_queue_try_pop(SpscQueue* queue, void** item);
+
+// Больше элементов не будет. Вызывает только производитель
+void spsc_queue_close(SpscQueue* queue);
+
+#endif // !IC_SPSC_QUEUE
@@ -0,0 +1,49 @@
+#ifndef IC_STAGE_CACHE
+#define IC_STAGE_CACHE
+
+#include <stdint.h>
+
+#include "bmp.h"
+#include "cache.h"
+#include "roi.h"
+
+// Кэш промежуточных изображений цепочки. Ключ стадии - хеш
+// входного буфера, его окна и префикса цепочки до стадии
+// включительно, поэтому при изменении хвоста цепочки
+// пересчитываются только стадии после последней неизменной.
+// Записи хранятся в памяти (для сервера и библиотеки) и, если
+// задан каталог, на диске в формате кэша результатов. Кэш можно
+// использовать из нескольких потоков одновременно
+typedef struct _StageCache StageCache;
+
+// Размер кэша стадий в памяти по умолчанию, МБ
+#define IC_STAGE_CACHE_DEFAULT_SIZE 256
+
+// Создание кэша: memory_bytes - предел памяти (0 - без записей
+// в памяти), directory - каталог на диске или NULL, disk_bytes -
+// предел размера каталога. Возвращает NULL при ошибке
+StageCache* stage_cache_create(
+    uint64_t memory_bytes,
+    const char* directory,
+    uint64_t disk_bytes
+);
+
+void stage_cache_destroy(StageCache* cache);
+
+// Поиск стадии key: возвращает копию изображения и его окно
+// или NULL
+BMPImage* stage_cache_lookup(
+    StageCache* cache,
+    const CacheKey* key,
+    RoiWindow* window
+);
+
+// Сохранение результата стадии key с окном window
+void stage_cache_store(
+    StageCache* cache,
+    const CacheKey* key,
+    const BMPImage* image,
+    const RoiWindow* window
+);
+
+#endif // !IC_STAGE_CACHE
@@ -0,0 +1,50 @@
+#ifndef IC_TILES
+#define IC_TILES
+
+#include "bmp.h"
+#include "filters.h"
+#include "registry.h"
+#include "scheduler.h"
+
+// Размер стороны тайла результата по умолчанию. Вместе с
+// полями (halo) промежуточные буферы тайла остаются в L2
+#ifndef IC_TILE_SIZE
+#define IC_TILE_SIZE 256
+#endif
+
+// Стадия отрезка цепочки, выполняемого по тайлам
+typedef struct {
+    const Filter* filter;
+    const FilterDescriptor* descriptor;
+    BMPRegion crop; // Для обрезки: область кадра входа стадии
+} TileStage;
+
+// Длина отрезка цепочки, начинающегося с start, который имеет
+// смысл выполнять по тайлам: подряд идущие не глобальные
+// фильтры, среди которых не меньше двух вычисляющих стадий и
+// хотя бы одна зависит от окрестности. При parallel тайлы
+// распределяются по потокам и нужна лишь одна вычисляющая
+// стадия. 0, если тайлы не нужны
+int tiles_segment_length(const Filter* start, int parallel);
+
+// Выполнение отрезка цепочки по тайлам: каждый тайл результата
+// проходит всю цепочку в малых промежуточных буферах, так что
+// изображение читается и пишется по одному разу. Тайлы - задачи
+// планировщика scheduler (NULL - в текущем потоке). Результат
+// записывается в output (вместимость не меньше input).
+// Возвращает 0 при успехе
+int tiles_apply(
+    const BMPImage* input,
+    const TileStage* stages,
+    int count,
+    int tile_size,
+    Scheduler* scheduler,
+    BMPImage* output
+);
+
+// Первое касание буфера: строки обнуляются полосами на тех же
+// рабочих потоках, которым tiles_apply отдает тайлы этих полос,
+// поэтому страницы ложатся на узлы NUMA обрабатывающих потоков
+void tiles_first_touch(BMPImage* image, Scheduler* scheduler);
+
+#endif // !IC_TILES
@@ -0,0 +1,34 @@
+#ifndef IC_TRACE
+#define IC_TRACE
+
+#include <stdint.h>
+
+// Трассировка выполнения в формате Chrome trace event (открывается
+// в Perfetto и chrome://tracing). Каждый поток пишет события в
+// собственный кольцевой буфер без блокировок; при переполнении
+// старые события затираются. Пока запись не включена, отметки
+// стоят одну проверку флага
+
+// Включение записи. События предыдущей записи отбрасываются
+void trace_start(void);
+
+// Отметка начала события: время в наносекундах или 0, если
+// запись выключена
+int64_t trace_begin(void);
+
+// Завершение события name, начатого отметкой start. name должен
+// жить до trace_write; arg выводится как номер (не выводится, если
+// меньше 0)
+void trace_end(const char* name, int64_t start, int arg);
+
+// Название текущего потока в трассе
+void trace_thread_name(const char* name);
+
+// Запись собранных событий в JSON файл. Вызывается, когда потоки,
+// пишущие события, завершили работу. Возвращает 0 при успехе
+int trace_write(const char* path);
+
+// Выключение записи и освобождение буферов
+void trace_stop(void);
+
+#endif // !IC_TRACE
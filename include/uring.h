@@ -0,0 +1,53 @@
+#ifndef IC_URING
+#define IC_URING
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Асинхронный ввод-вывод целых файлов через io_uring (Linux
+// 5.19+, без liburing). Файл слота открывается, читается или
+// пишется и закрывается одной цепочкой запросов в кольце, а в
+// работе одновременно до depth файлов. Буферы слотов и сами
+// файлы регистрируются в кольце, поэтому запросы не
+// отображают память и не заводят дескрипторы процесса. Кольцом
+// пользуется один поток
+
+// Размер буфера слота по умолчанию: наибольший файл, который
+// читается и пишется через кольцо
+#ifndef IC_URING_BUFFER_SIZE
+#define IC_URING_BUFFER_SIZE ((size_t)256 * 1024)
+#endif
+
+typedef struct _Uring Uring;
+
+// Кольцо на depth слотов с буферами по buffer_size байт.
+// Возвращает NULL, если io_uring недоступен (старое ядро,
+// запрет в kernel.io_uring_disabled или seccomp)
+Uring* uring_create(int depth, size_t buffer_size);
+
+// Закрытие кольца. Незавершенные запросы отменяются
+void uring_destroy(Uring* ring);
+
+// Буфер слота slot (от 0 до depth - 1)
+uint8_t* uring_buffer(Uring* ring, int slot);
+
+// Постановка в очередь чтения файла path (до buffer_size байт
+// с начала) в буфер слота. Строка path должна жить до
+// завершения слота
+void uring_queue_read(Uring* ring, int slot, const char* path);
+
+// Постановка в очередь записи size байт буфера слота в файл
+// path, который создается или усекается
+void uring_queue_write(
+    Uring* ring,
+    int slot,
+    const char* path,
+    size_t size
+);
+
+// Отправка поставленных запросов и ожидание завершения слота.
+// Возвращает число прочитанных или записанных байт либо
+// отрицательный код ошибки (-errno)
+int64_t uring_wait(Uring* ring, int slot);
+
+#endif // !IC_URING
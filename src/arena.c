@@ -0,0 +1,200 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+// Выравнивание выделений и размер заголовков
+#define ARENA_ALIGNMENT 16
+
+// Блок арены. Данные начинаются сразу после заголовка
+typedef struct _ArenaChunk {
+    struct _ArenaChunk* next;
+    size_t size;
+    size_t used;
+    size_t padding; // Заголовок кратен ARENA_ALIGNMENT
+} ArenaChunk;
+
+struct _Arena {
+    ArenaChunk* first;
+    ArenaChunk* current; // Блок, из которого идут выделения
+    size_t chunk_size;
+};
+
+// Заголовок временной памяти: откуда она выделена
+typedef struct {
+    Arena* owner; // NULL - системный аллокатор
+    size_t size;
+} ScratchHeader;
+
+#define SCRATCH_HEADER_SIZE                                     \
+    ((sizeof(ScratchHeader) + ARENA_ALIGNMENT - 1) &           \
+     ~(size_t)(ARENA_ALIGNMENT - 1))
+
+static __thread Arena* current_arena = NULL;
+
+static size_t align_size(size_t size) {
+    return (size + ARENA_ALIGNMENT - 1) &
+           ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+static uint8_t* chunk_data(ArenaChunk* chunk) {
+    return (uint8_t*)chunk + sizeof(ArenaChunk);
+}
+
+Arena* arena_create(size_t chunk_size) {
+    Arena* arena = (Arena*)calloc(1, sizeof(Arena));
+    if (!arena) {
+        return NULL;
+    }
+    arena->chunk_size =
+        chunk_size ? chunk_size : IC_ARENA_CHUNK_SIZE;
+    return arena;
+}
+
+void arena_destroy(Arena* arena) {
+    if (!arena) {
+        return;
+    }
+
+    ArenaChunk* chunk = arena->first;
+    while (chunk) {
+        ArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(arena);
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    size = align_size(size);
+
+    // Блоки после текущего свободны после отката и
+    // используются повторно
+    for (ArenaChunk* chunk = arena->current; chunk;
+         chunk = chunk->next) {
+        if (chunk->size - chunk->used >= size) {
+            arena->current = chunk;
+            void* pointer = chunk_data(chunk) + chunk->used;
+            chunk->used += size;
+            return pointer;
+        }
+    }
+
+    // Нового блока хватает и на большие выделения
+    size_t chunk_size =
+        size > arena->chunk_size ? size : arena->chunk_size;
+    ArenaChunk* chunk =
+        (ArenaChunk*)malloc(sizeof(ArenaChunk) + chunk_size);
+    if (!chunk) {
+        return NULL;
+    }
+    chunk->next = NULL;
+    chunk->size = chunk_size;
+    chunk->used = size;
+
+    if (!arena->first) {
+        arena->first = chunk;
+    } else {
+        ArenaChunk* last = arena->current ? arena->current
+                                          : arena->first;
+        while (last->next) {
+            last = last->next;
+        }
+        last->next = chunk;
+    }
+    arena->current = chunk;
+    return chunk_data(chunk);
+}
+
+ArenaMark arena_mark(const Arena* arena) {
+    ArenaMark mark = { NULL, 0 };
+    if (arena && arena->current) {
+        mark.chunk = arena->current;
+        mark.used = arena->current->used;
+    }
+    return mark;
+}
+
+void arena_rewind(Arena* arena, ArenaMark mark) {
+    if (!arena) {
+        return;
+    }
+
+    ArenaChunk* chunk = (ArenaChunk*)mark.chunk;
+    if (chunk) {
+        chunk->used = mark.used;
+        arena->current = chunk;
+        chunk = chunk->next;
+    } else {
+        arena->current = arena->first;
+        chunk = arena->first;
+    }
+
+    for (; chunk; chunk = chunk->next) {
+        chunk->used = 0;
+    }
+}
+
+Arena* arena_enter(Arena* arena) {
+    Arena* previous = current_arena;
+    current_arena = arena;
+    return previous;
+}
+
+Arena* arena_current(void) {
+    return current_arena;
+}
+
+void* scratch_alloc(size_t size) {
+    Arena* arena = current_arena;
+    size_t total = SCRATCH_HEADER_SIZE + size;
+    uint8_t* block = arena ? (uint8_t*)arena_alloc(arena, total)
+                           : (uint8_t*)malloc(total);
+    if (!block) {
+        return NULL;
+    }
+
+    ScratchHeader* header = (ScratchHeader*)block;
+    header->owner = arena;
+    header->size = align_size(total);
+    return block + SCRATCH_HEADER_SIZE;
+}
+
+void* scratch_calloc(size_t count, size_t size) {
+    if (size && count > SIZE_MAX / size) {
+        return NULL;
+    }
+
+    void* pointer = scratch_alloc(count * size);
+    if (pointer) {
+        memset(pointer, 0, count * size);
+    }
+    return pointer;
+}
+
+void scratch_free(void* pointer) {
+    if (!pointer) {
+        return;
+    }
+
+    uint8_t* block = (uint8_t*)pointer - SCRATCH_HEADER_SIZE;
+    ScratchHeader* header = (ScratchHeader*)block;
+    Arena* arena = header->owner;
+    if (!arena) {
+        free(block);
+        return;
+    }
+
+    // Последнее выделение своей арены возвращается сразу, прочие
+    // - при откате. Чужую арену не читаем: ею владеет другой
+    // поток
+    if (arena != current_arena) {
+        return;
+    }
+    ArenaChunk* chunk = arena->current;
+    uint8_t* top = chunk ? chunk_data(chunk) + chunk->used : NULL;
+    if (block + header->size == top) {
+        chunk->used -= header->size;
+    }
+}
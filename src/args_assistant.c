@@ -4,8 +4,10 @@
 #include <string.h>
 
 #include "args_assistant.h"
+#include "cache.h"
 #include "defines.h"
 #include "filters.h"
+#include "registry.h"
 
 // Вспомогательная функция для проверки, является ли строка целым
 // числом
@@ -31,7 +33,9 @@ static int is_integer(const char* str) {
     return 1; // Все символы - цифры
 }
 
-// Вспомогательная функция для создания нового фильтра
+// Вспомогательная функция для создания нового фильтра. Узлы
+// берутся из кучи, а не из арены: цепочка может пережить
+// задание, в котором ее разобрали, и переходить между потоками
 static Filter*
 create_filter(int type, int param_count, int params[]) {
     Filter* new_filter = (Filter*)malloc(sizeof(Filter));
@@ -52,352 +56,582 @@ create_filter(int type, int param_count, int params[]) {
     return new_filter;
 }
 
-int parse_args(
-    int argc,
-    char** argv,
-    char** ifile,
-    char** ofile,
-    Filter** head // Изменилось на двойной указатель!
+// Вспомогательная функция для проверки, является ли строка
+// числом (целым или дробным)
+static int is_number(const char* str) {
+    if (str == NULL || *str == '\0') {
+        return 0;
+    }
+
+    char* end = NULL;
+    strtod(str, &end);
+    return *end == '\0';
+}
+
+// Добавление фильтра в конец списка
+static void append_filter(Filter** head, Filter* filter) {
+    if (*head == NULL) {
+        *head = filter;
+        return;
+    }
+
+    // Находим последний элемент
+    Filter* current = *head;
+    while (current->next) {
+        current = current->next;
+    }
+    current->next = filter;
+}
+
+// Склонение слова "аргумент" после числа
+static const char* arguments_word(int count) {
+    if (count == 1) {
+        return "аргумент";
+    }
+    if (count >= 2 && count <= 4) {
+        return "аргумента";
+    }
+    return "аргументов";
+}
+
+// Вывод ожидаемой формы параметров фильтра
+static void print_expected_params(
+    const FilterDescriptor* descriptor,
+    int count
 ) {
-    // Инициализируем список как пустой
-    *head = NULL;
+    fprintf(stderr, "%d %s: ", count, arguments_word(count));
+    for (int p = descriptor->param_count - count;
+         p < descriptor->param_count;
+         p++) {
+        fprintf(
+            stderr,
+            "%s%s",
+            descriptor->params[p].name,
+            p + 1 < descriptor->param_count ? ", " : ""
+        );
+    }
+}
 
-    if (argc < 2) {
-        return 0; // Нет аргументов, только вызов программы
+// Проверка, подходит ли строка под тип параметра
+static int matches_param_type(
+    const FilterParam* param,
+    const char* value
+) {
+    return param->type == FILTER_PARAM_INT ? is_integer(value)
+                                           : is_number(value);
+}
+
+// Разбор параметров фильтра по схеме из реестра. Возвращает
+// число использованных аргументов или -1 при ошибке
+static int parse_filter_params(
+    const FilterDescriptor* descriptor,
+    int available,
+    char** args,
+    int params[]
+) {
+    int full = descriptor->param_count;
+    int shortest = descriptor->min_param_count;
+
+    if (available < shortest) {
+        fprintf(stderr, "[Error] %s ожидает ", descriptor->name);
+        print_expected_params(descriptor, shortest);
+        if (full != shortest) {
+            fprintf(stderr, " или ");
+            print_expected_params(descriptor, full);
+        }
+        fprintf(stderr, "\n");
+        return -1;
     }
 
-    // Если первый аргумент -help
-    if (strcmp(argv[1], IC_ARGV_HELP) == 0) {
-        return IC_ARGS_ASSISTANT_HELP; // печатай подсказку
-    } else if (strcmp(argv[1], IC_ARGV_VERSION) == 0) {
-        // или если -version
-        return IC_ARGS_ASSISTANT_VERSION; // печатай версию
+    // Полная форма выбирается, если все её аргументы - числа
+    int count = shortest;
+    if (full != shortest && available >= full) {
+        int matches = 1;
+        for (int p = 0; p < full; p++) {
+            const FilterParam* param = &descriptor->params[p];
+            if (!matches_param_type(param, args[p])) {
+                matches = 0;
+                break;
+            }
+        }
+        if (matches) {
+            count = full;
+        }
     }
 
-    // Если аргумент -info
-    if (strcmp(argv[1], IC_ARGV_INFO) == 0) {
-        if (argc > 2) {
-            *ifile = argv[2];
-            return IC_ARGS_ASSISTANT_INFO;
-        } else {
+    // Короткая форма заполняет последние параметры
+    int first = full - count;
+
+    for (int a = 0; a < count; a++) {
+        const FilterParam* param = &descriptor->params[first + a];
+
+        if (!matches_param_type(param, args[a])) {
             fprintf(
                 stderr,
-                "[Error] Не указан файл для чтения!\n"
+                "[Error] %s ожидает %s для %s\n",
+                descriptor->name,
+                param->type == FILTER_PARAM_INT ? "целое число"
+                                                : "число",
+                param->name
             );
-            return IC_ARGS_ASSISTANT_ERROR;
+            fprintf(
+                stderr,
+                "        Получено: %s='%s'\n",
+                param->name,
+                args[a]
+            );
+            return -1;
         }
-    }
 
-    // Иначе первый аргумент - входной файл
-    *ifile = argv[1];
+        int value = param->type == FILTER_PARAM_INT
+            ? atoi(args[a])
+            : (int)(atof(args[a]) * FILTER_FIXED_SCALE);
 
-    // TODO: Добавить обработку -help, -version, -info в середине
-    // списка аргументов
+        if ((param->constraints & FILTER_PARAM_POSITIVE) &&
+            value <= 0) {
+            fprintf(
+                stderr,
+                "[Error] %s: %s должен быть положительным\n",
+                descriptor->name,
+                param->name
+            );
+            return -1;
+        }
 
-    // Второй аргумент (если есть) - выходной файл
-    if (argc >= 3 && argv[2][0] != '-') {
-        *ofile = argv[2];
-    } else {
-        // Если второй аргумент начинается с '-', значит это
-        // фильтр
-        *ofile = NULL;
+        if ((param->constraints & FILTER_PARAM_NON_NEGATIVE) &&
+            value < 0) {
+            fprintf(
+                stderr,
+                "[Error] %s: %s не может быть отрицательным\n",
+                descriptor->name,
+                param->name
+            );
+            return -1;
+        }
+
+        if (param->minimum && value < param->minimum) {
+            fprintf(
+                stderr,
+                "[Error] %s: %s должен быть не меньше %d\n",
+                descriptor->name,
+                param->name,
+                param->minimum
+            );
+            return -1;
+        }
+
+        if ((param->constraints & FILTER_PARAM_ODD) &&
+            value % 2 == 0) {
+            fprintf(
+                stderr,
+                "[Error] %s: %s должен быть нечетным\n",
+                descriptor->name,
+                param->name
+            );
+            return -1;
+        }
+
+        params[first + a] = value;
+    }
+
+    return count;
+}
+
+// Начало цепочки следующего выхода режима -multi
+static int add_output(Options* options, const char* path) {
+    OutputChain* grown = (OutputChain*)realloc(
+        options->outputs,
+        (options->output_count + 1) * sizeof(OutputChain)
+    );
+    if (!grown) {
+        return 1;
     }
 
-    // Обрабатываем фильтры, начиная с нужного индекса
-    int start_index = (*ofile) ? 3 : 2;
+    options->outputs = grown;
+    grown[options->output_count].path = path;
+    grown[options->output_count].chain = NULL;
+    options->output_count++;
+    return 0;
+}
 
-    for (int i = start_index; i < argc; i++) {
-        if (strcmp(argv[i], IC_ARGV_FILTER_CROP) == 0) {
-            // Проверяем, что есть достаточно аргументов
-            if (i + 2 >= argc) {
+// Разбор фильтров и опций argv[start..argc). Без options опции
+// не принимаются. В режиме multi фильтры относятся к цепочке
+// последнего выхода -o. Возвращает 0 при успехе
+static int parse_filters(
+    int argc,
+    char** argv,
+    int start,
+    Filter** head,
+    Options* options,
+    int multi
+) {
+    for (int i = start; i < argc; i++) {
+        if (multi && strcmp(argv[i], IC_ARGV_OUTPUT) == 0) {
+            if (i + 1 >= argc) {
                 fprintf(
                     stderr,
-                    "[Error] " IC_ARGV_FILTER_CROP
-                    " ожидает 2 аргумента: width, "
-                    "height.\n"
+                    "[Error] " IC_ARGV_OUTPUT
+                    " ожидает путь к выходному файлу\n"
                 );
-                // Освобождаем уже созданные фильтры при ошибке
-                return IC_ARGS_ASSISTANT_ERROR;
+                return 1;
             }
+            if (add_output(options, argv[++i]) != 0) {
+                return 1;
+            }
+            continue;
+        }
 
-            // Проверяем, что аргументы - целые числа
-            if (!is_integer(argv[i + 1]) ||
-                !is_integer(argv[i + 2])) {
+        // Опции выполнения могут стоять среди фильтров
+        if (options && strcmp(argv[i], IC_ARGV_THREADS) == 0) {
+            if (i + 1 >= argc || !is_integer(argv[i + 1]) ||
+                atoi(argv[i + 1]) < 0) {
                 fprintf(
                     stderr,
-                    "[Error] " IC_ARGV_FILTER_CROP
-                    " ожидает целые числа для "
-                    "width и height\n"
+                    "[Error] " IC_ARGV_THREADS
+                    " ожидает неотрицательное число потоков\n"
                 );
+                return 1;
+            }
+            options->threads = atoi(argv[++i]);
+            continue;
+        }
+
+        if (options && strcmp(argv[i], IC_ARGV_JOBS) == 0) {
+            if (i + 1 >= argc || !is_integer(argv[i + 1]) ||
+                atoi(argv[i + 1]) < 0) {
                 fprintf(
                     stderr,
-                    "        Получено: width='%s', "
-                    "height='%s'\n",
-                    argv[i + 1],
-                    argv[i + 2]
+                    "[Error] " IC_ARGV_JOBS
+                    " ожидает неотрицательное число изображений\n"
                 );
-                return IC_ARGS_ASSISTANT_ERROR;
+                return 1;
             }
+            options->jobs = atoi(argv[++i]);
+            continue;
+        }
 
-            // Парсим ширину и высоту
-            int width = atoi(argv[i + 1]);
-            int height = atoi(argv[i + 2]);
-
-            // Проверка корректности размеров
-            if (width <= 0 || height <= 0) {
+        if (options && strcmp(argv[i], IC_ARGV_IO_URING) == 0) {
+            if (i + 1 >= argc || !is_integer(argv[i + 1]) ||
+                atoi(argv[i + 1]) < 0) {
                 fprintf(
                     stderr,
-                    "[Error] Размеры для обрезки должны быть "
-                    "положительными\n"
+                    "[Error] " IC_ARGV_IO_URING
+                    " ожидает неотрицательное число файлов\n"
                 );
-                return IC_ARGS_ASSISTANT_ERROR;
+                return 1;
             }
+            options->io_uring = atoi(argv[++i]);
+            continue;
+        }
 
-            // Создаем фильтр обрезки
-            int params[2] = { width, height };
-            Filter* crop_filter =
-                create_filter(ARGV_TYPE_FILTER_CROP, 2, params);
+        if (options && strcmp(argv[i], IC_ARGV_PROFILE) == 0) {
+            options->profile = 1;
+            continue;
+        }
 
-            if (!crop_filter) {
+        if (options && strcmp(argv[i], IC_ARGV_PROFILE_JSON) == 0) {
+            if (i + 1 >= argc) {
                 fprintf(
                     stderr,
-                    "[Error] Не удалось выделить память для "
-                    "фильтра\n"
+                    "[Error] " IC_ARGV_PROFILE_JSON
+                    " ожидает путь к файлу\n"
                 );
-                return IC_ARGS_ASSISTANT_ERROR;
-            }
-
-            // Добавляем в список
-            if (*head == NULL) {
-                *head = crop_filter;
-            } else {
-                // Находим последний элемент
-                Filter* current = *head;
-                while (current->next) {
-                    current = current->next;
-                }
-                current->next = crop_filter;
+                return 1;
             }
+            options->profile = 1;
+            options->profile_json = argv[++i];
+            continue;
+        }
 
-            // Переходим к следующему фильтру
-            i += 2; // Пропускаем обработанные аргументы
-
-        } else if (strcmp(argv[i], IC_ARGV_FILTER_GS) == 0) {
-            // Фильтр grayscale без параметров
-            Filter* gs_filter =
-                create_filter(ARGV_TYPE_FILTER_GS, 0, NULL);
-
-            // Добавляем в список
-            if (*head == NULL) {
-                *head = gs_filter;
-            } else {
-                Filter* current = *head;
-                while (current->next) {
-                    current = current->next;
-                }
-                current->next = gs_filter;
-            }
+        if (options && strcmp(argv[i], IC_ARGV_NUMA) == 0) {
+            options->numa = 1;
+            continue;
+        }
 
-        } else if (strcmp(argv[i], IC_ARGV_FILTER_NEG) == 0) {
-            // Фильтр negative без параметров
-            Filter* neg_filter =
-                create_filter(ARGV_TYPE_FILTER_NEG, 0, NULL);
-
-            // Добавляем в список
-            if (*head == NULL) {
-                *head = neg_filter;
-            } else {
-                Filter* current = *head;
-                while (current->next) {
-                    current = current->next;
-                }
-                current->next = neg_filter;
-            }
+        if (options &&
+            strcmp(argv[i], IC_ARGV_PARALLEL_IO) == 0) {
+            options->parallel_io = 1;
+            continue;
+        }
 
-        } else if (strcmp(argv[i], IC_ARGV_FILTER_SHARP) == 0) {
-            // Фильтр sharpening без параметров
-            Filter* sharp_filter =
-                create_filter(ARGV_TYPE_FILTER_SHARP, 0, NULL);
-
-            // Добавляем в список
-            if (*head == NULL) {
-                *head = sharp_filter;
-            } else {
-                Filter* current = *head;
-                while (current->next) {
-                    current = current->next;
-                }
-                current->next = sharp_filter;
-            }
+        if (options && strcmp(argv[i], IC_ARGV_COUNTERS) == 0) {
+            options->profile = 1;
+            options->counters = 1;
+            continue;
+        }
 
-        } else if (strcmp(argv[i], IC_ARGV_FILTER_EDGE) == 0) {
-            // Фильтр edge detection с одним параметром
+        if (options && strcmp(argv[i], IC_ARGV_TRACE) == 0) {
             if (i + 1 >= argc) {
                 fprintf(
                     stderr,
-                    "[Error] " IC_ARGV_FILTER_EDGE
-                    " ожидает 1 аргумент: "
-                    "threshold\n"
+                    "[Error] " IC_ARGV_TRACE
+                    " ожидает путь к файлу\n"
                 );
-                return IC_ARGS_ASSISTANT_ERROR;
+                return 1;
             }
+            options->trace = argv[++i];
+            continue;
+        }
 
-            float threshold = atof(argv[i + 1]);
-            // Сохраняем threshold как целое (умножаем на 1000
-            // для точности)
-            int threshold_int = (int)(threshold * 1000);
-            int params[1] = { threshold_int };
-            Filter* edge_filter =
-                create_filter(ARGV_TYPE_FILTER_EDGE, 1, params);
-
-            // Добавляем в список
-            if (*head == NULL) {
-                *head = edge_filter;
-            } else {
-                Filter* current = *head;
-                while (current->next) {
-                    current = current->next;
-                }
-                current->next = edge_filter;
-            }
-
-            i += 1; // Пропускаем параметр
-
-        } else if (strcmp(argv[i], IC_ARGV_FILTER_BLUR) == 0) {
-            // Фильтр blur с одним параметром
+        if (options && strcmp(argv[i], IC_ARGV_CACHE) == 0) {
             if (i + 1 >= argc) {
                 fprintf(
                     stderr,
-                    "[Error] " IC_ARGV_FILTER_BLUR
-                    " ожидает 1 аргумент: sigma\n"
+                    "[Error] " IC_ARGV_CACHE
+                    " ожидает путь к каталогу\n"
                 );
-                return IC_ARGS_ASSISTANT_ERROR;
-            }
-
-            float sigma = atof(argv[i + 1]);
-            // Сохраняем sigma как целое (умножаем на 1000 для
-            // точности)
-            int sigma_int = (int)(sigma * 1000);
-            int params[1] = { sigma_int };
-            Filter* blur_filter =
-                create_filter(ARGV_TYPE_FILTER_BLUR, 1, params);
-
-            // Добавляем в список
-            if (*head == NULL) {
-                *head = blur_filter;
-            } else {
-                Filter* current = *head;
-                while (current->next) {
-                    current = current->next;
-                }
-                current->next = blur_filter;
+                return 1;
             }
+            options->cache = argv[++i];
+            continue;
+        }
 
-            i += 1; // Пропускаем параметр
+        if (options && strcmp(argv[i], IC_ARGV_STAGE_CACHE) == 0) {
+            options->stage_cache = 1;
+            continue;
+        }
 
-        } else if (strcmp(argv[i], IC_ARGV_FILTER_MED) == 0) {
-            // Фильтр median с одним параметром
-            if (i + 1 >= argc) {
+        if (options && strcmp(argv[i], IC_ARGV_CACHE_SIZE) == 0) {
+            if (i + 1 >= argc || !is_integer(argv[i + 1]) ||
+                atoi(argv[i + 1]) <= 0) {
                 fprintf(
                     stderr,
-                    "[Error] " IC_ARGV_FILTER_MED
-                    " ожидает 1 аргумент: window\n"
+                    "[Error] " IC_ARGV_CACHE_SIZE
+                    " ожидает положительный размер в МБ\n"
                 );
-                return IC_ARGS_ASSISTANT_ERROR;
+                return 1;
             }
+            options->cache_size = atoi(argv[++i]);
+            continue;
+        }
 
-            int window = atoi(argv[i + 1]);
-            if (window <= 0 || window % 2 == 0) {
+        if (options && strcmp(argv[i], IC_ARGV_MAX_MEMORY) == 0) {
+            if (i + 1 >= argc || !is_integer(argv[i + 1]) ||
+                atoi(argv[i + 1]) <= 0) {
                 fprintf(
                     stderr,
-                    "[Error] window должен быть положительным "
-                    "нечетным числом\n"
+                    "[Error] " IC_ARGV_MAX_MEMORY
+                    " ожидает положительный размер в МБ\n"
                 );
-                return IC_ARGS_ASSISTANT_ERROR;
+                return 1;
             }
+            options->max_memory = atoi(argv[++i]);
+            continue;
+        }
 
-            int params[1] = { window };
-            Filter* med_filter =
-                create_filter(ARGV_TYPE_FILTER_MED, 1, params);
-
-            // Добавляем в список
-            if (*head == NULL) {
-                *head = med_filter;
-            } else {
-                Filter* current = *head;
-                while (current->next) {
-                    current = current->next;
-                }
-                current->next = med_filter;
-            }
+        const FilterDescriptor* descriptor =
+            filter_registry_find(argv[i]);
 
-            i += 1; // Пропускаем параметр
+        if (!descriptor) {
+            fprintf(
+                stderr,
+                "[Error] Неизвестный фильтр: %s\n",
+                argv[i]
+            );
+            return 1;
+        }
 
-        } else if (strcmp(argv[i], IC_ARGV_FILTER_CRYSTAL) == 0) {
-            // Фильтр crystallize с тремя параметрами: center_x, center_y, radius
-            if (i + 3 >= argc) {
-                fprintf(
-                    stderr,
-                    "[Error] " IC_ARGV_FILTER_CRYSTAL
-                    " ожидает 3 аргумента: center_x, center_y, radius\n"
-                );
-                return IC_ARGS_ASSISTANT_ERROR;
-            }
+        int params[MAX_FILTER_PARAMS] = { 0 };
+        int consumed = parse_filter_params(
+            descriptor,
+            argc - i - 1,
+            argv + i + 1,
+            params
+        );
+        if (consumed < 0) {
+            return 1;
+        }
 
-            float center_x = atof(argv[i + 1]);
-            float center_y = atof(argv[i + 2]);
-            float radius = atof(argv[i + 3]);
+        Filter* filter = create_filter(
+            descriptor->type,
+            descriptor->param_count,
+            params
+        );
+        if (!filter) {
+            fprintf(
+                stderr,
+                "[Error] Не удалось выделить память для "
+                "фильтра\n"
+            );
+            return 1;
+        }
 
-            if (radius <= 0) {
-                fprintf(
-                    stderr,
-                    "[Error] radius должен быть положительным числом\n"
-                );
-                return IC_ARGS_ASSISTANT_ERROR;
-            }
+        if (multi && options->output_count == 0) {
+            fprintf(
+                stderr,
+                "[Error] В режиме " IC_ARGV_MULTI
+                " фильтры указываются после " IC_ARGV_OUTPUT "\n"
+            );
+            free(filter);
+            return 1;
+        }
+        if (multi) {
+            int last = options->output_count - 1;
+            append_filter(&options->outputs[last].chain, filter);
+        } else {
+            append_filter(head, filter);
+        }
 
-            // Сохраняем как целые (умножаем на 1000 для точности)
-            int params[3] = {
-                (int)(center_x * 1000),
-                (int)(center_y * 1000),
-                (int)(radius * 1000)
-            };
-            Filter* crystal_filter =
-                create_filter(ARGV_TYPE_FILTER_CRYSTAL, 3, params);
+        // Переходим к следующему фильтру
+        i += consumed; // Пропускаем обработанные аргументы
+    }
 
-            if (!crystal_filter) {
-                fprintf(
-                    stderr,
-                    "[Error] Не удалось выделить память для "
-                    "фильтра\n"
-                );
-                return IC_ARGS_ASSISTANT_ERROR;
-            }
+    return 0;
+}
 
-            // Добавляем в список
-            if (*head == NULL) {
-                *head = crystal_filter;
-            } else {
-                Filter* current = *head;
-                while (current->next) {
-                    current = current->next;
-                }
-                current->next = crystal_filter;
-            }
+int parse_args(
+    int argc,
+    char** argv,
+    char** ifile,
+    char** ofile,
+    Filter** head, // Изменилось на двойной указатель!
+    Options* options
+) {
+    // Инициализируем список как пустой
+    *head = NULL;
+    options->threads = 0;
+    options->numa = 0;
+    options->parallel_io = 0;
+    options->jobs = 0;
+    options->io_uring = 0;
+    options->profile = 0;
+    options->profile_json = NULL;
+    options->trace = NULL;
+    options->counters = 0;
+    options->cache = NULL;
+    options->cache_size = 0;
+    options->stage_cache = 0;
+    options->max_memory = 0;
+    options->outputs = NULL;
+    options->output_count = 0;
 
-            i += 3; // Пропускаем обработанные аргументы
+    if (argc < 2) {
+        return 0; // Нет аргументов, только вызов программы
+    }
 
+    // Если первый аргумент -help
+    if (strcmp(argv[1], IC_ARGV_HELP) == 0) {
+        return IC_ARGS_ASSISTANT_HELP; // печатай подсказку
+    } else if (strcmp(argv[1], IC_ARGV_VERSION) == 0) {
+        // или если -version
+        return IC_ARGS_ASSISTANT_VERSION; // печатай версию
+    }
+
+    // Если аргумент -info
+    if (strcmp(argv[1], IC_ARGV_INFO) == 0) {
+        if (argc > 2) {
+            *ifile = argv[2];
+            return IC_ARGS_ASSISTANT_INFO;
         } else {
             fprintf(
                 stderr,
-                "[Error] Неизвестный фильтр: %s\n",
-                argv[i]
+                "[Error] Не указан файл для чтения!\n"
             );
             return IC_ARGS_ASSISTANT_ERROR;
         }
     }
 
-    return 0;
+    int result = IC_ARGS_ASSISTANT_OK;
+    int start_index;
+
+    if (strcmp(argv[1], IC_ARGV_BATCH) == 0) {
+        // Пакетный режим: источник изображений и шаблон имен
+        // результатов
+        if (argc < 4) {
+            fprintf(
+                stderr,
+                "[Error] " IC_ARGV_BATCH
+                " ожидает источник и шаблон выходных файлов\n"
+            );
+            return IC_ARGS_ASSISTANT_ERROR;
+        }
+
+        *ifile = argv[2];
+        *ofile = argv[3];
+        start_index = 4;
+        result = IC_ARGS_ASSISTANT_BATCH;
+    } else if (strcmp(argv[1], IC_ARGV_MULTI) == 0) {
+        // Несколько выходов: входной файл, дальше группы
+        // "-o файл фильтры"
+        if (argc < 3) {
+            fprintf(
+                stderr,
+                "[Error] " IC_ARGV_MULTI " ожидает входной файл\n"
+            );
+            return IC_ARGS_ASSISTANT_ERROR;
+        }
+
+        *ifile = argv[2];
+        *ofile = NULL;
+        start_index = 3;
+        result = IC_ARGS_ASSISTANT_MULTI;
+    } else if (strcmp(argv[1], IC_ARGV_SERVE) == 0) {
+        // Режим сервера: путь к сокету, дальше только опции
+        if (argc < 3) {
+            fprintf(
+                stderr,
+                "[Error] " IC_ARGV_SERVE " ожидает путь к сокету\n"
+            );
+            return IC_ARGS_ASSISTANT_ERROR;
+        }
+
+        *ifile = argv[2];
+        *ofile = NULL;
+        start_index = 3;
+        result = IC_ARGS_ASSISTANT_SERVE;
+    } else {
+        // Иначе первый аргумент - входной файл
+        *ifile = argv[1];
+
+        // TODO: Добавить обработку -help, -version, -info в
+        // середине списка аргументов
+
+        // Второй аргумент (если есть) - выходной файл
+        if (argc >= 3 && argv[2][0] != '-') {
+            *ofile = argv[2];
+        } else {
+            // Если второй аргумент начинается с '-', значит это
+            // фильтр
+            *ofile = NULL;
+        }
+
+        // Обрабатываем фильтры, начиная с нужного индекса
+        start_index = (*ofile) ? 3 : 2;
+    }
+
+    if (parse_filters(
+            argc,
+            argv,
+            start_index,
+            head,
+            options,
+            result == IC_ARGS_ASSISTANT_MULTI
+        ) != 0) {
+        return IC_ARGS_ASSISTANT_ERROR;
+    }
+
+    if (result == IC_ARGS_ASSISTANT_MULTI &&
+        options->output_count == 0) {
+        fprintf(
+            stderr,
+            "[Error] " IC_ARGV_MULTI " ожидает хотя бы один выход "
+            IC_ARGV_OUTPUT "\n"
+        );
+        return IC_ARGS_ASSISTANT_ERROR;
+    }
+
+    return result;
+}
+
+int parse_filter_chain(int count, char** words, Filter** head) {
+    *head = NULL;
+
+    if (parse_filters(count, words, 0, head, NULL, 0) != 0) {
+        free_filter_list(*head);
+        *head = NULL;
+        return IC_ARGS_ASSISTANT_ERROR;
+    }
+    return IC_ARGS_ASSISTANT_OK;
 }
 
 // Вспомогательная функция для освобождения списка фильтров
@@ -409,6 +643,15 @@ void free_filter_list(Filter* head) {
     }
 }
 
+void free_output_chains(Options* options) {
+    for (int i = 0; i < options->output_count; i++) {
+        free_filter_list(options->outputs[i].chain);
+    }
+    free(options->outputs);
+    options->outputs = NULL;
+    options->output_count = 0;
+}
+
 void printhelp() {
     FILE* help_file = fopen(AUX_DIR SLASH HELP_MESSAGE, "r");
     if (!help_file) {
@@ -0,0 +1,814 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <ctype.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <glob.h>
+#endif
+
+#include "arena.h"
+#include "batch.h"
+#include "bmp.h"
+#include "defines.h"
+#include "paths.h"
+#include "pool.h"
+#include "roi.h"
+#include "spsc_queue.h"
+#include "trace.h"
+#include "uring.h"
+
+// Наибольшее число файлов в работе через io_uring. Буферы двух
+// колец при этом занимают 2 * 256 * IC_URING_BUFFER_SIZE
+#define BATCH_MAX_IO_DEPTH 256
+
+// Изображение, проходящее по конвейеру
+typedef struct {
+    int index;
+    BMPImage* image; // NULL, если загрузить не удалось
+    RoiWindow window;
+    int failed;
+} BatchItem;
+
+// Список путей
+typedef struct {
+    char** items;
+    int count;
+    int capacity;
+} PathList;
+
+// Общие данные задач пакета
+typedef struct {
+    PathList* inputs;
+    PathList* outputs;
+    Filter* filter_list;
+    const Execution* execution;
+
+    SpscQueue* loaded;    // Чтение -> обработка
+    SpscQueue* processed; // Обработка -> запись
+    BatchItem** group;    // Изображения, обрабатываемые сейчас
+    int failed;           // Число неудачных файлов (пишет запись)
+
+    // Кольца io_uring потоков чтения и записи или NULL
+    Uring* read_ring;
+    Uring* write_ring;
+    int io_depth;
+} BatchJob;
+
+// ==================== СПИСКИ ПУТЕЙ ====================
+
+static int path_list_add(PathList* list, const char* path) {
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 64;
+        char** items =
+            (char**)realloc(list->items, capacity * sizeof(char*));
+        if (!items) {
+            return 1;
+        }
+        list->items = items;
+        list->capacity = capacity;
+    }
+
+    char* copy = ic_strdup(path);
+    if (!copy) {
+        return 1;
+    }
+    list->items[list->count++] = copy;
+    return 0;
+}
+
+static void path_list_free(PathList* list) {
+    for (int i = 0; i < list->count; i++) {
+        free(list->items[i]);
+    }
+    free(list->items);
+}
+
+static int compare_paths(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// Проверка расширения .bmp без учета регистра
+static int has_bmp_extension(const char* name) {
+    size_t length = strlen(name);
+    if (length < 4) {
+        return 0;
+    }
+
+    const char* extension = name + length - 4;
+    return extension[0] == '.' &&
+        tolower((unsigned char)extension[1]) == 'b' &&
+        tolower((unsigned char)extension[2]) == 'm' &&
+        tolower((unsigned char)extension[3]) == 'p';
+}
+
+// Все файлы *.bmp директории в алфавитном порядке
+static int collect_directory(const char* path, PathList* list) {
+    DIR* dir = opendir(path);
+    if (!dir) {
+        return 1;
+    }
+
+    size_t path_length = strlen(path);
+    int trailing = path_length > 0 &&
+        (path[path_length - 1] == '/' ||
+         path[path_length - 1] == '\\');
+
+    struct dirent* entry;
+    int error = 0;
+    while (!error && (entry = readdir(dir)) != NULL) {
+        if (!has_bmp_extension(entry->d_name)) {
+            continue;
+        }
+
+        char full[1024];
+        snprintf(
+            full,
+            sizeof(full),
+            "%s%s%s",
+            path,
+            trailing ? "" : SLASH,
+            entry->d_name
+        );
+
+        struct stat info;
+        if (stat(full, &info) == 0 && S_ISREG(info.st_mode)) {
+            error = path_list_add(list, full);
+        }
+    }
+    closedir(dir);
+
+    if (!error && list->count > 1) {
+        qsort(list->items, list->count, sizeof(char*), compare_paths);
+    }
+    return error;
+}
+
+// Пути из файла-списка, по одному в строке
+static int collect_list_file(const char* path, PathList* list) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return 1;
+    }
+
+    char line[1024];
+    int error = 0;
+    while (!error && fgets(line, sizeof(line), file)) {
+        size_t length = strcspn(line, "\r\n");
+        line[length] = '\0';
+
+        // Пустые строки и комментарии пропускаются
+        if (length == 0 || line[0] == '#') {
+            continue;
+        }
+        error = path_list_add(list, line);
+    }
+    fclose(file);
+
+    return error;
+}
+
+static int collect_glob(const char* pattern, PathList* list) {
+#ifdef _WIN32
+    (void)pattern;
+    (void)list;
+    fprintf(
+        stderr,
+        "[Error] Шаблоны файлов не поддерживаются в Windows, "
+        "укажите директорию или @список\n"
+    );
+    return 1;
+#else
+    glob_t matches;
+    int status = glob(pattern, 0, NULL, &matches);
+    if (status == GLOB_NOMATCH) {
+        return 0;
+    }
+    if (status != 0) {
+        return 1;
+    }
+
+    int error = 0;
+    for (size_t i = 0; !error && i < matches.gl_pathc; i++) {
+        error = path_list_add(list, matches.gl_pathv[i]);
+    }
+    globfree(&matches);
+
+    return error;
+#endif
+}
+
+// Сбор входных файлов по источнику
+static int collect_inputs(const char* source, PathList* list) {
+    if (source[0] == '@') {
+        return collect_list_file(source + 1, list);
+    }
+    if (strpbrk(source, "*?[")) {
+        return collect_glob(source, list);
+    }
+
+    struct stat info;
+    if (stat(source, &info) != 0) {
+        return 1;
+    }
+    if (S_ISDIR(info.st_mode)) {
+        return collect_directory(source, list);
+    }
+    return path_list_add(list, source);
+}
+
+// ==================== ИМЕНА РЕЗУЛЬТАТОВ ====================
+
+// Имя файла без директорий
+static const char* file_name(const char* path) {
+    const char* name = path;
+    for (const char* p = path; *p; p++) {
+        if (*p == '/' || *p == '\\') {
+            name = p + 1;
+        }
+    }
+    return name;
+}
+
+// Построение имени результата по шаблону. Возвращает 0 при
+// успехе
+static int expand_output(
+    const char* pattern,
+    const char* input,
+    int index,
+    char* output,
+    size_t size
+) {
+    const char* name = file_name(input);
+    const char* dot = strrchr(name, '.');
+    size_t stem = dot && dot != name ? (size_t)(dot - name)
+                                     : strlen(name);
+    size_t length = 0;
+
+    // Шаблон без подстановок - директория результатов
+    if (!strchr(pattern, '%')) {
+        size_t pattern_length = strlen(pattern);
+        int trailing = pattern_length > 0 &&
+            (pattern[pattern_length - 1] == '/' ||
+             pattern[pattern_length - 1] == '\\');
+        int written = snprintf(
+            output,
+            size,
+            "%s%s%s",
+            pattern,
+            trailing ? "" : SLASH,
+            name
+        );
+        return written < 0 || (size_t)written >= size;
+    }
+
+    for (const char* p = pattern; *p; p++) {
+        char piece[32];
+        const char* text = piece;
+        size_t text_length;
+
+        if (*p != '%') {
+            piece[0] = *p;
+            text_length = 1;
+        } else {
+            p++;
+            switch (*p) {
+                case 'n':
+                    text = name;
+                    text_length = stem;
+                    break;
+                case 'f':
+                    text = name;
+                    text_length = strlen(name);
+                    break;
+                case 'i':
+                    text_length = (size_t)snprintf(
+                        piece,
+                        sizeof(piece),
+                        "%d",
+                        index
+                    );
+                    break;
+                case '%':
+                    piece[0] = '%';
+                    text_length = 1;
+                    break;
+                default:
+                    return 1; // Неизвестная подстановка
+            }
+        }
+
+        if (length + text_length + 1 > size) {
+            return 1;
+        }
+        memcpy(output + length, text, text_length);
+        length += text_length;
+    }
+
+    output[length] = '\0';
+    return 0;
+}
+
+// ==================== КОНВЕЙЕР ====================
+
+// Загрузка изображения элемента. Файл, уже прочитанный в
+// память целиком (size байт data), только декодируется, иначе
+// или при ошибке декодирования читается с диска
+static void load_item(
+    BatchJob* job,
+    BatchItem* item,
+    const uint8_t* data,
+    int64_t size
+) {
+    const char* input = job->inputs->items[item->index];
+    BMPRegion region;
+    if (data && size > 0) {
+        item->image = roi_decode(
+            data,
+            (size_t)size,
+            job->filter_list,
+            &item->window,
+            &region
+        );
+    }
+    if (!item->image) {
+        item->image = roi_load(
+            input,
+            job->filter_list,
+            &item->window,
+            &region,
+            NULL
+        );
+    }
+    if (!item->image) {
+        fprintf(
+            stderr,
+            "[Error] %s: не удалось загрузить изображение\n",
+            input
+        );
+    }
+}
+
+// Стадия чтения: загрузка изображений по порядку. С io_uring
+// вперед ставятся открытие и чтение до io_depth следующих
+// файлов, и изображение декодируется из буфера, когда его файл
+// прочитан
+static void* reader_main(void* context) {
+    BatchJob* job = (BatchJob*)context;
+    trace_thread_name("reader");
+
+    // Элементы переходят между потоками и берутся из пула,
+    // временная память загрузки - из арены потока
+    Arena* arena = arena_create(0);
+    arena_enter(arena);
+
+    Uring* ring = job->read_ring;
+    int depth = job->io_depth;
+    int queued = 0;
+
+    for (int i = 0; i < job->inputs->count; i++) {
+        for (; ring && queued < job->inputs->count &&
+               queued < i + depth;
+             queued++) {
+            if (job->outputs->items[queued]) {
+                uring_queue_read(
+                    ring,
+                    queued % depth,
+                    job->inputs->items[queued]
+                );
+            }
+        }
+
+        BatchItem* item =
+            (BatchItem*)pool_acquire(sizeof(BatchItem));
+        if (!item) {
+            break;
+        }
+        memset(item, 0, sizeof(BatchItem));
+        item->index = i;
+        ArenaMark mark = arena_mark(arena);
+
+        // Для файлов без имени результата загрузка не нужна.
+        // Файл, заполнивший буфер, мог не поместиться целиком
+        if (job->outputs->items[i] && ring) {
+            int64_t size = uring_wait(ring, i % depth);
+            int whole = size < (int64_t)IC_URING_BUFFER_SIZE;
+            load_item(
+                job,
+                item,
+                whole ? uring_buffer(ring, i % depth) : NULL,
+                size
+            );
+        } else if (job->outputs->items[i]) {
+            load_item(job, item, NULL, 0);
+        }
+        item->failed = !item->image;
+        arena_rewind(arena, mark);
+
+        spsc_queue_push(job->loaded, item);
+    }
+
+    spsc_queue_close(job->loaded);
+    arena_enter(NULL);
+    arena_destroy(arena);
+    return NULL;
+}
+
+// Итог сохранения элемента: сообщение и подсчет ошибок.
+// Изображение и элемент освобождаются
+static void finish_item(
+    BatchJob* job,
+    BatchItem* item,
+    int save_result
+) {
+    const char* input = job->inputs->items[item->index];
+    const char* output = job->outputs->items[item->index];
+
+    if (!item->failed && save_result == ALL_OK) {
+        printf("[Success] %s -> %s\n", input, output);
+    } else if (!item->failed) {
+        fprintf(
+            stderr,
+            "[Error] %s: ошибка сохранения в '%s' "
+            "(код: %d)\n",
+            input,
+            output,
+            save_result
+        );
+        item->failed = 1;
+    }
+
+    job->failed += item->failed;
+    bmp_free(item->image);
+    pool_release(item, sizeof(BatchItem));
+}
+
+// Записи io_uring, ожидающие завершения, в порядке постановки
+typedef struct {
+    BatchItem** items; // По слотам кольца
+    size_t* sizes;     // Размеры файлов по слотам
+    int first;         // Номер старейшей записи
+    int count;
+} PendingWrites;
+
+// Ожидание старейшей записи кольца. Неудавшаяся запись
+// повторяется через bmp_save, чтобы код ошибки был тем же
+static void finish_oldest(
+    BatchJob* job,
+    PendingWrites* pending
+) {
+    int slot = pending->first % job->io_depth;
+    BatchItem* item = pending->items[slot];
+    int64_t written = uring_wait(job->write_ring, slot);
+
+    int save_result = ALL_OK;
+    if (written != (int64_t)pending->sizes[slot]) {
+        save_result = bmp_save(
+            item->image,
+            job->outputs->items[item->index]
+        );
+    }
+    finish_item(job, item, save_result);
+
+    pending->first++;
+    pending->count--;
+}
+
+// Стадия записи с io_uring: изображение кодируется в буфер
+// слота, а открытие, запись и закрытие файла уходят в кольцо.
+// Итоги подводятся в порядке изображений. Файлы больше буфера
+// пишутся через bmp_save
+static void write_with_ring(BatchJob* job, Arena* arena) {
+    int depth = job->io_depth;
+    PendingWrites pending = {
+        (BatchItem**)calloc(depth, sizeof(BatchItem*)),
+        (size_t*)calloc(depth, sizeof(size_t)),
+        0,
+        0
+    };
+
+    void* pointer;
+    while (spsc_queue_pop(job->processed, &pointer)) {
+        BatchItem* item = (BatchItem*)pointer;
+        ArenaMark mark = arena_mark(arena);
+        const char* output = job->outputs->items[item->index];
+
+        size_t size =
+            item->failed ? 0 : bmp_encoded_size(item->image);
+        if (item->failed || !pending.items || !pending.sizes ||
+            size > IC_URING_BUFFER_SIZE) {
+            // Сообщения идут по порядку: сначала ожидающие
+            while (pending.count > 0) {
+                finish_oldest(job, &pending);
+            }
+            int save_result = item->failed
+                ? ALL_OK
+                : bmp_save(item->image, output);
+            finish_item(job, item, save_result);
+            arena_rewind(arena, mark);
+            continue;
+        }
+
+        if (pending.count == depth) {
+            finish_oldest(job, &pending);
+        }
+
+        int slot = (pending.first + pending.count) % depth;
+        uint8_t* buffer = uring_buffer(job->write_ring, slot);
+        bmp_encode_into(item->image, buffer);
+        uring_queue_write(job->write_ring, slot, output, size);
+        pending.items[slot] = item;
+        pending.sizes[slot] = size;
+        pending.count++;
+        arena_rewind(arena, mark);
+    }
+
+    while (pending.count > 0) {
+        finish_oldest(job, &pending);
+    }
+    free(pending.items);
+    free(pending.sizes);
+}
+
+// Стадия записи через bmp_save
+static void write_serial(BatchJob* job, Arena* arena) {
+    void* pointer;
+    while (spsc_queue_pop(job->processed, &pointer)) {
+        BatchItem* item = (BatchItem*)pointer;
+        ArenaMark mark = arena_mark(arena);
+        const char* output = job->outputs->items[item->index];
+
+        int save_result = item->failed
+            ? ALL_OK
+            : bmp_save(item->image, output);
+        finish_item(job, item, save_result);
+        arena_rewind(arena, mark);
+    }
+}
+
+// Стадия записи: сохранение результатов и подсчет ошибок
+static void* writer_main(void* context) {
+    BatchJob* job = (BatchJob*)context;
+    trace_thread_name("writer");
+
+    Arena* arena = arena_create(0);
+    arena_enter(arena);
+
+    if (job->write_ring) {
+        write_with_ring(job, arena);
+    } else {
+        write_serial(job, arena);
+    }
+
+    arena_enter(NULL);
+    arena_destroy(arena);
+    return NULL;
+}
+
+// Задача планировщика: применение цепочки к одному изображению
+// группы
+static void process_task(void* context, int index, int worker) {
+    (void)worker;
+    BatchJob* job = (BatchJob*)context;
+    BatchItem* item = job->group[index];
+
+    if (item->failed) {
+        return;
+    }
+
+    if (apply_filters_window(
+            &item->image,
+            job->filter_list,
+            &item->window,
+            job->execution
+        ) < 0) {
+        fprintf(
+            stderr,
+            "[Error] %s: ошибка применения фильтров\n",
+            job->inputs->items[item->index]
+        );
+        item->failed = 1;
+    }
+}
+
+int batch_run(
+    const char* source,
+    const char* output,
+    Filter* filter_list,
+    const Execution* execution,
+    int jobs,
+    int io_depth
+) {
+    PathList inputs = { NULL, 0, 0 };
+    PathList outputs = { NULL, 0, 0 };
+
+    if (collect_inputs(source, &inputs) != 0) {
+        fprintf(
+            stderr,
+            "[Error] Не удалось получить список файлов из '%s'\n",
+            source
+        );
+        path_list_free(&inputs);
+        return -1;
+    }
+
+    if (inputs.count == 0) {
+        fprintf(stderr, "[Error] В '%s' нет изображений\n", source);
+        path_list_free(&inputs);
+        return -1;
+    }
+
+    // Имена результатов и их директории готовятся заранее, в
+    // одном потоке
+    outputs.items = (char**)calloc(inputs.count, sizeof(char*));
+    if (!outputs.items) {
+        path_list_free(&inputs);
+        return -1;
+    }
+    outputs.count = inputs.count;
+    outputs.capacity = inputs.count;
+
+    for (int i = 0; i < inputs.count; i++) {
+        char path[1024];
+        if (expand_output(
+                output,
+                inputs.items[i],
+                i + 1,
+                path,
+                sizeof(path)
+            ) != 0) {
+            fprintf(
+                stderr,
+                "[Error] %s: некорректный шаблон '%s'\n",
+                inputs.items[i],
+                output
+            );
+            continue;
+        }
+
+        char directory_buffer[1024];
+        char* directory = get_directory_from_path(
+            path,
+            directory_buffer,
+            sizeof(directory_buffer)
+        );
+        if (directory &&
+            create_output_directory_recursive(directory) != 0) {
+            fprintf(
+                stderr,
+                "[Error] Не удалось создать директорию '%s'\n",
+                directory
+            );
+            continue;
+        }
+
+        outputs.items[i] = ic_strdup(path);
+    }
+
+    int workers = scheduler_workers(execution->scheduler);
+    if (jobs <= 0) {
+        jobs = workers;
+    }
+    if (jobs > inputs.count) {
+        jobs = inputs.count;
+    }
+
+    printf(
+        "[Info] Изображений в пакете: %d, в группе обработки: "
+        "%d, потоков: %d\n",
+        inputs.count,
+        jobs,
+        workers
+    );
+
+    // Кольца io_uring для чтения и записи. Без поддержки ядра
+    // файлы читаются и пишутся как обычно
+    Uring* read_ring = NULL;
+    Uring* write_ring = NULL;
+    if (io_depth > BATCH_MAX_IO_DEPTH) {
+        io_depth = BATCH_MAX_IO_DEPTH;
+    }
+    if (io_depth > inputs.count) {
+        io_depth = inputs.count;
+    }
+    if (io_depth > 0) {
+        read_ring =
+            uring_create(io_depth, IC_URING_BUFFER_SIZE);
+        write_ring =
+            uring_create(io_depth, IC_URING_BUFFER_SIZE);
+        if (read_ring && write_ring) {
+            printf(
+                "[Info] Ввод-вывод через io_uring, файлов в "
+                "работе: %d\n",
+                io_depth
+            );
+        } else {
+            printf(
+                "[Info] io_uring недоступен, файлы читаются и "
+                "пишутся через stdio\n"
+            );
+            uring_destroy(read_ring);
+            uring_destroy(write_ring);
+            read_ring = NULL;
+            write_ring = NULL;
+        }
+    }
+
+    // Конвейер: поток чтения загружает следующие изображения,
+    // поток записи сохраняет предыдущие, а текущий поток
+    // применяет цепочку к группам до jobs изображений на всех
+    // рабочих потоках. Очереди ограничивают число изображений в
+    // памяти
+    BatchJob job = { &inputs, &outputs, filter_list, execution,
+                     spsc_queue_create(jobs),
+                     spsc_queue_create(jobs),
+                     (BatchItem**)malloc(jobs * sizeof(BatchItem*)),
+                     0,
+                     read_ring,
+                     write_ring,
+                     io_depth };
+
+    pthread_t reader;
+    pthread_t writer;
+    int started = job.loaded && job.processed && job.group;
+
+    if (started && pthread_create(&reader, NULL, reader_main, &job)) {
+        started = 0;
+    }
+    if (started && pthread_create(&writer, NULL, writer_main, &job)) {
+        // Чтение уже идёт: дочитываем очередь, ничего не делая
+        void* pointer;
+        while (spsc_queue_pop(job.loaded, &pointer)) {
+            bmp_free(((BatchItem*)pointer)->image);
+            pool_release(pointer, sizeof(BatchItem));
+        }
+        pthread_join(reader, NULL);
+        started = 0;
+    }
+
+    if (!started) {
+        fprintf(stderr, "[Error] Не удалось запустить конвейер\n");
+        spsc_queue_free(job.loaded);
+        spsc_queue_free(job.processed);
+        free(job.group);
+        uring_destroy(read_ring);
+        uring_destroy(write_ring);
+        path_list_free(&inputs);
+        path_list_free(&outputs);
+        return -1;
+    }
+
+    // Задачи групп, выполняемые текущим потоком, берут
+    // временную память из его арены
+    Arena* arena = arena_create(0);
+    Arena* previous = arena_enter(arena);
+
+    void* pointer;
+    while (spsc_queue_pop(job.loaded, &pointer)) {
+        // Группа - первое изображение и уже загруженные следом
+        int count = 0;
+        job.group[count++] = (BatchItem*)pointer;
+        while (count < jobs &&
+               spsc_queue_try_pop(job.loaded, &pointer)) {
+            job.group[count++] = (BatchItem*)pointer;
+        }
+
+        scheduler_parallel_for(
+            execution->scheduler,
+            count,
+            process_task,
+            &job
+        );
+
+        for (int i = 0; i < count; i++) {
+            spsc_queue_push(job.processed, job.group[i]);
+        }
+    }
+    spsc_queue_close(job.processed);
+    arena_enter(previous);
+    arena_destroy(arena);
+
+    pthread_join(reader, NULL);
+    pthread_join(writer, NULL);
+
+    spsc_queue_free(job.loaded);
+    spsc_queue_free(job.processed);
+    free(job.group);
+    uring_destroy(read_ring);
+    uring_destroy(write_ring);
+
+    printf(
+        "[Info] Обработано изображений: %d из %d\n",
+        inputs.count - job.failed,
+        inputs.count
+    );
+
+    path_list_free(&inputs);
+    path_list_free(&outputs);
+
+    return job.failed;
+}
@@ -1,11 +1,32 @@
+#define _GNU_SOURCE
+
 #include <stdio.h>
 
+#include "arena.h"
 #include "bmp.h"
 #include "defines.h"
+#include "pool.h"
+#include "trace.h"
 
 #include <stdlib.h>
 #include <string.h>
 
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+// Изображения от этого размера файла сохраняются через
+// отображение файла в память
+#define BMP_MAP_THRESHOLD ((size_t)256 * 1024)
+
 // Вспомогательная функция для вычисления размера строки с
 // выравниванием
 static uint32_t calculate_row_size(int32_t width) {
@@ -15,14 +36,99 @@ static uint32_t calculate_row_size(int32_t width) {
     return row_size + padding;
 }
 
-// Создание нового BMP изображения
-BMPImage* bmp_create(int32_t width, int32_t height) {
+// Пересчёт полей заголовков, зависящих от размеров
+static void update_size_fields(BMPImage* image) {
+    int32_t height = image->info_header.height;
+    uint32_t row_size =
+        calculate_row_size(image->info_header.width);
+    image->info_header.image_size =
+        row_size * (height < 0 ? -height : height);
+    image->file_header.file_size =
+        image->file_header.data_offset +
+        image->info_header.image_size;
+}
+
+// Раскладка указателей на строки по непрерывному буферу
+static void layout_rows(
+    BMPImage* image,
+    int32_t width,
+    int32_t abs_height
+) {
+    for (int32_t i = 1; i < abs_height; i++) {
+        image->pixels[i] = image->pixels[i - 1] + width;
+    }
+}
+
+// Распаковка строки файла (BGR) в пиксели
+static void unpack_row(
+    const uint8_t* row,
+    int32_t width,
+    RGBPixel* pixels
+) {
+    for (int32_t col = 0; col < width; col++) {
+        pixels[col].blue = row[col * 3];
+        pixels[col].green = row[col * 3 + 1];
+        pixels[col].red = row[col * 3 + 2];
+    }
+}
+
+// Упаковка пикселей в строку файла (BGR)
+static void pack_row(
+    const RGBPixel* pixels,
+    int32_t width,
+    uint8_t* row
+) {
+    for (int32_t col = 0; col < width; col++) {
+        row[col * 3] = pixels[col].blue;
+        row[col * 3 + 1] = pixels[col].green;
+        row[col * 3 + 2] = pixels[col].red;
+    }
+}
+
+// Выделение памяти под строки и пиксели изображения
+static int allocate_pixels(
+    BMPImage* image,
+    int32_t width,
+    int32_t abs_height
+) {
+    // Буферы берутся из пула, их вместимость - весь блок
+    // пула, которым может воспользоваться bmp_reshape
+    size_t rows_size = (size_t)abs_height * sizeof(RGBPixel*);
+    image->pixels = (RGBPixel**)pool_acquire(rows_size);
+    if (!image->pixels) {
+        return IC_BMP_ERROR_ALLOCATING_BUFFER;
+    }
+
+    size_t pixels_size =
+        (size_t)abs_height * width * sizeof(RGBPixel);
+    image->pixels[0] = (RGBPixel*)pool_acquire(pixels_size);
+    if (!image->pixels[0]) {
+        pool_release(image->pixels, rows_size);
+        image->pixels = NULL;
+        return IC_BMP_ERROR_ALLOCATING_BUFFER;
+    }
+
+    image->capacity =
+        pool_block_size(pixels_size) / sizeof(RGBPixel);
+    image->row_capacity = (int32_t)(
+        pool_block_size(rows_size) / sizeof(RGBPixel*)
+    );
+    image->parent = NULL;
+
+    // Инициализируем указатели на строки
+    layout_rows(image, width, abs_height);
+    return ALL_OK;
+}
+
+// Создание нового BMP изображения без обнуления пикселей
+BMPImage*
+bmp_create_uninitialized(int32_t width, int32_t height) {
     if (width <= 0 || height <= 0) {
         return NULL;
     }
 
     // Выделяем память для структуры изображения
-    BMPImage* image = (BMPImage*)malloc(sizeof(BMPImage));
+    BMPImage* image = (BMPImage*)pool_acquire(sizeof(BMPImage));
     if (!image) {
         return NULL;
     }
@@ -47,203 +153,552 @@ BMPImage* bmp_create(int32_t width, int32_t height) {
     image->info_header.colors_important = 0;
 
     // Вычисляем размер строки с учетом выравнивания
-    uint32_t row_size = calculate_row_size(width);
-    image->info_header.image_size =
-        row_size * (height < 0 ? -height : height);
-    image->file_header.file_size =
-        image->file_header.data_offset +
-        image->info_header.image_size;
+    update_size_fields(image);
 
-    // Выделяем память для массива указателей на строки
+    // Выделяем память для строк и пикселей
     int32_t abs_height = height < 0 ? -height : height;
-    image->pixels =
-        (RGBPixel**)malloc(abs_height * sizeof(RGBPixel*));
-    if (!image->pixels) {
-        free(image);
+    if (allocate_pixels(image, width, abs_height) != ALL_OK) {
+        pool_release(image, sizeof(BMPImage));
         return NULL;
     }
 
-    // Выделяем память для всех пикселей
-    image->pixels[0] =
-        (RGBPixel*)malloc(abs_height * width * sizeof(RGBPixel));
-    if (!image->pixels[0]) {
-        free(image->pixels);
-        free(image);
-        return NULL;
-    }
+    return image;
+}
 
-    // Инициализируем указатели на строки
-    for (int32_t i = 1; i < abs_height; i++) {
-        image->pixels[i] = image->pixels[i - 1] + width;
+// Создание нового BMP изображения
+BMPImage* bmp_create(int32_t width, int32_t height) {
+    BMPImage* image = bmp_create_uninitialized(width, height);
+    if (!image) {
+        return NULL;
     }
 
     // Зануляем все пиксели (черный цвет)
     memset(
         image->pixels[0],
         0,
-        abs_height * width * sizeof(RGBPixel)
+        (size_t)height * width * sizeof(RGBPixel)
     );
 
     return image;
 }
 
-// Загрузка BMP изображения из файла
-BMPImage* bmp_load(const char* filename) {
-    FILE* file = fopen(filename, "rb");
-    if (!file) {
+// Изменение размеров изображения без перевыделения памяти
+int bmp_reshape(BMPImage* image, int32_t width, int32_t height) {
+    if (!image || !image->pixels || width <= 0 || height == 0) {
+        return IC_BMP_ERROR_CAPACITY;
+    }
+
+    // Строки представления указывают в чужой буфер
+    if (image->parent) {
+        return IC_BMP_ERROR_CAPACITY;
+    }
+
+    int32_t abs_height = height < 0 ? -height : height;
+    if (abs_height > image->row_capacity ||
+        (size_t)abs_height * width > image->capacity) {
+        return IC_BMP_ERROR_CAPACITY;
+    }
+
+    image->info_header.width = width;
+    image->info_header.height = height;
+    update_size_fields(image);
+    layout_rows(image, width, abs_height);
+
+    return ALL_OK;
+}
+
+// Создание представления области изображения
+BMPImage* bmp_create_view(
+    BMPImage* parent,
+    int32_t x,
+    int32_t y,
+    int32_t width,
+    int32_t height
+) {
+    if (!parent || !parent->pixels || x < 0 || y < 0 ||
+        width <= 0 || height <= 0) {
         return NULL;
     }
 
-    // Читаем файловый заголовок
-    BMPFileHeader file_header;
-    if (fread(&file_header, sizeof(BMPFileHeader), 1, file) !=
-        1) {
-        fclose(file);
+    int32_t parent_height = parent->info_header.height;
+    int32_t abs_parent_height =
+        parent_height < 0 ? -parent_height : parent_height;
+
+    if (x + width > parent->info_header.width ||
+        y + height > abs_parent_height) {
         return NULL;
     }
 
-    // Проверяем сигнатуру
-    if (file_header.signature != 0x4D42) { // 'BM'
-        fclose(file);
+    BMPImage* view = (BMPImage*)pool_acquire(sizeof(BMPImage));
+    if (!view) {
         return NULL;
     }
 
-    // Читаем DIB заголовок
-    BMPInfoHeader info_header;
-    if (fread(&info_header, sizeof(BMPInfoHeader), 1, file) !=
-        1) {
-        fclose(file);
+    // Строки массива pixels всегда идут сверху вниз, поэтому
+    // представление - это смещенные указатели на строки родителя
+    view->pixels =
+        (RGBPixel**)pool_acquire(height * sizeof(RGBPixel*));
+    if (!view->pixels) {
+        pool_release(view, sizeof(BMPImage));
         return NULL;
     }
 
-    // Проверяем, что это BITMAPINFOHEADER (размер 40)
-    if (info_header.header_size != 40) {
-        fclose(file);
+    for (int32_t i = 0; i < height; i++) {
+        view->pixels[i] = parent->pixels[y + i] + x;
+    }
+
+    view->file_header = parent->file_header;
+    view->info_header = parent->info_header;
+    view->info_header.width = width;
+    view->info_header.height =
+        parent_height < 0 ? -height : height;
+    update_size_fields(view);
+
+    // Вместимость строк нужна только для возврата их в пул
+    view->capacity = 0;
+    view->row_capacity = height;
+
+    // Представление представления ссылается сразу на владельца
+    // пикселей, промежуточное представление больше не нужно
+    if (parent->parent) {
+        view->parent = bmp_detach_view(parent);
+    } else {
+        view->parent = parent;
+    }
+
+    return view;
+}
+
+// Отделение представления от владельца пикселей
+BMPImage* bmp_detach_view(BMPImage* view) {
+    if (!view) {
         return NULL;
     }
 
+    BMPImage* parent = view->parent;
+    pool_release(
+        view->pixels,
+        (size_t)view->row_capacity * sizeof(RGBPixel*)
+    );
+    pool_release(view, sizeof(BMPImage));
+    return parent;
+}
+
+// Заполнение заимствующего представления
+void bmp_borrow_view(
+    BMPImage* view,
+    RGBPixel** rows,
+    const BMPImage* parent,
+    const BMPRegion* region
+) {
+    // Строки идут по возрастанию, поэтому сдвиг представления
+    // внутри самого себя безопасен
+    for (int32_t i = 0; i < region->height; i++) {
+        rows[i] = parent->pixels[region->y + i] + region->x;
+    }
+
+    int32_t parent_height = parent->info_header.height;
+    if (view != parent) {
+        view->file_header = parent->file_header;
+        view->info_header = parent->info_header;
+    }
+    view->pixels = rows;
+    view->info_header.width = region->width;
+    view->info_header.height =
+        parent_height < 0 ? -region->height : region->height;
+    update_size_fields(view);
+
+    view->capacity = 0;
+    view->row_capacity = 0;
+    view->parent = NULL;
+}
+
+// Чтение и проверка заголовков из открытого файла
+static int check_headers(
+    const BMPFileHeader* file_header,
+    const BMPInfoHeader* info_header
+);
+
+static int read_headers(
+    FILE* file,
+    BMPFileHeader* file_header,
+    BMPInfoHeader* info_header
+) {
+    // Читаем файловый заголовок
+    if (fread(file_header, sizeof(BMPFileHeader), 1, file) != 1) {
+        return IC_BMP_ERROR_INVALID_SIGNATURE;
+    }
+
+    // Проверяем сигнатуру
+    if (file_header->signature != 0x4D42) { // 'BM'
+        return IC_BMP_ERROR_INVALID_SIGNATURE;
+    }
+
+    // Читаем DIB заголовок
+    if (fread(info_header, sizeof(BMPInfoHeader), 1, file) != 1) {
+        return IC_BMP_ERROR_INVALID_DIB;
+    }
+
+    return check_headers(file_header, info_header);
+}
+
+// Проверка прочитанных заголовков
+static int check_headers(
+    const BMPFileHeader* file_header,
+    const BMPInfoHeader* info_header
+) {
+    // Проверяем сигнатуру
+    if (file_header->signature != 0x4D42) { // 'BM'
+        return IC_BMP_ERROR_INVALID_SIGNATURE;
+    }
+
+    // Проверяем, что это BITMAPINFOHEADER (размер 40)
+    if (info_header->header_size != 40) {
+        return IC_BMP_ERROR_INVALID_DIB;
+    }
+
     // Проверяем, что это 24-битное изображение без сжатия
-    if (info_header.bits_per_pixel != 24 ||
-        info_header.compression != 0) {
-        fclose(file);
-        return NULL;
+    if (info_header->bits_per_pixel != 24 ||
+        info_header->compression != 0) {
+        return IC_BMP_ERROR_INVALID_BPP;
     }
 
     // Проверяем ширину и высоту
-    if (info_header.width <= 0 || info_header.height == 0) {
-        fclose(file);
+    if (info_header->width <= 0 || info_header->height == 0) {
+        return IC_BMP_ERROR_INVALID_DIB;
+    }
+
+    return ALL_OK;
+}
+
+// Чтение заголовков BMP файла без загрузки пикселей
+int bmp_read_headers(
+    const char* filename,
+    BMPFileHeader* file_header,
+    BMPInfoHeader* info_header
+) {
+    if (!filename) {
+        return IC_BMP_ERROR_NULL_FILENAME;
+    }
+
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        return IC_ERROR_OPENING_FILE;
+    }
+
+    int error = read_headers(file, file_header, info_header);
+    fclose(file);
+    return error;
+}
+
+// Загрузка BMP изображения из файла
+BMPImage* bmp_load(const char* filename) {
+    return bmp_load_region(filename, NULL);
+}
+
+// Расположение строк загружаемой области в файле
+typedef struct {
+    const BMPRegion* region;
+    uint32_t data_offset;
+    int32_t file_width;
+    int32_t file_height; // Со знаком: порядок строк в файле
+    uint32_t row_size; // Строка файла с выравниванием
+} RowLayout;
+
+// Первая строка файла, покрывающая строки [first, last)
+// области. В BMP строки идут снизу вверх, если высота
+// положительная, поэтому такие строки файла идут подряд
+static int32_t first_file_row(
+    const RowLayout* layout,
+    int32_t first,
+    int32_t last
+) {
+    int32_t abs_height = abs(layout->file_height);
+    return layout->file_height > 0
+        ? abs_height - layout->region->y - last
+        : layout->region->y + first;
+}
+
+// Строка области по строке файла. Строки в памяти всегда идут
+// сверху вниз
+static int32_t
+region_row(const RowLayout* layout, int32_t file_row) {
+    int32_t abs_height = abs(layout->file_height);
+    int32_t visual_row = layout->file_height > 0
+        ? abs_height - 1 - file_row
+        : file_row;
+    return visual_row - layout->region->y;
+}
+
+// Чтение строк области одним потоком
+static int
+read_rows(FILE* file, const RowLayout* layout, BMPImage* image) {
+    const BMPRegion* region = layout->region;
+    uint32_t read_size = (uint32_t)region->width * 3;
+    uint8_t* row_buffer = (uint8_t*)scratch_alloc(read_size);
+    if (!row_buffer) {
+        return IC_BMP_ERROR_ALLOCATING_BUFFER;
+    }
+
+    int32_t first_row =
+        first_file_row(layout, 0, region->height);
+    int32_t last_row = first_row + region->height;
+
+    // Читаем строки в порядке файла, переходя к нужному столбцу
+    // только если область не продолжает предыдущую строку
+    long expected = -1;
+    for (int32_t file_row = first_row; file_row < last_row;
+         file_row++) {
+        long offset = (long)layout->data_offset +
+            (long)file_row * layout->row_size +
+            (long)region->x * 3;
+
+        if ((offset != expected &&
+             fseek(file, offset, SEEK_SET) != 0) ||
+            fread(row_buffer, 1, read_size, file) != read_size) {
+            scratch_free(row_buffer);
+            return IC_ERROR_DECODING;
+        }
+        expected = offset + read_size;
+
+        // Копируем пиксели из буфера строки
+        unpack_row(
+            row_buffer,
+            region->width,
+            image->pixels[region_row(layout, file_row)]
+        );
+    }
+
+    scratch_free(row_buffer);
+    return ALL_OK;
+}
+
+#ifndef _WIN32
+
+// Наибольшая порция одного чтения полосы, байт
+#define BMP_IO_CHUNK ((size_t)1024 * 1024)
+
+// Чтение size байт файла fd со смещения offset. Возвращает 0
+// при успехе
+static int
+read_at(int fd, uint8_t* data, size_t size, off_t offset) {
+    while (size > 0) {
+        ssize_t count = pread(fd, data, size, offset);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return 1;
+        }
+        data += count;
+        size -= count;
+        offset += count;
+    }
+    return 0;
+}
+
+// Чтение строк области полосами
+typedef struct {
+    const RowLayout* layout;
+    BMPImage* image;
+    int fd;
+    int bands;
+    int error;
+} LoadJob;
+
+// Задача чтения: строки полосы index читаются порциями и
+// распаковываются тем потоком, который потом обрабатывает эту
+// полосу (scheduler_parallel_bands)
+static void load_band(void* context, int index, int worker) {
+    (void)worker;
+    LoadJob* job = (LoadJob*)context;
+    const RowLayout* layout = job->layout;
+    const BMPRegion* region = layout->region;
+
+    int32_t height = region->height;
+    int32_t first =
+        (int32_t)((int64_t)index * height / job->bands);
+    int32_t last =
+        (int32_t)((int64_t)(index + 1) * height / job->bands);
+    if (first == last ||
+        __atomic_load_n(&job->error, __ATOMIC_RELAXED)) {
+        return;
+    }
+
+    // Строки во всю ширину файла читаются по нескольку за раз,
+    // строки более узкой области - по одной
+    uint32_t read_size = (uint32_t)region->width * 3;
+    int32_t chunk_rows = 1;
+    if (region->width == layout->file_width &&
+        BMP_IO_CHUNK > layout->row_size) {
+        chunk_rows = (int32_t)(BMP_IO_CHUNK / layout->row_size);
+    }
+    uint8_t* buffer = (uint8_t*)scratch_alloc(
+        (size_t)(chunk_rows - 1) * layout->row_size + read_size
+    );
+    if (!buffer) {
+        __atomic_store_n(&job->error, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    int32_t first_row = first_file_row(layout, first, last);
+    int32_t last_row = first_row + (last - first);
+    for (int32_t file_row = first_row; file_row < last_row;
+         file_row += chunk_rows) {
+        int32_t rows = last_row - file_row < chunk_rows
+            ? last_row - file_row
+            : chunk_rows;
+        off_t offset = (off_t)layout->data_offset +
+            (off_t)file_row * layout->row_size +
+            (off_t)region->x * 3;
+        size_t size =
+            (size_t)(rows - 1) * layout->row_size + read_size;
+        if (read_at(job->fd, buffer, size, offset) != 0) {
+            __atomic_store_n(&job->error, 1, __ATOMIC_RELAXED);
+            break;
+        }
+
+        for (int32_t i = 0; i < rows; i++) {
+            int32_t row = region_row(layout, file_row + i);
+            unpack_row(
+                buffer + (size_t)i * layout->row_size,
+                region->width,
+                job->image->pixels[row]
+            );
+        }
+    }
+    scratch_free(buffer);
+}
+
+// Чтение строк области рабочими потоками scheduler через pread
+static int read_bands(
+    FILE* file,
+    const RowLayout* layout,
+    BMPImage* image,
+    Scheduler* scheduler
+) {
+    LoadJob job = { layout,
+                    image,
+                    fileno(file),
+                    scheduler_workers(scheduler),
+                    0 };
+    scheduler_parallel_bands(
+        scheduler,
+        job.bands,
+        load_band,
+        &job
+    );
+    return job.error ? IC_ERROR_DECODING : ALL_OK;
+}
+
+#endif // !_WIN32
+
+// Загрузка прямоугольной области BMP изображения. С несколькими
+// рабочими потоками строки читаются полосами параллельно
+static BMPImage* load_region(
+    const char* filename,
+    const BMPRegion* region,
+    Scheduler* scheduler
+) {
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
         return NULL;
     }
 
-    // Создаем структуру изображения
-    BMPImage* image = (BMPImage*)malloc(sizeof(BMPImage));
-    if (!image) {
+    BMPFileHeader file_header;
+    BMPInfoHeader info_header;
+    if (read_headers(file, &file_header, &info_header) !=
+        ALL_OK) {
         fclose(file);
         return NULL;
     }
 
-    // Копируем заголовки
-    image->file_header = file_header;
-    image->info_header = info_header;
-
-    int32_t width = info_header.width;
+    int32_t file_width = info_header.width;
     int32_t height = info_header.height;
     int32_t abs_height = height < 0 ? -height : height;
 
-    // Выделяем память для массива указателей на строки
-    image->pixels =
-        (RGBPixel**)malloc(abs_height * sizeof(RGBPixel*));
-    if (!image->pixels) {
-        free(image);
-        fclose(file);
-        return NULL;
+    // Без области читаем изображение целиком
+    BMPRegion full = { 0, 0, file_width, abs_height };
+    if (!region) {
+        region = &full;
     }
 
-    // Выделяем память для всех пикселей
-    image->pixels[0] =
-        (RGBPixel*)malloc(abs_height * width * sizeof(RGBPixel));
-    if (!image->pixels[0]) {
-        free(image->pixels);
-        free(image);
+    if (region->x < 0 || region->y < 0 || region->width <= 0 ||
+        region->height <= 0 ||
+        region->x + region->width > file_width ||
+        region->y + region->height > abs_height) {
         fclose(file);
         return NULL;
     }
 
-    // Инициализируем указатели на строки
-    for (int32_t i = 1; i < abs_height; i++) {
-        image->pixels[i] = image->pixels[i - 1] + width;
-    }
-
-    // Переходим к данным изображения
-    if (fseek(file, file_header.data_offset, SEEK_SET) != 0) {
-        bmp_free(image);
+    // Создаем структуру изображения
+    BMPImage* image = (BMPImage*)pool_acquire(sizeof(BMPImage));
+    if (!image) {
         fclose(file);
         return NULL;
     }
 
-    // Вычисляем размер строки с учетом выравнивания
-    uint32_t row_size = calculate_row_size(width);
+    // Копируем заголовки, оставляя размеры области
+    int32_t width = region->width;
+    image->file_header = file_header;
+    image->info_header = info_header;
+    image->info_header.width = width;
+    image->info_header.height =
+        height < 0 ? -region->height : region->height;
+    update_size_fields(image);
 
-    // Читаем данные изображения
-    uint8_t* row_buffer = (uint8_t*)malloc(row_size);
-    if (!row_buffer) {
-        bmp_free(image);
+    // Выделяем память для строк и пикселей
+    if (allocate_pixels(image, width, region->height) != ALL_OK) {
+        pool_release(image, sizeof(BMPImage));
         fclose(file);
         return NULL;
     }
 
-    // Определяем порядок строк (в BMP снизу вверх, если высота
-    // положительная)
-    int start_row, end_row, step;
-    if (height > 0) {
-        // Изображение снизу вверх
-        start_row = abs_height - 1;
-        end_row = -1;
-        step = -1;
+    // Читаем данные изображения
+    RowLayout layout = { region,
+                         file_header.data_offset,
+                         file_width,
+                         height,
+                         calculate_row_size(file_width) };
+    int error;
+#ifndef _WIN32
+    if (scheduler_workers(scheduler) > 1) {
+        error = read_bands(file, &layout, image, scheduler);
     } else {
-        // Изображение сверху вниз (отрицательная высота)
-        start_row = 0;
-        end_row = abs_height;
-        step = 1;
-        height = -height; // Делаем высоту положительной для
-                          // упрощения
-    }
-
-    // Читаем строки
-    for (int32_t row = start_row; row != end_row; row += step) {
-        if (fread(row_buffer, 1, row_size, file) != row_size) {
-            free(row_buffer);
-            bmp_free(image);
-            fclose(file);
-            return NULL;
-        }
-
-        // Копируем пиксели из буфера строки
-        for (int32_t col = 0; col < width; col++) {
-            image->pixels[row][col].blue = row_buffer[col * 3];
-            image->pixels[row][col].green =
-                row_buffer[col * 3 + 1];
-            image->pixels[row][col].red =
-                row_buffer[col * 3 + 2];
-        }
+        error = read_rows(file, &layout, image);
     }
+#else
+    error = read_rows(file, &layout, image);
+#endif
 
-    free(row_buffer);
     fclose(file);
+    if (error != ALL_OK) {
+        bmp_free(image);
+        return NULL;
+    }
     return image;
 }
 
-// Сохранение BMP изображения в файл
-int bmp_save(BMPImage* image, const char* filename) {
-    if (!image || !filename) {
-        return IC_BMP_ERROR_SAVING_FILE;
-    }
+BMPImage* bmp_load_region(
+    const char* filename,
+    const BMPRegion* region
+) {
+    return bmp_load_parallel(filename, region, NULL);
+}
 
-    FILE* file = fopen(filename, "wb");
-    if (!file) {
-        return IC_ERROR_OPENING_FILE;
-    }
+BMPImage* bmp_load_parallel(
+    const char* filename,
+    const BMPRegion* region,
+    Scheduler* scheduler
+) {
+    int64_t start = trace_begin();
+    BMPImage* image = load_region(filename, region, scheduler);
+    trace_end("bmp_load", start, -1);
+    return image;
+}
 
+// Запись BMP изображения в открытый поток. Поток закрывается
+static int save_stream(BMPImage* image, FILE* file) {
     // Записываем заголовки
     if (fwrite(
             &image->file_header,
@@ -268,7 +723,8 @@ int bmp_save(BMPImage* image, const char* filename) {
     uint32_t row_size = calculate_row_size(width);
 
     // Подготавливаем буфер для строки с выравниванием
-    uint8_t* row_buffer = (uint8_t*)calloc(row_size, 1);
+    uint8_t* row_buffer =
+        (uint8_t*)scratch_calloc(row_size, 1);
     if (!row_buffer) {
         fclose(file);
         return IC_BMP_ERROR_ALLOCATING_BUFFER;
@@ -292,37 +748,662 @@ int bmp_save(BMPImage* image, const char* filename) {
     // Записываем данные изображения
     for (int32_t row = start_row; row != end_row; row += step) {
         // Копируем пиксели в буфер строки
-        for (int32_t col = 0; col < width; col++) {
-            row_buffer[col * 3] = image->pixels[row][col].blue;
-            row_buffer[col * 3 + 1] =
-                image->pixels[row][col].green;
-            row_buffer[col * 3 + 2] =
-                image->pixels[row][col].red;
-        }
+        pack_row(image->pixels[row], width, row_buffer);
 
         // Записываем строку с выравниванием
         if (fwrite(row_buffer, 1, row_size, file) != row_size) {
-            free(row_buffer);
+            scratch_free(row_buffer);
             fclose(file);
             return IC_BMP_ERROR_WRITING_ROW;
         }
     }
 
-    free(row_buffer);
+    scratch_free(row_buffer);
     fclose(file);
     return ALL_OK;
 }
 
+#ifdef _WIN32
+
+// Сохранение BMP изображения в файл
+static int save_file(
+    BMPImage* image,
+    const char* filename,
+    Scheduler* scheduler
+) {
+    (void)scheduler;
+    if (!image || !filename) {
+        return IC_BMP_ERROR_SAVING_FILE;
+    }
+
+    FILE* file = fopen(filename, "wb");
+    if (!file) {
+        return IC_ERROR_OPENING_FILE;
+    }
+    return save_stream(image, file);
+}
+
+#else
+
+// Отображение пустого файла fd размером size для записи.
+// Возвращает NULL, если файл не отображается (не обычный файл,
+// не хватило места). Поток после этого пишет файл с начала
+// целиком, поэтому уже заданный размер ему не мешает
+static uint8_t* map_output(int fd, size_t size) {
+    struct stat status;
+    if (size < BMP_MAP_THRESHOLD || fstat(fd, &status) != 0 ||
+        !S_ISREG(status.st_mode)) {
+        return NULL;
+    }
+
+    // Место резервируется заранее: запись в отображение при
+    // заполненном диске завершила бы процесс по SIGBUS
+    void* mapped = MAP_FAILED;
+    if (ftruncate(fd, (off_t)size) == 0 &&
+        posix_fallocate(fd, 0, (off_t)size) == 0) {
+        mapped = mmap(
+            NULL,
+            size,
+            PROT_READ | PROT_WRITE,
+            MAP_SHARED,
+            fd,
+            0
+        );
+    }
+    return mapped == MAP_FAILED ? NULL : (uint8_t*)mapped;
+}
+
+// Упаковка строк файла [first_row, last_row) в data - начало
+// пикселей файла
+static void pack_file_rows(
+    const BMPImage* image,
+    uint8_t* data,
+    int32_t first_row,
+    int32_t last_row
+) {
+    int32_t width = image->info_header.width;
+    int32_t height = image->info_header.height;
+    int32_t abs_height = height < 0 ? -height : height;
+    uint32_t row_size = calculate_row_size(width);
+
+    for (int32_t file_row = first_row; file_row < last_row;
+         file_row++) {
+        int32_t row =
+            height > 0 ? abs_height - 1 - file_row : file_row;
+        pack_row(
+            image->pixels[row],
+            width,
+            data + (size_t)file_row * row_size
+        );
+    }
+}
+
+// Упаковка строк в отображение файла полосами
+typedef struct {
+    const BMPImage* image;
+    uint8_t* data;
+    int bands;
+} SaveJob;
+
+// Задача записи: полоса index изображения упаковывается тем
+// потоком, который её обрабатывал
+static void save_band(void* context, int index, int worker) {
+    (void)worker;
+    SaveJob* job = (SaveJob*)context;
+    int32_t height = job->image->info_header.height;
+    int32_t abs_height = height < 0 ? -height : height;
+
+    int32_t bands = job->bands;
+    int32_t first =
+        (int32_t)((int64_t)index * abs_height / bands);
+    int32_t last =
+        (int32_t)((int64_t)(index + 1) * abs_height / bands);
+    if (height > 0) {
+        pack_file_rows(
+            job->image,
+            job->data,
+            abs_height - last,
+            abs_height - first
+        );
+    } else {
+        pack_file_rows(job->image, job->data, first, last);
+    }
+}
+
+// Запись BMP изображения прямо в отображение файла: строки
+// упаковываются на свои места за один проход, без буфера
+// строки и отдельного вызова записи на каждую строку. С
+// несколькими рабочими потоками полосы упаковываются
+// параллельно
+static void save_mapped(
+    BMPImage* image,
+    uint8_t* mapped,
+    Scheduler* scheduler
+) {
+    memcpy(mapped, &image->file_header, sizeof(BMPFileHeader));
+    memcpy(
+        mapped + sizeof(BMPFileHeader),
+        &image->info_header,
+        sizeof(BMPInfoHeader)
+    );
+
+    // Байты выравнивания уже нулевые: файл только что расширен
+    int32_t height = image->info_header.height;
+    uint8_t* data =
+        mapped + sizeof(BMPFileHeader) + sizeof(BMPInfoHeader);
+    if (scheduler_workers(scheduler) == 1) {
+        pack_file_rows(
+            image,
+            data,
+            0,
+            height < 0 ? -height : height
+        );
+        return;
+    }
+
+    SaveJob job = { image, data, scheduler_workers(scheduler) };
+    scheduler_parallel_bands(
+        scheduler,
+        job.bands,
+        save_band,
+        &job
+    );
+}
+
+// Сохранение BMP изображения в файл. Большие изображения
+// записываются через отображение файла в память, остальные и
+// файлы, которые нельзя отобразить (каналы, устройства), -
+// через поток
+static int save_file(
+    BMPImage* image,
+    const char* filename,
+    Scheduler* scheduler
+) {
+    if (!image || !filename) {
+        return IC_BMP_ERROR_SAVING_FILE;
+    }
+
+    int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        return IC_ERROR_OPENING_FILE;
+    }
+
+    int32_t height = image->info_header.height;
+    size_t size = sizeof(BMPFileHeader) + sizeof(BMPInfoHeader) +
+        (size_t)calculate_row_size(image->info_header.width) *
+            (size_t)(height < 0 ? -height : height);
+    uint8_t* mapped = map_output(fd, size);
+    if (mapped) {
+        save_mapped(image, mapped, scheduler);
+        int error = munmap(mapped, size) != 0;
+        error |= close(fd) != 0;
+        return error ? IC_BMP_ERROR_WRITING_ROW : ALL_OK;
+    }
+
+    FILE* file = fdopen(fd, "wb");
+    if (!file) {
+        close(fd);
+        return IC_ERROR_OPENING_FILE;
+    }
+    return save_stream(image, file);
+}
+
+#endif // _WIN32
+
+int bmp_save(BMPImage* image, const char* filename) {
+    return bmp_save_parallel(image, filename, NULL);
+}
+
+int bmp_save_parallel(
+    BMPImage* image,
+    const char* filename,
+    Scheduler* scheduler
+) {
+    int64_t start = trace_begin();
+    int result = save_file(image, filename, scheduler);
+    trace_end("bmp_save", start, -1);
+    return result;
+}
+
+#ifdef __linux__
+
+// Проверка, что файл in совпадает с тем, что запишет bmp_save
+// после bmp_load: заголовки сразу перед пикселями, поля размеров
+// верны, за данными ничего нет, выравнивание строк нулевое
+static int is_canonical(int in) {
+    BMPFileHeader file_header;
+    BMPInfoHeader info_header;
+    size_t headers_size =
+        sizeof(BMPFileHeader) + sizeof(BMPInfoHeader);
+    if (pread(in, &file_header, sizeof(BMPFileHeader), 0) !=
+            (ssize_t)sizeof(BMPFileHeader) ||
+        pread(
+            in,
+            &info_header,
+            sizeof(BMPInfoHeader),
+            sizeof(BMPFileHeader)
+        ) != (ssize_t)sizeof(BMPInfoHeader) ||
+        check_headers(&file_header, &info_header) != ALL_OK) {
+        return 0;
+    }
+
+    int32_t width = info_header.width;
+    int32_t height = info_header.height;
+    uint64_t abs_height = height < 0 ? -(int64_t)height : height;
+    uint32_t row_size = calculate_row_size(width);
+    uint64_t image_size = (uint64_t)row_size * abs_height;
+
+    struct stat status;
+    if (file_header.data_offset != headers_size ||
+        info_header.image_size != image_size ||
+        file_header.file_size != headers_size + image_size ||
+        fstat(in, &status) != 0 || !S_ISREG(status.st_mode) ||
+        (uint64_t)status.st_size != file_header.file_size) {
+        return 0;
+    }
+
+    uint32_t padding = row_size - (uint32_t)width * 3;
+    if (!padding) {
+        return 1;
+    }
+
+    // bmp_save пишет выравнивание нулями, в исходном файле там
+    // может быть что угодно
+    uint8_t* mapped = (uint8_t*)mmap(
+        NULL,
+        status.st_size,
+        PROT_READ,
+        MAP_PRIVATE,
+        in,
+        0
+    );
+    if (mapped == MAP_FAILED) {
+        return 0;
+    }
+
+    int canonical = 1;
+    uint8_t* end = mapped + headers_size + row_size - padding;
+    for (uint64_t row = 0; canonical && row < abs_height;
+         row++) {
+        for (uint32_t i = 0; i < padding; i++) {
+            canonical &= end[i] == 0;
+        }
+        end += row_size;
+    }
+    munmap(mapped, status.st_size);
+    return canonical;
+}
+
+// Копирование size байт из in в out силами ядра. copy_file_range
+// делает reflink, если файловая система его поддерживает. Между
+// файловыми системами на старых ядрах он недоступен, тогда
+// остаток копирует sendfile с тех же позиций
+static int copy_range(int in, int out, off_t size) {
+    off_t done = 0;
+    while (done < size) {
+        ssize_t copied =
+            copy_file_range(in, NULL, out, NULL, size - done, 0);
+        if (copied < 0 && errno == EINTR) {
+            continue;
+        }
+        if (copied <= 0) {
+            break;
+        }
+        done += copied;
+    }
+
+    while (done < size) {
+        ssize_t sent = sendfile(out, in, NULL, size - done);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return 1;
+        }
+        done += sent;
+    }
+    return 0;
+}
+
+int bmp_copy_file(const char* source, const char* destination) {
+    if (!source || !destination) {
+        return IC_BMP_ERROR_NULL_FILENAME;
+    }
+
+    int in = open(source, O_RDONLY);
+    if (in < 0) {
+        return IC_ERROR_OPENING_FILE;
+    }
+    if (!is_canonical(in)) {
+        close(in);
+        return IC_BMP_ERROR_NOT_CANONICAL;
+    }
+
+    // Файл открывается без усечения: если это сам источник,
+    // он уже совпадает с результатом
+    int out = open(destination, O_WRONLY | O_CREAT, 0666);
+    if (out < 0) {
+        close(in);
+        return IC_ERROR_OPENING_FILE;
+    }
+
+    // Каналы и устройства остаются пути через bmp_save
+    struct stat in_status, out_status;
+    if (fstat(out, &out_status) == 0 &&
+        !S_ISREG(out_status.st_mode)) {
+        close(out);
+        close(in);
+        return IC_BMP_ERROR_NOT_CANONICAL;
+    }
+
+    int error = fstat(in, &in_status) != 0 ||
+                fstat(out, &out_status) != 0;
+    if (!error && (in_status.st_dev != out_status.st_dev ||
+                   in_status.st_ino != out_status.st_ino)) {
+        error = ftruncate(out, 0) != 0 ||
+                copy_range(in, out, in_status.st_size) != 0;
+    }
+
+    error |= close(out) != 0;
+    close(in);
+    return error ? IC_BMP_ERROR_WRITING_ROW : ALL_OK;
+}
+
+#else
+
+int bmp_copy_file(const char* source, const char* destination) {
+    (void)source;
+    (void)destination;
+    return IC_BMP_ERROR_NOT_CANONICAL;
+}
+
+#endif // __linux__
+
+// Запись BMP файла частями
+struct _BMPWriter {
+    FILE* file;
+    int32_t width;
+    int32_t height; // Со знаком: порядок строк в файле
+    uint32_t row_size;
+    uint8_t* row_buffer; // Строка с нулевым выравниванием
+    int error;
+};
+
+BMPWriter* bmp_writer_open(
+    const char* filename,
+    const BMPFileHeader* file_header,
+    const BMPInfoHeader* info_header
+) {
+    if (!filename || !file_header || !info_header ||
+        info_header->width <= 0 || info_header->height == 0) {
+        return NULL;
+    }
+
+    BMPWriter* writer =
+        (BMPWriter*)scratch_calloc(1, sizeof(BMPWriter));
+    if (!writer) {
+        return NULL;
+    }
+
+    // Поля размеров пересчитываются так же, как для bmp_save
+    BMPImage header;
+    header.file_header = *file_header;
+    header.info_header = *info_header;
+    update_size_fields(&header);
+
+    writer->width = info_header->width;
+    writer->height = info_header->height;
+    writer->row_size = calculate_row_size(writer->width);
+    writer->row_buffer =
+        (uint8_t*)scratch_calloc(writer->row_size, 1);
+    writer->file = fopen(filename, "wb");
+
+    if (!writer->row_buffer || !writer->file ||
+        fwrite(
+            &header.file_header,
+            sizeof(BMPFileHeader),
+            1,
+            writer->file
+        ) != 1 ||
+        fwrite(
+            &header.info_header,
+            sizeof(BMPInfoHeader),
+            1,
+            writer->file
+        ) != 1) {
+        if (writer->file) {
+            fclose(writer->file);
+        }
+        scratch_free(writer->row_buffer);
+        scratch_free(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+int bmp_writer_rows(
+    BMPWriter* writer,
+    const BMPImage* image,
+    const BMPRegion* source,
+    int32_t row
+) {
+    int32_t abs_height =
+        writer->height < 0 ? -writer->height : writer->height;
+    if (source->width != writer->width || row < 0 ||
+        row + source->height > abs_height) {
+        writer->error = 1;
+        return IC_BMP_ERROR_WRITING_ROW;
+    }
+
+    long headers_size =
+        (long)(sizeof(BMPFileHeader) + sizeof(BMPInfoHeader));
+    for (int32_t i = 0; i < source->height; i++) {
+        // Строки в файле идут снизу вверх, если высота
+        // положительная
+        int32_t visual_row = row + i;
+        int32_t file_row = writer->height > 0
+            ? abs_height - 1 - visual_row
+            : visual_row;
+
+        pack_row(
+            image->pixels[source->y + i] + source->x,
+            writer->width,
+            writer->row_buffer
+        );
+
+        if (fseek(
+                writer->file,
+                headers_size + (long)file_row * writer->row_size,
+                SEEK_SET
+            ) != 0 ||
+            fwrite(
+                writer->row_buffer,
+                1,
+                writer->row_size,
+                writer->file
+            ) != writer->row_size) {
+            writer->error = 1;
+            return IC_BMP_ERROR_WRITING_ROW;
+        }
+    }
+    return ALL_OK;
+}
+
+int bmp_writer_close(BMPWriter* writer) {
+    if (!writer) {
+        return IC_BMP_ERROR_SAVING_FILE;
+    }
+
+    int error = writer->error;
+    if (fclose(writer->file) != 0) {
+        error = 1;
+    }
+    scratch_free(writer->row_buffer);
+    scratch_free(writer);
+    return error ? IC_BMP_ERROR_WRITING_ROW : ALL_OK;
+}
+
+// Декодирование BMP изображения из памяти
+BMPImage* bmp_decode(const uint8_t* data, size_t size) {
+    return bmp_decode_region(data, size, NULL);
+}
+
+// Декодирование области BMP изображения из памяти
+BMPImage* bmp_decode_region(
+    const uint8_t* data,
+    size_t size,
+    const BMPRegion* region
+) {
+    size_t headers_size =
+        sizeof(BMPFileHeader) + sizeof(BMPInfoHeader);
+    if (!data || size < headers_size) {
+        return NULL;
+    }
+
+    BMPFileHeader file_header;
+    BMPInfoHeader info_header;
+    memcpy(&file_header, data, sizeof(BMPFileHeader));
+    memcpy(
+        &info_header,
+        data + sizeof(BMPFileHeader),
+        sizeof(BMPInfoHeader)
+    );
+    if (check_headers(&file_header, &info_header) != ALL_OK) {
+        return NULL;
+    }
+
+    int32_t file_width = info_header.width;
+    int32_t height = info_header.height;
+    int32_t abs_height = height < 0 ? -height : height;
+    uint32_t row_size = calculate_row_size(file_width);
+
+    // Последняя строка может быть без выравнивания
+    if (file_header.data_offset > size ||
+        (size - file_header.data_offset) / row_size <
+            (size_t)abs_height - 1 ||
+        size - file_header.data_offset -
+                (size_t)(abs_height - 1) * row_size <
+            (size_t)file_width * 3) {
+        return NULL;
+    }
+
+    // Без области декодируем изображение целиком
+    BMPRegion full = { 0, 0, file_width, abs_height };
+    if (!region) {
+        region = &full;
+    }
+
+    if (region->x < 0 || region->y < 0 || region->width <= 0 ||
+        region->height <= 0 ||
+        region->x + region->width > file_width ||
+        region->y + region->height > abs_height) {
+        return NULL;
+    }
+
+    BMPImage* image = (BMPImage*)pool_acquire(sizeof(BMPImage));
+    if (!image) {
+        return NULL;
+    }
+    image->file_header = file_header;
+    image->info_header = info_header;
+    image->info_header.width = region->width;
+    image->info_header.height =
+        height < 0 ? -region->height : region->height;
+    update_size_fields(image);
+
+    if (allocate_pixels(image, region->width, region->height) !=
+        ALL_OK) {
+        pool_release(image, sizeof(BMPImage));
+        return NULL;
+    }
+
+    RowLayout layout = { region,
+                         file_header.data_offset,
+                         file_width,
+                         height,
+                         row_size };
+    const uint8_t* rows = data + file_header.data_offset;
+    int32_t first_row =
+        first_file_row(&layout, 0, region->height);
+    for (int32_t file_row = first_row;
+         file_row < first_row + region->height;
+         file_row++) {
+        unpack_row(
+            rows + (size_t)file_row * row_size + region->x * 3,
+            region->width,
+            image->pixels[region_row(&layout, file_row)]
+        );
+    }
+
+    return image;
+}
+
+size_t bmp_encoded_size(const BMPImage* image) {
+    int32_t height = image->info_header.height;
+    return sizeof(BMPFileHeader) + sizeof(BMPInfoHeader) +
+        (size_t)calculate_row_size(image->info_header.width) *
+        (size_t)(height < 0 ? -height : height);
+}
+
+void bmp_encode_into(const BMPImage* image, uint8_t* data) {
+    memcpy(data, &image->file_header, sizeof(BMPFileHeader));
+    memcpy(
+        data + sizeof(BMPFileHeader),
+        &image->info_header,
+        sizeof(BMPInfoHeader)
+    );
+
+    // Порядок строк как в bmp_save: снизу вверх для
+    // положительной высоты. Выравнивание пишется нулями
+    int32_t width = image->info_header.width;
+    int32_t height = image->info_header.height;
+    int32_t abs_height = height < 0 ? -height : height;
+    uint32_t row_size = calculate_row_size(width);
+    uint32_t packed = (uint32_t)width * 3;
+    uint8_t* rows =
+        data + sizeof(BMPFileHeader) + sizeof(BMPInfoHeader);
+    for (int32_t file_row = 0; file_row < abs_height; file_row++) {
+        int32_t row =
+            height > 0 ? abs_height - 1 - file_row : file_row;
+        uint8_t* target = rows + (size_t)file_row * row_size;
+        pack_row(image->pixels[row], width, target);
+        memset(target + packed, 0, row_size - packed);
+    }
+}
+
+int bmp_encode(const BMPImage* image, uint8_t** data, size_t* size) {
+    if (!image || !data || !size) {
+        return IC_BMP_ERROR_SAVING_FILE;
+    }
+
+    size_t total = bmp_encoded_size(image);
+    uint8_t* buffer = (uint8_t*)malloc(total);
+    if (!buffer) {
+        return IC_BMP_ERROR_ALLOCATING_BUFFER;
+    }
+    bmp_encode_into(image, buffer);
+
+    *data = buffer;
+    *size = total;
+    return ALL_OK;
+}
+
 // Очистка памяти, занятой изображением
 void bmp_free(BMPImage* image) {
-    if (image) {
+    if (image && image->parent) {
+        bmp_free(bmp_detach_view(image));
+    } else if (image) {
         if (image->pixels) {
-            if (image->pixels[0]) {
-                free(image->pixels[0]);
-            }
-            free(image->pixels);
+            pool_release(
+                image->pixels[0],
+                image->capacity * sizeof(RGBPixel)
+            );
+            pool_release(
+                image->pixels,
+                (size_t)image->row_capacity * sizeof(RGBPixel*)
+            );
         }
-        free(image);
+        pool_release(image, sizeof(BMPImage));
     }
 }
 
@@ -386,11 +1467,13 @@ BMPImage* bmp_copy(const BMPImage* src) {
         return NULL;
     }
 
-    // Создаем новое изображение такого же размера
-    BMPImage* dst = bmp_create(
-        src->info_header.width,
-        src->info_header.height
-    );
+    // Создаем новое изображение такого же размера. Знак высоты
+    // (порядок строк) переносится вместе с заголовком
+    int32_t width = src->info_header.width;
+    int32_t height = src->info_header.height;
+    int32_t abs_height = height < 0 ? -height : height;
+
+    BMPImage* dst = bmp_create(width, abs_height);
     if (!dst) {
         return NULL;
     }
@@ -399,15 +1482,14 @@ BMPImage* bmp_copy(const BMPImage* src) {
     dst->file_header = src->file_header;
     dst->info_header = src->info_header;
 
-    // Копируем пиксели
-    int32_t width = src->info_header.width;
-    int32_t height = src->info_header.height;
-    int32_t abs_height = height < 0 ? -height : height;
-
+    // Копируем пиксели. Строки представления лежат не подряд,
+    // поэтому копируются по одной
     for (int32_t y = 0; y < abs_height; y++) {
-        for (int32_t x = 0; x < width; x++) {
-            dst->pixels[y][x] = src->pixels[y][x];
-        }
+        memcpy(
+            dst->pixels[y],
+            src->pixels[y],
+            (size_t)width * sizeof(RGBPixel)
+        );
     }
 
     return dst;
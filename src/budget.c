@@ -0,0 +1,439 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "budget.h"
+#include "defines.h"
+#include "pool.h"
+#include "registry.h"
+#include "roi.h"
+#include "tiles.h"
+
+// Наименьшая сторона тайла, до которой уменьшаются тайлы
+#define BUDGET_MIN_TILE 32
+
+// Полоса короче этого числа строк выбирается только в одном
+// потоке: иначе поля полос пересчитываются дороже самих полос
+#define BUDGET_MIN_BAND_ROWS 16
+
+// Буфер изображения width x height вместе с массивом строк,
+// округленные до блоков пула
+static uint64_t image_bytes(int32_t width, int32_t height) {
+    return pool_block_size(
+               (size_t)width * height * sizeof(RGBPixel)
+           ) +
+           pool_block_size((size_t)height * sizeof(RGBPixel*));
+}
+
+// Оценка памяти выполнения цепочки над буфером width x height:
+// сам буфер, второй буфер для попеременной записи (если есть
+// фильтры не на месте), рабочие буферы тайлов в каждом потоке и
+// память, которую выделяют сами фильтры
+static uint64_t chain_bytes(
+    const Filter* head,
+    int32_t width,
+    int32_t height,
+    int workers,
+    int tile_size
+) {
+    int halo = 0;
+    int computing = 0;
+    int scratch = 0;
+    uint64_t extra = 0;
+
+    for (const Filter* f = head; f; f = f->next) {
+        const FilterDescriptor* descriptor =
+            filter_registry_get(f->type);
+        if (!descriptor) {
+            continue;
+        }
+
+        int radius = filter_radius(f);
+        if (radius > 0) {
+            halo += radius;
+        }
+        if (descriptor->kind != FILTER_KIND_GLOBAL &&
+            !descriptor->resizes) {
+            computing = 1;
+        }
+        if (!descriptor->in_place) {
+            scratch = 1;
+        }
+        if (descriptor->workspace) {
+            uint64_t bytes =
+                descriptor->workspace(f, width, height, workers);
+            if (bytes > extra) {
+                extra = bytes;
+            }
+        }
+    }
+
+    // В нескольких потоках по тайлам со вторым буфером
+    // выполняются и фильтры на месте
+    if (computing && workers > 1) {
+        scratch = 1;
+    }
+
+    uint64_t bytes =
+        (1 + scratch) * image_bytes(width, height) + extra;
+
+    // Буферы тайла вмещают тайл вместе с полями всех стадий. По
+    // тайлам выполняются отрезки с вычисляющими стадиями
+    if (computing && scratch) {
+        int32_t tile_width = tile_size + 2 * halo;
+        int32_t tile_height = tile_size + 2 * halo;
+        if (tile_width > width) {
+            tile_width = width;
+        }
+        if (tile_height > height) {
+            tile_height = height;
+        }
+        bytes += (uint64_t)workers * 2 *
+                 image_bytes(tile_width, tile_height);
+    }
+    return bytes;
+}
+
+// Оценка памяти полосы из rows строк результата. Берётся полоса
+// в середине кадра: у неё поля с обеих сторон
+static uint64_t band_bytes(
+    const Filter* head,
+    int32_t width,
+    int32_t height,
+    int32_t result_width,
+    int32_t result_height,
+    int32_t rows,
+    int workers,
+    int tile_size
+) {
+    BMPRegion area = {
+        0, (result_height - rows) / 2, result_width, rows
+    };
+    BMPRegion region;
+    if (roi_plan_area(
+            head,
+            width,
+            height,
+            &area,
+            &region,
+            NULL,
+            NULL
+        ) != 0) {
+        return UINT64_MAX;
+    }
+
+    return chain_bytes(
+        head,
+        region.width,
+        region.height,
+        workers,
+        tile_size
+    );
+}
+
+// Наибольшая полоса, укладывающаяся в бюджет (0 - никакая)
+static int32_t fit_band(
+    const Filter* head,
+    int32_t width,
+    int32_t height,
+    int32_t result_width,
+    int32_t result_height,
+    uint64_t budget,
+    int workers,
+    int tile_size,
+    uint64_t* estimate
+) {
+    int32_t low = 0, high = result_height;
+    while (low < high) {
+        int32_t rows = low + (high - low + 1) / 2;
+        if (band_bytes(
+                head,
+                width,
+                height,
+                result_width,
+                result_height,
+                rows,
+                workers,
+                tile_size
+            ) <= budget) {
+            low = rows;
+        } else {
+            high = rows - 1;
+        }
+    }
+
+    if (low > 0) {
+        *estimate = band_bytes(
+            head,
+            width,
+            height,
+            result_width,
+            result_height,
+            low,
+            workers,
+            tile_size
+        );
+    }
+    return low;
+}
+
+int budget_plan(
+    const Filter* head,
+    int32_t width,
+    int32_t height,
+    uint64_t budget,
+    int threads,
+    BudgetPlan* plan
+) {
+    plan->mode = BUDGET_WHOLE;
+    plan->threads = threads > 0 ? threads : 1;
+    plan->tile_size = IC_TILE_SIZE;
+    plan->band_rows = 0;
+
+    // Ошибки в цепочке сообщит apply_filters, оценка - для
+    // изображения целиком
+    BMPRegion region = { 0, 0, width, height };
+    int32_t result_width = width, result_height = height;
+    if (roi_plan_area(
+            head,
+            width,
+            height,
+            NULL,
+            &region,
+            &result_width,
+            &result_height
+        ) != 0) {
+        plan->estimate = chain_bytes(
+            head,
+            width,
+            height,
+            plan->threads,
+            plan->tile_size
+        );
+        return plan->estimate > budget;
+    }
+
+    // Целиком: потоки важнее размера тайла
+    for (int workers = plan->threads; workers >= 1; workers--) {
+        for (int tile = IC_TILE_SIZE; tile >= BUDGET_MIN_TILE;
+             tile /= 2) {
+            uint64_t bytes = chain_bytes(
+                head,
+                region.width,
+                region.height,
+                workers,
+                tile
+            );
+            if (bytes <= budget) {
+                plan->threads = workers;
+                plan->tile_size = tile;
+                plan->estimate = bytes;
+                return 0;
+            }
+        }
+    }
+
+    uint64_t smallest = chain_bytes(
+        head,
+        region.width,
+        region.height,
+        1,
+        BUDGET_MIN_TILE
+    );
+
+    // Глобальному фильтру нужен весь кадр, полосы невозможны
+    int global = 0;
+    for (const Filter* f = head; f; f = f->next) {
+        if (filter_radius(f) == FILTER_RADIUS_GLOBAL) {
+            global = 1;
+        }
+    }
+
+    for (int workers = plan->threads; !global && workers >= 1;
+         workers--) {
+        for (int tile = IC_TILE_SIZE; tile >= BUDGET_MIN_TILE;
+             tile /= 2) {
+            uint64_t bytes = 0;
+            int32_t rows = fit_band(
+                head,
+                width,
+                height,
+                result_width,
+                result_height,
+                budget,
+                workers,
+                tile,
+                &bytes
+            );
+
+            int last = workers == 1 && tile / 2 < BUDGET_MIN_TILE;
+            if (rows >= BUDGET_MIN_BAND_ROWS ||
+                rows == result_height || (last && rows > 0)) {
+                plan->mode = BUDGET_BANDS;
+                plan->threads = workers;
+                plan->tile_size = tile;
+                plan->band_rows = rows;
+                plan->estimate = bytes;
+                return 0;
+            }
+        }
+    }
+
+    if (!global) {
+        uint64_t band = band_bytes(
+            head,
+            width,
+            height,
+            result_width,
+            result_height,
+            1,
+            1,
+            BUDGET_MIN_TILE
+        );
+        if (band < smallest) {
+            smallest = band;
+        }
+    }
+    plan->estimate = smallest;
+    return 1;
+}
+
+int budget_run_bands(
+    const char* ifile,
+    const char* path,
+    Filter* filter_list,
+    const BudgetPlan* plan,
+    const Execution* execution
+) {
+    BMPFileHeader file_header;
+    BMPInfoHeader info_header;
+    if (bmp_read_headers(ifile, &file_header, &info_header) !=
+        ALL_OK) {
+        fprintf(
+            stderr,
+            "[Error] Не удалось загрузить изображение '%s'\n",
+            ifile
+        );
+        return 1;
+    }
+
+    int32_t width = info_header.width;
+    int32_t height = abs(info_header.height);
+
+    BMPRegion region;
+    int32_t result_width, result_height;
+    if (roi_plan_area(
+            filter_list,
+            width,
+            height,
+            NULL,
+            &region,
+            &result_width,
+            &result_height
+        ) != 0) {
+        fprintf(
+            stderr,
+            "[Error] Не удалось спланировать цепочку фильтров\n"
+        );
+        return 1;
+    }
+
+    // Заголовки результата - заголовки входа с размерами кадра
+    // результата, как при обработке целиком
+    BMPInfoHeader result_header = info_header;
+    result_header.width = result_width;
+    result_header.height =
+        info_header.height < 0 ? -result_height : result_height;
+
+    BMPWriter* writer =
+        bmp_writer_open(path, &file_header, &result_header);
+    if (!writer) {
+        fprintf(
+            stderr,
+            "[Error] Не удалось создать файл '%s'\n",
+            path
+        );
+        return 1;
+    }
+
+    int error = 0;
+    for (int32_t row = 0; !error && row < result_height;
+         row += plan->band_rows) {
+        BMPRegion area = { 0, row, result_width, plan->band_rows };
+        if (area.height > result_height - row) {
+            area.height = result_height - row;
+        }
+
+        // Полоса загружается с полями, нужными её строкам
+        BMPImage* band = NULL;
+        if (roi_plan_area(
+                filter_list,
+                width,
+                height,
+                &area,
+                &region,
+                NULL,
+                NULL
+            ) == 0) {
+            band = bmp_load_region(ifile, &region);
+        }
+        if (!band) {
+            fprintf(
+                stderr,
+                "[Error] Не удалось загрузить строки %d-%d "
+                "изображения '%s'\n",
+                region.y,
+                region.y + region.height - 1,
+                ifile
+            );
+            error = 1;
+            break;
+        }
+
+        RoiWindow window = { region.x, region.y, width, height };
+        int applied = apply_filters_window(
+            &band,
+            filter_list,
+            &window,
+            execution
+        );
+        if (applied < 0) {
+            fprintf(
+                stderr,
+                "[Error] Ошибка применения фильтров на шаге %d\n",
+                -applied
+            );
+            bmp_free(band);
+            error = 1;
+            break;
+        }
+
+        // Поля полосы посчитаны неточно и отбрасываются
+        BMPRegion source = { area.x - window.x,
+                             area.y - window.y,
+                             area.width,
+                             area.height };
+        error = bmp_writer_rows(writer, band, &source, row) !=
+                ALL_OK;
+        bmp_free(band);
+
+        if (error) {
+            fprintf(
+                stderr,
+                "[Error] Ошибка записи строк %d-%d в '%s'\n",
+                row,
+                row + area.height - 1,
+                path
+            );
+        }
+    }
+
+    if (bmp_writer_close(writer) != ALL_OK && !error) {
+        fprintf(
+            stderr,
+            "[Error] Ошибка сохранения изображения в '%s'\n",
+            path
+        );
+        error = 1;
+    }
+    return error;
+}
@@ -0,0 +1,689 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bmp.h"
+#include "cache.h"
+#include "defines.h"
+#include "hash.h"
+#include "registry.h"
+
+// Вторая половина ключа считается с другим начальным значением
+#define CACHE_SEED_HIGH 0x696D616765637266ULL
+
+void cache_hasher_init(CacheHasher* hasher) {
+    hash64_init(&hasher->low, 0);
+    hash64_init(&hasher->high, CACHE_SEED_HIGH);
+}
+
+void cache_hasher_update(
+    CacheHasher* hasher,
+    const void* data,
+    size_t size
+) {
+    hash64_update(&hasher->low, data, size);
+    hash64_update(&hasher->high, data, size);
+}
+
+// Целые записываются в порядке little-endian
+void cache_hasher_int(CacheHasher* hasher, int32_t value) {
+    uint32_t bits = (uint32_t)value;
+    uint8_t bytes[4] = { (uint8_t)bits,
+                         (uint8_t)(bits >> 8),
+                         (uint8_t)(bits >> 16),
+                         (uint8_t)(bits >> 24) };
+    cache_hasher_update(hasher, bytes, sizeof(bytes));
+}
+
+// Поля заголовков, которые попадают в выходной файл как есть
+void cache_hasher_headers(
+    CacheHasher* hasher,
+    const BMPFileHeader* file_header,
+    const BMPInfoHeader* info_header
+) {
+    cache_hasher_int(hasher, file_header->reserved1);
+    cache_hasher_int(hasher, file_header->reserved2);
+    cache_hasher_int(hasher, (int32_t)file_header->data_offset);
+    cache_hasher_int(hasher, info_header->planes);
+    cache_hasher_int(hasher, info_header->x_pixels_per_meter);
+    cache_hasher_int(hasher, info_header->y_pixels_per_meter);
+    cache_hasher_int(hasher, (int32_t)info_header->colors_used);
+    cache_hasher_int(
+        hasher,
+        (int32_t)info_header->colors_important
+    );
+}
+
+// Каноническая запись фильтра: имя и все параметры, включая
+// дополненные при разборе короткой формы
+void cache_hasher_filter(CacheHasher* hasher, const Filter* filter) {
+    const FilterDescriptor* descriptor =
+        filter_registry_get(filter->type);
+
+    char text[256];
+    int length = descriptor ? snprintf(
+                                  text,
+                                  sizeof(text),
+                                  "%s",
+                                  descriptor->name
+                              )
+                            : snprintf(
+                                  text,
+                                  sizeof(text),
+                                  "#%d",
+                                  filter->type
+                              );
+    for (int p = 0;
+         p < filter->param_count && length < (int)sizeof(text);
+         p++) {
+        length += snprintf(
+            text + length,
+            sizeof(text) - length,
+            " %d",
+            filter->params[p]
+        );
+    }
+    if (length >= (int)sizeof(text)) {
+        length = (int)sizeof(text) - 1;
+    }
+    text[length++] = ';';
+    cache_hasher_update(hasher, text, length);
+}
+
+void cache_hasher_key(const CacheHasher* hasher, CacheKey* key) {
+    snprintf(
+        key->hex,
+        sizeof(key->hex),
+        "%016llx%016llx",
+        (unsigned long long)hash64_digest(&hasher->high),
+        (unsigned long long)hash64_digest(&hasher->low)
+    );
+}
+
+int cache_key(
+    const char* input,
+    const Filter* filter_list,
+    CacheKey* key
+) {
+    BMPFileHeader file_header;
+    BMPInfoHeader info_header;
+    if (bmp_read_headers(input, &file_header, &info_header) !=
+        ALL_OK) {
+        return 1;
+    }
+
+    int32_t width = info_header.width;
+    int32_t height = info_header.height < 0
+                         ? -info_header.height
+                         : info_header.height;
+    size_t row_bytes = (size_t)width * 3;
+    size_t row_size = (row_bytes + 3) & ~(size_t)3;
+
+    FILE* file = fopen(input, "rb");
+    if (!file) {
+        return 1;
+    }
+    uint8_t* row = (uint8_t*)malloc(row_size);
+    if (!row ||
+        fseek(file, file_header.data_offset, SEEK_SET) != 0) {
+        free(row);
+        fclose(file);
+        return 1;
+    }
+
+    CacheHasher hasher;
+    cache_hasher_init(&hasher);
+
+    // Знак высоты задаёт порядок строк, поэтому входит в ключ
+    cache_hasher_int(&hasher, IC_CACHE_VERSION);
+    cache_hasher_int(&hasher, width);
+    cache_hasher_int(&hasher, info_header.height);
+
+    cache_hasher_headers(&hasher, &file_header, &info_header);
+
+    // Из пикселей хешируются только значимые байты строк:
+    // выравнивание в выходной файл не попадает
+    int error = 0;
+    for (int32_t y = 0; y < height; y++) {
+        size_t read = fread(row, 1, row_size, file);
+        if (read < row_bytes) {
+            error = 1;
+            break;
+        }
+        cache_hasher_update(&hasher, row, row_bytes);
+    }
+    free(row);
+    fclose(file);
+    if (error) {
+        return 1;
+    }
+
+    for (; filter_list; filter_list = filter_list->next) {
+        cache_hasher_filter(&hasher, filter_list);
+    }
+    cache_hasher_key(&hasher, key);
+    key->pixels = (int64_t)width * height;
+    return 0;
+}
+
+#ifdef _WIN32
+
+int cache_fetch(
+    const char* directory,
+    const CacheKey* key,
+    const char* output
+) {
+    (void)directory;
+    (void)key;
+    (void)output;
+    return 1;
+}
+
+int cache_store(
+    const char* directory,
+    const CacheKey* key,
+    const char* output,
+    uint64_t max_bytes
+) {
+    (void)directory;
+    (void)key;
+    (void)output;
+    (void)max_bytes;
+    return 1;
+}
+
+int cache_read(
+    const char* directory,
+    const CacheKey* key,
+    uint8_t** data,
+    size_t* size
+) {
+    (void)directory;
+    (void)key;
+    (void)data;
+    (void)size;
+    return 1;
+}
+
+int cache_write(
+    const char* directory,
+    const CacheKey* key,
+    const uint8_t* data,
+    size_t size,
+    uint64_t max_bytes
+) {
+    (void)directory;
+    (void)key;
+    (void)data;
+    (void)size;
+    (void)max_bytes;
+    return 1;
+}
+
+#else
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "paths.h"
+
+#define CACHE_PATH_SIZE 1024
+#define CACHE_COPY_BUFFER (1 << 20)
+
+// Временные файлы старше этого срока остались от прерванных
+// процессов и удаляются при вытеснении, секунд
+#define CACHE_STALE_TEMP 3600
+
+// Запись кэша при вытеснении
+typedef struct {
+    char name[64]; // Подкаталог и имя файла
+    off_t size;
+    time_t used; // Время последнего использования
+} CacheEntry;
+
+// Записи раскладываются по подкаталогам из первых двух символов
+// ключа, чтобы каталоги не разрастались
+static void entry_path(
+    const char* directory,
+    const CacheKey* key,
+    char* path,
+    size_t size
+) {
+    snprintf(
+        path,
+        size,
+        "%s/%.2s/%s.bmp",
+        directory,
+        key->hex,
+        key->hex + 2
+    );
+}
+
+// Запись size байт из data в файл fd
+static int write_all(int fd, const char* data, size_t size) {
+    for (size_t done = 0; done < size;) {
+        ssize_t written = write(fd, data + done, size - done);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return 1;
+        }
+        done += written;
+    }
+    return 0;
+}
+
+// Копирование содержимого файла in в файл out
+static int copy_stream(int in, int out) {
+    char* buffer = (char*)malloc(CACHE_COPY_BUFFER);
+    if (!buffer) {
+        return 1;
+    }
+
+    int error = 0;
+    for (;;) {
+        ssize_t count = read(in, buffer, CACHE_COPY_BUFFER);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            error = count < 0;
+            break;
+        }
+        if (write_all(out, buffer, count) != 0) {
+            error = 1;
+            break;
+        }
+    }
+
+    free(buffer);
+    return error;
+}
+
+int cache_fetch(
+    const char* directory,
+    const CacheKey* key,
+    const char* output
+) {
+    char path[CACHE_PATH_SIZE];
+    entry_path(directory, key, path, sizeof(path));
+
+    // Открытый файл остаётся читаемым, даже если другой процесс
+    // вытеснит запись во время копирования
+    int in = open(path, O_RDONLY);
+    if (in < 0) {
+        return 1;
+    }
+
+    // Отметка использования для вытеснения
+    utimensat(AT_FDCWD, path, NULL, 0);
+
+    int out = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0) {
+        close(in);
+        return 1;
+    }
+
+    int error = copy_stream(in, out);
+    close(in);
+    if (close(out) != 0) {
+        error = 1;
+    }
+    return error;
+}
+
+int cache_read(
+    const char* directory,
+    const CacheKey* key,
+    uint8_t** data,
+    size_t* size
+) {
+    char path[CACHE_PATH_SIZE];
+    entry_path(directory, key, path, sizeof(path));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 1;
+    }
+    utimensat(AT_FDCWD, path, NULL, 0);
+
+    struct stat info;
+    uint8_t* buffer = NULL;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        buffer = (uint8_t*)malloc(info.st_size);
+    }
+
+    size_t done = 0;
+    while (buffer && done < (size_t)info.st_size) {
+        ssize_t count =
+            read(fd, buffer + done, (size_t)info.st_size - done);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            break;
+        }
+        done += count;
+    }
+    close(fd);
+
+    if (!buffer || done != (size_t)info.st_size) {
+        free(buffer);
+        return 1;
+    }
+    *data = buffer;
+    *size = done;
+    return 0;
+}
+
+static int compare_entries(const void* a, const void* b) {
+    const CacheEntry* left = (const CacheEntry*)a;
+    const CacheEntry* right = (const CacheEntry*)b;
+    if (left->used != right->used) {
+        return left->used < right->used ? -1 : 1;
+    }
+    return strcmp(left->name, right->name);
+}
+
+static int is_hex(const char* text, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        char c = text[i];
+        if (!((c >= '0' && c <= '9') ||
+              (c >= 'a' && c <= 'f'))) {
+            return 0;
+        }
+    }
+    return text[length] == '\0';
+}
+
+// Добавление записей подкаталога sub в список
+static int collect_entries(
+    const char* directory,
+    const char* sub,
+    CacheEntry** entries,
+    size_t* count,
+    size_t* capacity
+) {
+    char path[CACHE_PATH_SIZE];
+    snprintf(path, sizeof(path), "%s/%s", directory, sub);
+
+    DIR* dir = opendir(path);
+    if (!dir) {
+        return 0;
+    }
+
+    struct dirent* item;
+    while ((item = readdir(dir)) != NULL) {
+        if (strlen(item->d_name) != 34 ||
+            strcmp(item->d_name + 30, ".bmp") != 0) {
+            continue;
+        }
+
+        char file[CACHE_PATH_SIZE];
+        struct stat info;
+        int length = snprintf(
+            file,
+            sizeof(file),
+            "%s/%s",
+            path,
+            item->d_name
+        );
+        if (length >= (int)sizeof(file) ||
+            stat(file, &info) != 0) {
+            continue; // Запись уже вытеснена другим процессом
+        }
+
+        if (*count == *capacity) {
+            size_t grown_capacity =
+                *capacity ? *capacity * 2 : 64;
+            CacheEntry* grown = (CacheEntry*)realloc(
+                *entries,
+                grown_capacity * sizeof(CacheEntry)
+            );
+            if (!grown) {
+                closedir(dir);
+                return 1;
+            }
+            *entries = grown;
+            *capacity = grown_capacity;
+        }
+
+        // Длины имён проверены выше
+        CacheEntry* entry = &(*entries)[(*count)++];
+        snprintf(
+            entry->name,
+            sizeof(entry->name),
+            "%.2s/%.34s",
+            sub,
+            item->d_name
+        );
+        entry->size = info.st_size;
+        entry->used = info.st_mtime;
+    }
+
+    closedir(dir);
+    return 0;
+}
+
+// Удаление временных файлов, брошенных прерванными процессами
+static void remove_stale_temp(const char* directory) {
+    char path[CACHE_PATH_SIZE];
+    snprintf(path, sizeof(path), "%s/tmp", directory);
+
+    DIR* dir = opendir(path);
+    if (!dir) {
+        return;
+    }
+
+    time_t now = time(NULL);
+    struct dirent* item;
+    while ((item = readdir(dir)) != NULL) {
+        if (item->d_name[0] == '.') {
+            continue;
+        }
+
+        char file[CACHE_PATH_SIZE];
+        struct stat info;
+        int length = snprintf(
+            file,
+            sizeof(file),
+            "%s/%s",
+            path,
+            item->d_name
+        );
+        if (length < (int)sizeof(file) &&
+            stat(file, &info) == 0 &&
+            now - info.st_mtime > CACHE_STALE_TEMP) {
+            unlink(file);
+        }
+    }
+    closedir(dir);
+}
+
+// Вытеснение давно не использованных записей, пока кэш не
+// уложится в max_bytes. Вытесняет один процесс за раз; если
+// блокировка занята, работа остаётся ему
+static void evict(const char* directory, uint64_t max_bytes) {
+    char path[CACHE_PATH_SIZE];
+    snprintf(path, sizeof(path), "%s/lock", directory);
+
+    int lock = open(path, O_RDWR | O_CREAT, 0644);
+    if (lock < 0) {
+        return;
+    }
+
+    struct flock region;
+    memset(&region, 0, sizeof(region));
+    region.l_type = F_WRLCK;
+    region.l_whence = SEEK_SET;
+    if (fcntl(lock, F_SETLK, &region) != 0) {
+        close(lock);
+        return;
+    }
+
+    remove_stale_temp(directory);
+
+    CacheEntry* entries = NULL;
+    size_t count = 0, capacity = 0;
+    DIR* dir = opendir(directory);
+    if (dir) {
+        struct dirent* item;
+        while ((item = readdir(dir)) != NULL) {
+            if (strlen(item->d_name) == 2 &&
+                is_hex(item->d_name, 2) &&
+                collect_entries(
+                    directory,
+                    item->d_name,
+                    &entries,
+                    &count,
+                    &capacity
+                ) != 0) {
+                break;
+            }
+        }
+        closedir(dir);
+    }
+
+    uint64_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += (uint64_t)entries[i].size;
+    }
+
+    if (total > max_bytes) {
+        qsort(
+            entries,
+            count,
+            sizeof(CacheEntry),
+            compare_entries
+        );
+        for (size_t i = 0; i < count && total > max_bytes; i++) {
+            snprintf(
+                path,
+                sizeof(path),
+                "%s/%s",
+                directory,
+                entries[i].name
+            );
+            if (unlink(path) == 0 || errno == ENOENT) {
+                total -= (uint64_t)entries[i].size;
+            }
+        }
+    }
+
+    free(entries);
+    close(lock); // Снимает блокировку
+}
+
+// Создание временного файла для записи key. Возвращает
+// дескриптор или -1, путь файла записывается в temp
+static int open_temp(
+    const char* directory,
+    const CacheKey* key,
+    char* temp,
+    size_t size
+) {
+    char sub[CACHE_PATH_SIZE];
+    snprintf(sub, sizeof(sub), "%s/%.2s", directory, key->hex);
+    snprintf(temp, size, "%s/tmp", directory);
+    if (create_output_directory_recursive(sub) != 0 ||
+        create_output_directory_recursive(temp) != 0) {
+        return -1;
+    }
+
+    static unsigned sequence;
+    snprintf(
+        temp,
+        size,
+        "%s/tmp/%s.%ld.%u",
+        directory,
+        key->hex,
+        (long)getpid(),
+        __atomic_fetch_add(&sequence, 1, __ATOMIC_RELAXED)
+    );
+    return open(temp, O_WRONLY | O_CREAT | O_EXCL, 0644);
+}
+
+// Запись собирается во временном файле и появляется под своим
+// именем целиком: читатели не видят её недописанной
+static int publish(
+    const char* directory,
+    const CacheKey* key,
+    const char* temp,
+    int error,
+    uint64_t max_bytes
+) {
+    char path[CACHE_PATH_SIZE];
+    entry_path(directory, key, path, sizeof(path));
+    if (error || rename(temp, path) != 0) {
+        unlink(temp);
+        return 1;
+    }
+
+    evict(directory, max_bytes);
+    return 0;
+}
+
+int cache_store(
+    const char* directory,
+    const CacheKey* key,
+    const char* output,
+    uint64_t max_bytes
+) {
+    struct stat info;
+    if (stat(output, &info) != 0 ||
+        (uint64_t)info.st_size > max_bytes) {
+        return 1;
+    }
+
+    int in = open(output, O_RDONLY);
+    if (in < 0) {
+        return 1;
+    }
+
+    char temp[CACHE_PATH_SIZE];
+    int out = open_temp(directory, key, temp, sizeof(temp));
+    if (out < 0) {
+        close(in);
+        return 1;
+    }
+
+    int error = copy_stream(in, out);
+    close(in);
+    if (close(out) != 0) {
+        error = 1;
+    }
+    return publish(directory, key, temp, error, max_bytes);
+}
+
+int cache_write(
+    const char* directory,
+    const CacheKey* key,
+    const uint8_t* data,
+    size_t size,
+    uint64_t max_bytes
+) {
+    if ((uint64_t)size > max_bytes) {
+        return 1;
+    }
+
+    char temp[CACHE_PATH_SIZE];
+    int out = open_temp(directory, key, temp, sizeof(temp));
+    if (out < 0) {
+        return 1;
+    }
+
+    int error = write_all(out, (const char*)data, size);
+    if (close(out) != 0) {
+        error = 1;
+    }
+    return publish(directory, key, temp, error, max_bytes);
+}
+
+#endif // _WIN32
@@ -3,44 +3,32 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "arena.h"
 #include "bmp.h"
 #include "convolution.h"
 #include "defines.h"
 
 Kernel* kernel_create(uint8_t size, float** matrix) {
-    Kernel* w = (Kernel*)malloc(sizeof(Kernel));
-    if (!w) {
+    // Ядро, указатели на строки и значения - один блок
+    // временной памяти
+    size_t rows_offset = sizeof(Kernel);
+    size_t values_offset = rows_offset + size * sizeof(float*);
+    uint8_t* block = (uint8_t*)scratch_alloc(
+        values_offset + (size_t)size * size * sizeof(float)
+    );
+    if (!block) {
         fprintf(stderr, "Ошибка инициализации ядра\n");
         return NULL;
     }
 
-    w->matrix = (float**)malloc(size * sizeof(float*));
-    if (!w->matrix) {
-        fprintf(stderr, "Ошибка инициализации матрицы ядра\n");
-        free(w);
-        return NULL;
-    }
-
+    Kernel* w = (Kernel*)block;
+    w->matrix = (float**)(block + rows_offset);
     w->size = size;
     w->normalizer = 0;
 
-    // Инициализация матрицы
+    float* values = (float*)(block + values_offset);
     for (uint8_t i = 0; i < size; i++) {
-        w->matrix[i] = (float*)malloc(size * sizeof(float));
-        if (!(w->matrix[i])) {
-            fprintf(
-                stderr,
-                "Ошибка инициализации вектора %u\n",
-                i
-            );
-            // Освобождаем уже выделенную память
-            for (uint8_t j = 0; j < i; j++) {
-                free(w->matrix[j]);
-            }
-            free(w->matrix);
-            free(w);
-            return NULL;
-        }
+        w->matrix[i] = values + (size_t)i * size;
     }
 
     // Копирование значений матрицы
@@ -57,13 +45,7 @@ Kernel* kernel_create(uint8_t size, float** matrix) {
 }
 
 void kernel_free(Kernel* w) {
-    if (!w)
-        return;
-
-    for (uint8_t i = 0; i < w->size; i++)
-        free(w->matrix[i]);
-
-    free(w);
+    scratch_free(w);
 }
 
 int kernel_fill(Kernel* w, float** matrix, uint8_t size) {
@@ -87,7 +69,7 @@ void kernel_print(Kernel* w) {
 }
 
 void convolute_pixel(
-    BMPImage* iimage,
+    const BMPImage* iimage,
     BMPImage* oimage,
     Kernel* w,
     int32_t i,
@@ -195,28 +177,29 @@ void convolute_pixel(
     );
 }
 
-BMPImage* convolute(BMPImage* iimage, Kernel* w) {
+int convolute(const BMPImage* iimage, BMPImage* oimage, Kernel* w) {
     // Проверка аргументов
-    if (!w || !iimage || !iimage->pixels) {
+    if (!w || !iimage || !iimage->pixels || !oimage) {
         fprintf(stderr, "[Ошибка] Некорректные аргументы\n");
-        return NULL;
-    }
-
-    // Копирование изображения
-    BMPImage* oimage = bmp_copy(iimage);
-    if (!oimage) {
-        fprintf(stderr, "Ошибка копирования изображения\n");
-        return NULL;
+        return IC_ERROR_KERNEL_FAILURE;
     }
 
     int32_t width = iimage->info_header.width;
     int32_t height = iimage->info_header.height;
     int32_t abs_height = height < 0 ? -height : height;
 
+    // Приёмник получает заголовки и размеры источника
+    oimage->file_header = iimage->file_header;
+    oimage->info_header = iimage->info_header;
+    if (bmp_reshape(oimage, width, height) != ALL_OK) {
+        fprintf(stderr, "Ошибка подготовки приёмника свёртки\n");
+        return IC_ERROR_KERNEL_FAILURE;
+    }
+
     for (int32_t i = 0; i < abs_height; i++) {
         for (int32_t j = 0; j < width; j++)
             convolute_pixel(iimage, oimage, w, i, j);
     }
 
-    return oimage;
+    return ALL_OK;
 }
@@ -5,118 +5,238 @@
 #include <sys/types.h>
 
 #include "args_assistant.h"
+#include "batch.h"
 #include "bmp.h"
+#include "budget.h"
+#include "cache.h"
+#include "counters.h"
 #include "core.h"
+#include "dag.h"
+#include "daemon.h"
 #include "defines.h"
+#include "execution.h"
 #include "filters.h"
 #include "paths.h"
+#include "pool.h"
+#include "profile.h"
+#include "roi.h"
+#include "trace.h"
 
-int imagecraft(int argc, char** argv) {
-    char *ifile = NULL, *ofile = NULL;
-    Filter* filter_list = NULL;
-    int parse_result =
-        parse_args(argc, argv, &ifile, &ofile, &filter_list);
+// Замеры стадий, кэш результатов и бюджет памяти работают
+// только при обработке одного изображения, кэш стадий - ещё и в
+// режиме сервера. Возвращает 1, если запрошено недоступное
+static int reject_single_options(
+    const Options* options,
+    int allow_stage_cache
+) {
+    const char* option = NULL;
+    if (options->profile) {
+        option = IC_ARGV_PROFILE;
+    } else if (options->cache) {
+        option = IC_ARGV_CACHE;
+    } else if (options->stage_cache && !allow_stage_cache) {
+        option = IC_ARGV_STAGE_CACHE;
+    } else if (options->max_memory) {
+        option = IC_ARGV_MAX_MEMORY;
+    } else {
+        return 0;
+    }
 
-    switch (parse_result) {
-        case IC_ARGS_ASSISTANT_ERROR: {
-            fprintf(
-                stderr,
-                "[Error] Ошибка обработка аргументов. Adiós!\n"
-            );
-            exit(1);
-        }
-        case IC_ARGS_ASSISTANT_HELP: {
-            printhelp();
-            exit(0);
-        }
-        case IC_ARGS_ASSISTANT_VERSION: {
-            printversion();
-            exit(0);
-        }
-        case IC_ARGS_ASSISTANT_INFO: {
-            printinfo(ifile);
-            exit(0);
-        }
+    fprintf(
+        stderr,
+        "[Error] %s недоступен в этом режиме\n",
+        option
+    );
+    return 1;
+}
+
+// Пул рабочих потоков, при -numa привязанных к узлам NUMA.
+// Возвращает NULL, если потоки не удалось запустить
+static Scheduler*
+create_scheduler(int threads, const Options* options) {
+    Scheduler* scheduler = scheduler_create(threads);
+    if (!scheduler || !options->numa) {
+        return scheduler;
     }
 
-    if (argc < 3) {
-        printhelp();
-        exit(0);
+    int nodes = scheduler_bind_numa(scheduler);
+    if (nodes > 0) {
+        printf(
+            "[Info] Рабочие потоки привязаны к узлам NUMA: %d\n",
+            nodes
+        );
+    } else {
+        printf("[Info] Привязка к узлам NUMA недоступна\n");
     }
+    return scheduler;
+}
 
-    int error;
-    if (((error = bmp_is_valid_24bit(ifile)) & 1) == 1) {
-        if (error == IC_ERROR_OPENING_FILE)
-            fprintf(
-                stderr,
-                "[Error] Не получилось прочитать файл '%s'\n",
-                ifile
-            );
-        else // иначе проблема в структуре BMP
-        {
-            char* error_code;
-            fprintf(
-                stderr,
-                "[Error] Файл %s не соответствует формату BMP "
-                "(код ошибки ",
-                ifile
-            );
+// Предельный размер кэша в байтах: заданный или по умолчанию
+static uint64_t
+cache_bytes(const Options* options, int default_mb) {
+    int mb =
+        options->cache_size ? options->cache_size : default_mb;
+    return (uint64_t)mb << 20;
+}
 
-            // Определение кода ошибки
-            if (error == IC_BMP_ERROR_NULL_FILENAME)
-                error_code = IC_MESSAGE_BMP_ERROR_NULL_FILENAME;
-            else if (error == IC_BMP_ERROR_INVALID_SIGNATURE)
-                error_code =
-                    IC_MESSAGE_BMP_ERROR_INVALID_SIGNATURE;
-            else if (error == IC_BMP_ERROR_INVALID_BPP)
-                error_code = IC_MESSAGE_BMP_ERROR_INVALID_BPP;
-            else // if (error == IC_BMP_ERROR_INVALID_DIB)
-                error_code = IC_MESSAGE_BMP_ERROR_INVALID_DIB;
+// Пакетный режим: все изображения источника обрабатываются в
+// одном процессе общим пулом потоков
+static int run_batch(
+    const char* source,
+    const char* output,
+    Filter* filter_list,
+    const Options* options
+) {
+    if (reject_single_options(options, 0)) {
+        free_filter_list(filter_list);
+        return 1;
+    }
 
-            fprintf(stderr, "%s)\n", error_code);
-        }
-        return error;
+    Execution execution = { NULL, 1, NULL, NULL, 0 };
+    if (options->threads != 1) {
+        execution.scheduler =
+            create_scheduler(options->threads, options);
     }
 
-    // Загрузка изображения
-    BMPImage* image = bmp_load(ifile);
-    if (!image) {
+    int failed = batch_run(
+        source,
+        output,
+        filter_list,
+        &execution,
+        options->jobs,
+        options->io_uring
+    );
+
+    scheduler_destroy(execution.scheduler);
+    free_filter_list(filter_list);
+
+    if (failed > 0) {
         fprintf(
             stderr,
-            "[Error] Не удалось загрузить изображение '%s'\n",
-            ifile
+            "[Error] Не удалось обработать файлов: %d\n",
+            failed
         );
+    }
+    return failed != 0;
+}
+
+// Режим сервера: рабочие потоки создаются один раз и
+// обслуживают все запросы
+static int run_daemon(
+    const char* socket_path,
+    Filter* filter_list,
+    const Options* options
+) {
+    if (reject_single_options(options, 1)) {
+        free_filter_list(filter_list);
         return 1;
     }
 
-    // bmp_print_info(image);
+    if (filter_list) {
+        fprintf(
+            stderr,
+            "[Error] В режиме сервера фильтры передаются в "
+            "запросах\n"
+        );
+        free_filter_list(filter_list);
+        return 1;
+    }
 
-    int filters_applied = apply_filters(&image, filter_list);
+    Execution execution = { NULL, 1, NULL, NULL, 0 };
+    if (options->threads != 1) {
+        execution.scheduler =
+            create_scheduler(options->threads, options);
+    }
 
-    // Результат применения фильтров
-    if (filters_applied < 0) {
-        // Ошибка применения фильтров
+    // Промежуточные стадии общие для всех соединений и хранятся
+    // в памяти
+    if (options->stage_cache) {
+        execution.stages = stage_cache_create(
+            cache_bytes(options, IC_STAGE_CACHE_DEFAULT_SIZE),
+            NULL,
+            0
+        );
+    }
+
+    int result = daemon_run(socket_path, &execution);
+
+    stage_cache_destroy(execution.stages);
+    scheduler_destroy(execution.scheduler);
+    return result;
+}
+
+// Несколько выходов из одного входа: цепочки объединяются по
+// общим префиксам, и каждый префикс выполняется один раз
+static int run_multi(const char* ifile, Options* options) {
+    if (reject_single_options(options, 0)) {
+        return 1;
+    }
+
+    Dag* dag = dag_create();
+    int error = !dag;
+    for (int i = 0; !error && i < options->output_count; i++) {
+        error = dag_add(
+            dag,
+            options->outputs[i].path,
+            options->outputs[i].chain
+        );
+    }
+    if (error) {
         fprintf(
             stderr,
-            "[Error] Ошибка применения фильтров на шаге %d\n",
-            -filters_applied
+            "[Error] Не удалось построить граф стадий\n"
         );
+        dag_free(dag);
+        return 1;
+    }
 
-        // Очистка памяти
-        bmp_free(image);
-        free_filter_list(filter_list);
-
+    RoiWindow window;
+    BMPRegion region;
+    BMPImage* image = dag_load(dag, ifile, &window, &region);
+    if (!image) {
+        fprintf(
+            stderr,
+            "[Error] Не удалось загрузить изображение '%s'\n",
+            ifile
+        );
+        dag_free(dag);
         return 1;
-    } else if (filters_applied > 0) {
-        printf(
-            "[Info] Успешно применено фильтров: %d\n",
-            filters_applied
+    }
+
+    int stages, requested;
+    dag_stats(dag, &stages, &requested);
+    printf(
+        "[Info] Выходов: %d, стадий: %d (без объединения: %d)\n",
+        options->output_count,
+        stages,
+        requested
+    );
+
+    Execution execution = { NULL, 1, NULL, NULL, 0 };
+    if (options->threads != 1) {
+        execution.scheduler =
+            create_scheduler(options->threads, options);
+    }
+
+    int failed = dag_run(dag, image, &window, &execution);
+
+    scheduler_destroy(execution.scheduler);
+    dag_free(dag);
+
+    if (failed > 0) {
+        fprintf(
+            stderr,
+            "[Error] Не удалось получить выходов: %d\n",
+            failed
         );
-    } else {
-        printf("[Info] Фильтры не применялись\n");
     }
+    return failed != 0;
+}
 
-    // Сохранение результата
+// Путь выходного файла с созданными каталогами. Возвращает
+// копию пути или NULL при ошибке
+static char* prepare_output(const char* ofile) {
+    char* path;
     if (!ofile) {
         // Если выходной файл не указан, используем OUTFILE
         char default_path[1024];
@@ -128,84 +248,601 @@ int imagecraft(int argc, char** argv) {
             SLASH,
             OUTFILE
         );
-        ofile = ic_strdup(default_path); // Делаем копию строки
+        path = ic_strdup(default_path); // Делаем копию строки
         printf(
             "\n[Success] Выходной файл не указан, сохраняю в "
             "'%s'\n",
-            ofile
+            path
         );
     } else {
         // Пользователь указал путь, делаем копию для
         // безопасности
-        ofile = ic_strdup(ofile);
+        path = ic_strdup(ofile);
+    }
+    if (!path) {
+        return NULL;
     }
 
     // Извлекаем директорию из пути и создаем её
-    char* output_dir = get_directory_from_path(ofile);
+    char directory_buffer[1024];
+    char* output_dir = get_directory_from_path(
+        path,
+        directory_buffer,
+        sizeof(directory_buffer)
+    );
 
     // Если в пути есть директория — создаём её рекурсивно
-    if (output_dir != NULL && strcmp(output_dir, ofile) != 0) {
+    if (output_dir != NULL && strcmp(output_dir, path) != 0) {
         if (create_output_directory_recursive(output_dir) != 0) {
             fprintf(
                 stderr,
                 "[Error] Не удалось создать директорию '%s'\n",
                 output_dir
             );
+            free(path);
+            return NULL;
+        }
+    }
+    return path;
+}
 
-            // Очистка памяти
-            bmp_free(image);
-            free_filter_list(filter_list);
-            free(ofile);
+// Планирование по бюджету -max-memory. Из бюджета вычитается
+// память, которую процесс уже занял. В pixels записывается
+// размер входа. Возвращает 0, если бюджета хватает
+static int plan_memory(
+    const char* ifile,
+    const Filter* filter_list,
+    const Options* options,
+    BudgetPlan* plan,
+    int64_t* pixels
+) {
+    BMPFileHeader file_header;
+    BMPInfoHeader info_header;
+    if (bmp_read_headers(ifile, &file_header, &info_header) !=
+        ALL_OK) {
+        fprintf(
+            stderr,
+            "[Error] Не удалось загрузить изображение '%s'\n",
+            ifile
+        );
+        return 1;
+    }
 
-            return 1;
-        }
+    int32_t width = info_header.width;
+    int32_t height = abs(info_header.height);
+    *pixels = (int64_t)width * height;
+
+    uint64_t budget = (uint64_t)options->max_memory << 20;
+    int64_t used_kb = profile_peak_rss_kb();
+    uint64_t used = used_kb > 0 ? (uint64_t)used_kb << 10 : 0;
+    int threads = options->threads
+        ? options->threads
+        : scheduler_online_workers();
+
+    if (used >= budget ||
+        budget_plan(
+            filter_list,
+            width,
+            height,
+            budget - used,
+            threads,
+            plan
+        ) != 0) {
+        fprintf(
+            stderr,
+            "[Error] Бюджета памяти %d МБ не хватает: нужно не "
+            "меньше %.1f МБ\n",
+            options->max_memory,
+            (used + (used < budget ? plan->estimate : 0)) /
+                1048576.0
+        );
+        return 1;
     }
-    /*
-    // Проверяем, не является ли путь просто именем файла (без
-    // директории)
-    if (strcmp(output_dir, ofile) != 0) {
-        // Если есть поддиректории, создаем их
-        if (create_output_directory_recursive(output_dir) != 0) {
+
+    if (plan->mode == BUDGET_BANDS) {
+        printf(
+            "[Info] Бюджет памяти %d МБ: полосы по %d строк, "
+            "потоков %d, тайл %d, оценка %.1f МБ\n",
+            options->max_memory,
+            plan->band_rows,
+            plan->threads,
+            plan->tile_size,
+            (used + plan->estimate) / 1048576.0
+        );
+    } else {
+        printf(
+            "[Info] Бюджет памяти %d МБ: изображение целиком, "
+            "потоков %d, тайл %d, оценка %.1f МБ\n",
+            options->max_memory,
+            plan->threads,
+            plan->tile_size,
+            (used + plan->estimate) / 1048576.0
+        );
+    }
+    return 0;
+}
+
+// Обработка полосами: изображение целиком не помещается в
+// бюджет памяти. Возвращает ALL_OK при успехе
+static int process_bands(
+    const char* ifile,
+    const char* path,
+    Filter* filter_list,
+    const Options* options,
+    const BudgetPlan* plan,
+    int64_t pixels,
+    Profile* profile
+) {
+    Execution execution = { NULL, 1, NULL, NULL, plan->tile_size };
+    if (plan->threads != 1) {
+        execution.scheduler =
+            create_scheduler(plan->threads, options);
+    }
+
+    int error = budget_run_bands(
+        ifile,
+        path,
+        filter_list,
+        plan,
+        &execution
+    );
+    scheduler_destroy(execution.scheduler);
+
+    if (error) {
+        return 1;
+    }
+
+    if (options->profile) {
+        profile_end(profile, "bands", pixels);
+    }
+
+    int count = 0;
+    for (const Filter* f = filter_list; f; f = f->next) {
+        count++;
+    }
+    if (count > 0) {
+        printf("[Info] Успешно применено фильтров: %d\n", count);
+    } else {
+        printf("[Info] Фильтры не применялись\n");
+    }
+    printf("[Success] Изображение успешно сохранено!\n");
+    return ALL_OK;
+}
+
+// Загрузка, применение фильтров и сохранение в path.
+// Возвращает ALL_OK при успехе
+static int process_image(
+    const char* ifile,
+    const char* path,
+    Filter* filter_list,
+    const Options* options,
+    Profile* profile
+) {
+    // Без фильтров результат совпадает с исходным файлом, если
+    // его заголовки канонические: файл копируется ядром без
+    // декодирования
+    if (!filter_list) {
+        int copied = bmp_copy_file(ifile, path);
+        if (copied == ALL_OK) {
+            if (options->profile) {
+                profile_end(profile, "copy", 0);
+            }
+            printf(
+                "[Info] Фильтры не применялись, файл скопирован "
+                "без декодирования\n"
+            );
+            printf("[Success] Изображение успешно сохранено!\n");
+            return ALL_OK;
+        }
+        if (copied != IC_BMP_ERROR_NOT_CANONICAL) {
             fprintf(
                 stderr,
-                "[Error] Не удалось создать директорию '%s'\n",
-                output_dir
+                "[Error] Ошибка копирования изображения (код: "
+                "%d)\n",
+                copied
             );
+            return 1;
+        }
+    }
 
-            // Очистка памяти
-            bmp_free(image);
-            free_filter_list(filter_list);
-            free(ofile);
+    // С бюджетом памяти способ выполнения, тайлы и потоки
+    // выбираются по оценке пиковой памяти буферов
+    BudgetPlan plan = { BUDGET_WHOLE, options->threads, 0, 0, 0 };
+    if (options->max_memory) {
+        // Оценка учитывает только занятые буферы: освобожденные
+        // блоки сразу возвращаются системе
+        pool_set_limit(0);
 
+        int64_t pixels;
+        if (plan_memory(
+                ifile,
+                filter_list,
+                options,
+                &plan,
+                &pixels
+            ) != 0) {
             return 1;
         }
+        if (plan.mode == BUDGET_BANDS) {
+            return process_bands(
+                ifile,
+                path,
+                filter_list,
+                options,
+                &plan,
+                pixels,
+                profile
+            );
+        }
     }
-    */
 
-    int save_result = bmp_save(image, ofile);
+    // Рабочие потоки для тайлов, а с -parallel-io - и для чтения
+    // и записи строк. Если их не удалось запустить, всё
+    // выполняется в одном потоке
+    Execution execution = { NULL,
+                            0,
+                            options->profile ? profile : NULL,
+                            NULL,
+                            plan.tile_size };
+    if (plan.threads != 1) {
+        execution.scheduler =
+            create_scheduler(plan.threads, options);
+    }
+    Scheduler* io = options->parallel_io ? execution.scheduler
+                                         : NULL;
 
-    // Освобождаем память для ofile
-    free(ofile);
+    // Планирование области интереса: если цепочка содержит
+    // обрезку, декодируется только нужная ей часть изображения
+    BMPRegion region;
+    RoiWindow window = { 0, 0, 0, 0 };
+    BMPImage* image =
+        roi_load(ifile, filter_list, &window, &region, io);
 
-    if (save_result == ALL_OK) {
-        printf("[Success] Изображение успешно сохранено!\n");
+    if (image && options->profile) {
+        profile_end(
+            profile,
+            "load",
+            (int64_t)region.width * region.height
+        );
+    }
+
+    if (image && (region.width != window.frame_width ||
+                  region.height != window.frame_height)) {
+        printf(
+            "[Info] Декодируется область %dx%d со смещением "
+            "(%d, %d) из %dx%d\n",
+            region.width,
+            region.height,
+            region.x,
+            region.y,
+            window.frame_width,
+            window.frame_height
+        );
+    }
+
+    if (!image) {
+        fprintf(
+            stderr,
+            "[Error] Не удалось загрузить изображение '%s'\n",
+            ifile
+        );
+        scheduler_destroy(execution.scheduler);
+        return 1;
+    }
+
+    // bmp_print_info(image);
+
+    // Процесс обрабатывает одно изображение, поэтому стадии
+    // хранятся только на диске рядом с готовыми результатами
+    if (options->stage_cache) {
+        execution.stages = stage_cache_create(
+            0,
+            options->cache,
+            cache_bytes(options, IC_CACHE_DEFAULT_SIZE)
+        );
+    }
+
+    int filters_applied = apply_filters_window(
+        &image,
+        filter_list,
+        &window,
+        &execution
+    );
+    stage_cache_destroy(execution.stages);
+
+    // Результат применения фильтров
+    if (filters_applied < 0) {
+        // Ошибка применения фильтров
+        fprintf(
+            stderr,
+            "[Error] Ошибка применения фильтров на шаге %d\n",
+            -filters_applied
+        );
+        bmp_free(image);
+        scheduler_destroy(execution.scheduler);
+        return 1;
+    } else if (filters_applied > 0) {
+        printf(
+            "[Info] Успешно применено фильтров: %d\n",
+            filters_applied
+        );
     } else {
+        printf("[Info] Фильтры не применялись\n");
+    }
+
+    if (options->profile) {
+        profile_begin(profile);
+    }
+
+    int save_result = bmp_save_parallel(image, path, io);
+    scheduler_destroy(execution.scheduler);
+
+    if (save_result == ALL_OK && options->profile) {
+        profile_end(
+            profile,
+            "save",
+            (int64_t)image->info_header.width *
+                abs(image->info_header.height)
+        );
+    }
+    bmp_free(image);
+
+    if (save_result != ALL_OK) {
         fprintf(
             stderr,
             "[Error] Ошибка сохранения изображения (код: %d)\n",
             save_result
         );
+        return 1;
+    }
 
-        // Очистка памяти
-        bmp_free(image);
+    printf("[Success] Изображение успешно сохранено!\n");
+    return ALL_OK;
+}
+
+// Обработка одного изображения
+static int run_single(
+    char* ifile,
+    char* ofile,
+    Filter* filter_list,
+    const Options* options
+) {
+    int error;
+    if (((error = bmp_is_valid_24bit(ifile)) & 1) == 1) {
+        if (error == IC_ERROR_OPENING_FILE)
+            fprintf(
+                stderr,
+                "[Error] Не получилось прочитать файл '%s'\n",
+                ifile
+            );
+        else // иначе проблема в структуре BMP
+        {
+            char* error_code;
+            fprintf(
+                stderr,
+                "[Error] Файл %s не соответствует формату BMP "
+                "(код ошибки ",
+                ifile
+            );
+
+            // Определение кода ошибки
+            if (error == IC_BMP_ERROR_NULL_FILENAME)
+                error_code = IC_MESSAGE_BMP_ERROR_NULL_FILENAME;
+            else if (error == IC_BMP_ERROR_INVALID_SIGNATURE)
+                error_code =
+                    IC_MESSAGE_BMP_ERROR_INVALID_SIGNATURE;
+            else if (error == IC_BMP_ERROR_INVALID_BPP)
+                error_code = IC_MESSAGE_BMP_ERROR_INVALID_BPP;
+            else // if (error == IC_BMP_ERROR_INVALID_DIB)
+                error_code = IC_MESSAGE_BMP_ERROR_INVALID_DIB;
+
+            fprintf(stderr, "%s)\n", error_code);
+        }
         free_filter_list(filter_list);
+        return error;
+    }
 
+    // Оценка бюджета не учитывает копии стадий для кэша
+    if (options->stage_cache && options->max_memory) {
+        fprintf(
+            stderr,
+            "[Error] " IC_ARGV_STAGE_CACHE
+            " несовместим с " IC_ARGV_MAX_MEMORY "\n"
+        );
+        free_filter_list(filter_list);
+        return 1;
+    }
+
+    if (options->stage_cache && !options->cache) {
+        fprintf(
+            stderr,
+            "[Error] " IC_ARGV_STAGE_CACHE
+            " для одного изображения требует " IC_ARGV_CACHE "\n"
+        );
+        free_filter_list(filter_list);
         return 1;
     }
 
+    char* path = prepare_output(ofile);
+    if (!path) {
+        free_filter_list(filter_list);
+        return 1;
+    }
+
+    // Замеры загрузки, каждой стадии и сохранения
+    Profile profile;
+    profile_init(&profile);
+
+    // Счётчики открываются до запуска рабочих потоков, чтобы те
+    // открыли свои при старте
+    if (options->counters) {
+        if (counters_start() == 0) {
+            profile.hardware = 1;
+        } else {
+            printf(
+                "[Info] Аппаратные счётчики недоступны (%s), "
+                "замеры без них\n",
+                counters_error()
+            );
+        }
+    }
+
+    // Готовый результат для тех же пикселей и той же цепочки
+    // берётся из кэша без декодирования и фильтров
+    CacheKey key;
+    int cached = 0, result = ALL_OK;
+    if (options->cache) {
+        if (options->profile) {
+            profile_begin(&profile);
+        }
+        cached = cache_key(ifile, filter_list, &key) == 0;
+        if (cached && options->profile) {
+            profile_end(&profile, "hash", key.pixels);
+        }
+    }
+
+    if (options->profile) {
+        profile_begin(&profile);
+    }
+    if (cached && cache_fetch(options->cache, &key, path) == 0) {
+        if (options->profile) {
+            profile_end(&profile, "cache", key.pixels);
+        }
+        printf("[Info] Результат взят из кэша\n");
+        printf("[Success] Изображение успешно сохранено!\n");
+    } else {
+        result = process_image(
+            ifile,
+            path,
+            filter_list,
+            options,
+            &profile
+        );
+
+        if (result == ALL_OK && cached &&
+            cache_store(
+                options->cache,
+                &key,
+                path,
+                cache_bytes(options, IC_CACHE_DEFAULT_SIZE)
+            ) != 0) {
+            printf(
+                "[Info] Не удалось сохранить результат в кэш "
+                "'%s'\n",
+                options->cache
+            );
+        }
+    }
+
+    if (result == ALL_OK && options->max_memory &&
+        profile_peak_rss_kb() != PROFILE_UNKNOWN) {
+        printf(
+            "[Info] Пик памяти: %.1f МБ из %d МБ\n",
+            profile_peak_rss_kb() / 1024.0,
+            options->max_memory
+        );
+    }
+
+    if (result == ALL_OK && options->profile) {
+        profile_print(&profile);
+    }
+
+    if (result == ALL_OK && options->profile_json &&
+        profile_write_json(&profile, options->profile_json) != 0) {
+        fprintf(
+            stderr,
+            "[Error] Не удалось записать профиль в '%s'\n",
+            options->profile_json
+        );
+        result = 1;
+    }
+
     // Очистка памяти
-    bmp_free(image);
+    free(path);
     free_filter_list(filter_list);
+    profile_free(&profile);
 
-    return ALL_OK;
+    return result;
+}
+
+int imagecraft(int argc, char** argv) {
+    char *ifile = NULL, *ofile = NULL;
+    Filter* filter_list = NULL;
+    Options options;
+    int parse_result = parse_args(
+        argc,
+        argv,
+        &ifile,
+        &ofile,
+        &filter_list,
+        &options
+    );
+
+    switch (parse_result) {
+        case IC_ARGS_ASSISTANT_ERROR: {
+            fprintf(
+                stderr,
+                "[Error] Ошибка обработка аргументов. Adiós!\n"
+            );
+            free_filter_list(filter_list);
+            free_output_chains(&options);
+            return 1;
+        }
+        case IC_ARGS_ASSISTANT_HELP: {
+            printhelp();
+            return 0;
+        }
+        case IC_ARGS_ASSISTANT_VERSION: {
+            printversion();
+            return 0;
+        }
+        case IC_ARGS_ASSISTANT_INFO: {
+            printinfo(ifile);
+            return 0;
+        }
+    }
+
+    if (argc < 3) {
+        printhelp();
+        free_filter_list(filter_list);
+        return 0;
+    }
+
+    // Трасса записывается во всех режимах обработки
+    if (options.trace) {
+        trace_start();
+        trace_thread_name("main");
+    }
+
+    int result;
+    if (parse_result == IC_ARGS_ASSISTANT_BATCH) {
+        result = run_batch(ifile, ofile, filter_list, &options);
+    } else if (parse_result == IC_ARGS_ASSISTANT_MULTI) {
+        result = run_multi(ifile, &options);
+        free_output_chains(&options);
+    } else if (parse_result == IC_ARGS_ASSISTANT_SERVE) {
+        result = run_daemon(ifile, filter_list, &options);
+    } else {
+        result = run_single(ifile, ofile, filter_list, &options);
+    }
+
+    if (options.counters) {
+        counters_stop();
+    }
+
+    if (options.trace) {
+        if (trace_write(options.trace) != 0) {
+            fprintf(
+                stderr,
+                "[Error] Не удалось записать трассу в '%s'\n",
+                options.trace
+            );
+            result = 1;
+        } else {
+            printf("[Info] Трасса записана в '%s'\n", options.trace);
+        }
+        trace_stop();
+    }
+
+    return result;
 }
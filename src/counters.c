@@ -0,0 +1,228 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+
+#include "counters.h"
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define COUNTER_COUNT 4
+
+// Счётчики одного потока: группа, первый счётчик - лидер
+typedef struct {
+    int fds[COUNTER_COUNT];
+} ThreadCounters;
+
+static const uint64_t counter_configs[COUNTER_COUNT] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES
+};
+
+static int enabled;
+static char error_text[128] = "счётчики не включены";
+
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static ThreadCounters* threads;
+static int thread_count;
+static int thread_capacity;
+
+static int perf_event_open(struct perf_event_attr* attr, int group) {
+    return (int)syscall(
+        SYS_perf_event_open,
+        attr,
+        0,  // Текущий поток
+        -1, // На любом ядре
+        group,
+        0
+    );
+}
+
+// Открытие группы счётчиков текущего потока. Возвращает 0 при
+// успехе, иначе errno
+static int open_group(ThreadCounters* counters) {
+    for (int c = 0; c < COUNTER_COUNT; c++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = counter_configs[c];
+        attr.read_format = PERF_FORMAT_GROUP |
+            PERF_FORMAT_TOTAL_TIME_ENABLED |
+            PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.disabled = c == 0;
+        attr.exclude_kernel = 1; // Доступно без привилегий
+        attr.exclude_hv = 1;
+
+        counters->fds[c] =
+            perf_event_open(&attr, c == 0 ? -1 : counters->fds[0]);
+        if (counters->fds[c] < 0) {
+            int error = errno;
+            while (c-- > 0) {
+                close(counters->fds[c]);
+            }
+            return error;
+        }
+    }
+
+    ioctl(
+        counters->fds[0],
+        PERF_EVENT_IOC_RESET,
+        PERF_IOC_FLAG_GROUP
+    );
+    ioctl(
+        counters->fds[0],
+        PERF_EVENT_IOC_ENABLE,
+        PERF_IOC_FLAG_GROUP
+    );
+    return 0;
+}
+
+// Регистрация группы в общем списке
+static int register_group(const ThreadCounters* counters) {
+    pthread_mutex_lock(&registry_lock);
+
+    if (thread_count == thread_capacity) {
+        int capacity = thread_capacity ? thread_capacity * 2 : 8;
+        ThreadCounters* grown = (ThreadCounters*)realloc(
+            threads,
+            capacity * sizeof(ThreadCounters)
+        );
+        if (!grown) {
+            pthread_mutex_unlock(&registry_lock);
+            return 1;
+        }
+        threads = grown;
+        thread_capacity = capacity;
+    }
+    threads[thread_count++] = *counters;
+
+    pthread_mutex_unlock(&registry_lock);
+    return 0;
+}
+
+static void close_group(const ThreadCounters* counters) {
+    for (int c = COUNTER_COUNT - 1; c >= 0; c--) {
+        close(counters->fds[c]);
+    }
+}
+
+int counters_start(void) {
+    counters_stop();
+
+    ThreadCounters counters;
+    int error = open_group(&counters);
+    if (error) {
+        snprintf(
+            error_text,
+            sizeof(error_text),
+            "perf_event_open: %s",
+            strerror(error)
+        );
+        return 1;
+    }
+
+    if (register_group(&counters) != 0) {
+        close_group(&counters);
+        snprintf(error_text, sizeof(error_text), "нет памяти");
+        return 1;
+    }
+
+    __atomic_store_n(&enabled, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+const char* counters_error(void) {
+    return error_text;
+}
+
+void counters_attach_thread(void) {
+    if (!__atomic_load_n(&enabled, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+
+    // Поток без счётчиков просто не попадает в сумму
+    ThreadCounters counters;
+    if (open_group(&counters) == 0 &&
+        register_group(&counters) != 0) {
+        close_group(&counters);
+    }
+}
+
+void counters_read(CounterValues* values) {
+    memset(values, 0, sizeof(*values));
+
+    pthread_mutex_lock(&registry_lock);
+    for (int t = 0; t < thread_count; t++) {
+        struct {
+            uint64_t count;
+            uint64_t time_enabled;
+            uint64_t time_running;
+            uint64_t values[COUNTER_COUNT];
+        } data;
+
+        if (read(threads[t].fds[0], &data, sizeof(data)) !=
+                (ssize_t)sizeof(data) ||
+            data.time_running == 0) {
+            continue;
+        }
+
+        // Поправка на мультиплексирование счётчиков ядром
+        double scale =
+            (double)data.time_enabled / data.time_running;
+        values->cycles += (uint64_t)(data.values[0] * scale);
+        values->instructions +=
+            (uint64_t)(data.values[1] * scale);
+        values->cache_misses +=
+            (uint64_t)(data.values[2] * scale);
+        values->branch_misses +=
+            (uint64_t)(data.values[3] * scale);
+    }
+    pthread_mutex_unlock(&registry_lock);
+}
+
+void counters_stop(void) {
+    __atomic_store_n(&enabled, 0, __ATOMIC_RELEASE);
+
+    pthread_mutex_lock(&registry_lock);
+    for (int t = 0; t < thread_count; t++) {
+        close_group(&threads[t]);
+    }
+    free(threads);
+    threads = NULL;
+    thread_count = 0;
+    thread_capacity = 0;
+    pthread_mutex_unlock(&registry_lock);
+}
+
+#else
+
+int counters_start(void) {
+    return 1;
+}
+
+const char* counters_error(void) {
+    return "perf_event_open доступен только в Linux";
+}
+
+void counters_attach_thread(void) {
+}
+
+void counters_read(CounterValues* values) {
+    memset(values, 0, sizeof(*values));
+}
+
+void counters_stop(void) {
+}
+
+#endif
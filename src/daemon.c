@@ -0,0 +1,439 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+
+#include "daemon.h"
+
+#ifdef _WIN32
+
+int daemon_run(const char* socket_path, const Execution* execution) {
+    (void)socket_path;
+    (void)execution;
+    fprintf(
+        stderr,
+        "[Error] Режим сервера не поддерживается в Windows\n"
+    );
+    return 1;
+}
+
+#else
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "arena.h"
+#include "args_assistant.h"
+#include "bmp.h"
+#include "defines.h"
+#include "roi.h"
+#include "trace.h"
+
+// Максимальная длина запроса и число слов в нем
+#define DAEMON_REQUEST_SIZE 4096
+#define DAEMON_MAX_WORDS 128
+
+// Период проверки сигнала остановки, мс
+#define DAEMON_POLL_INTERVAL 200
+
+// Состояние сервера, общее для потоков соединений
+typedef struct {
+    const Execution* execution;
+    pthread_mutex_t lock;
+    pthread_cond_t idle;
+    int active;   // Запросы в работе
+    int stopping; // Новые запросы не принимаются
+} DaemonState;
+
+typedef struct {
+    DaemonState* state;
+    int fd;
+} Connection;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_stop_signal(int signal_number) {
+    (void)signal_number;
+    stop_requested = 1;
+}
+
+static double now_ms(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1000.0 + time.tv_nsec / 1e6;
+}
+
+// Опции командной строки, которые в запросе не действуют: пул
+// потоков, кэш и замеры задаются при запуске сервера
+static const char* const unsupported_options[] = {
+    IC_ARGV_THREADS,     IC_ARGV_NUMA,
+    IC_ARGV_JOBS,        IC_ARGV_IO_URING,
+    IC_ARGV_PROFILE,     IC_ARGV_PROFILE_JSON,
+    IC_ARGV_COUNTERS,    IC_ARGV_TRACE,
+    IC_ARGV_CACHE,       IC_ARGV_CACHE_SIZE,
+    IC_ARGV_STAGE_CACHE, IC_ARGV_MAX_MEMORY,
+    IC_ARGV_BATCH,       IC_ARGV_MULTI,
+    IC_ARGV_SERVE,       IC_ARGV_OUTPUT,
+    IC_ARGV_INFO,        IC_ARGV_HELP,
+    IC_ARGV_VERSION
+};
+
+// Первая опция запроса, которую сервер не поддерживает, или NULL
+static const char*
+find_unsupported_option(char** words, int count) {
+    int known = (int)(sizeof(unsupported_options) /
+                      sizeof(unsupported_options[0]));
+    for (int i = 1; i < count; i++) {
+        for (int k = 0; k < known; k++) {
+            if (strcmp(words[i], unsupported_options[k]) == 0) {
+                return unsupported_options[k];
+            }
+        }
+    }
+    return NULL;
+}
+
+// Выполнение одного запроса. Ответ записывается в response
+static void handle_request(
+    const DaemonState* state,
+    char* line,
+    char* response,
+    size_t size
+) {
+    // Запрос разбирается так же, как командная строка
+    char* words[DAEMON_MAX_WORDS];
+    int count = 0;
+    char* save = NULL;
+    words[count++] = "imagecraft";
+    char* word = strtok_r(line, " \t", &save);
+    for (; word && count < DAEMON_MAX_WORDS;
+         word = strtok_r(NULL, " \t", &save)) {
+        words[count++] = word;
+    }
+
+    // Отброшенный хвост выполнил бы укороченную цепочку
+    if (word) {
+        snprintf(
+            response,
+            size,
+            "ERROR слишком много слов в запросе (больше %d)\n",
+            DAEMON_MAX_WORDS - 1
+        );
+        return;
+    }
+
+    char *ifile = NULL, *ofile = NULL;
+    Filter* filter_list = NULL;
+    Options options;
+
+    if (count < 3 || words[1][0] == '-' || words[2][0] == '-') {
+        snprintf(
+            response,
+            size,
+            "ERROR ожидается: input output [фильтры]\n"
+        );
+        return;
+    }
+
+    const char* option = find_unsupported_option(words, count);
+    if (option) {
+        snprintf(
+            response,
+            size,
+            "ERROR %s не поддерживается в режиме сервера\n",
+            option
+        );
+        return;
+    }
+
+    if (parse_args(
+            count,
+            words,
+            &ifile,
+            &ofile,
+            &filter_list,
+            &options
+        ) != IC_ARGS_ASSISTANT_OK) {
+        free_filter_list(filter_list);
+        snprintf(response, size, "ERROR некорректная цепочка\n");
+        return;
+    }
+
+    double start = now_ms();
+
+    // Строки читают и пишут рабочие потоки общего пула, если
+    // запрос передал -parallel-io
+    Scheduler* io =
+        options.parallel_io ? state->execution->scheduler : NULL;
+
+    BMPRegion region;
+    RoiWindow window;
+    BMPImage* image =
+        roi_load(ifile, filter_list, &window, &region, io);
+    double loaded = now_ms();
+
+    if (!image) {
+        free_filter_list(filter_list);
+        snprintf(
+            response,
+            size,
+            "ERROR не удалось загрузить '%s'\n",
+            ifile
+        );
+        return;
+    }
+
+    int applied = apply_filters_window(
+        &image,
+        filter_list,
+        &window,
+        state->execution
+    );
+    free_filter_list(filter_list);
+    double filtered = now_ms();
+
+    if (applied < 0) {
+        bmp_free(image);
+        snprintf(
+            response,
+            size,
+            "ERROR ошибка применения фильтра #%d\n",
+            -applied
+        );
+        return;
+    }
+
+    int save_result = bmp_save_parallel(image, ofile, io);
+    bmp_free(image);
+    double saved = now_ms();
+
+    if (save_result != ALL_OK) {
+        snprintf(
+            response,
+            size,
+            "ERROR ошибка сохранения '%s' (код: %d)\n",
+            ofile,
+            save_result
+        );
+        return;
+    }
+
+    snprintf(
+        response,
+        size,
+        "OK load=%.3f filter=%.3f save=%.3f total=%.3f\n",
+        loaded - start,
+        filtered - loaded,
+        saved - filtered,
+        saved - start
+    );
+}
+
+// Поток соединения: запросы обрабатываются по очереди
+static void* connection_main(void* argument) {
+    Connection* connection = (Connection*)argument;
+    DaemonState* state = connection->state;
+    int fd = connection->fd;
+    free(connection);
+    trace_thread_name("connection");
+
+    FILE* input = fdopen(fd, "r");
+    if (!input) {
+        close(fd);
+        return NULL;
+    }
+
+    char line[DAEMON_REQUEST_SIZE];
+    char response[DAEMON_REQUEST_SIZE + 128];
+
+    // Временная память запроса берется из арены соединения и
+    // возвращается ей после ответа
+    Arena* arena = arena_create(0);
+    arena_enter(arena);
+
+    while (fgets(line, sizeof(line), input)) {
+        // Не поместившийся в буфер запрос дочитывается до конца
+        // строки и получает один ответ, иначе ответы клиенту
+        // сдвинулись бы относительно его запросов
+        if (!strchr(line, '\n') &&
+            strlen(line) == sizeof(line) - 1) {
+            int c;
+            do {
+                c = fgetc(input);
+            } while (c != EOF && c != '\n');
+            if (dprintf(
+                    fd,
+                    "ERROR запрос слишком длинный\n"
+                ) < 0) {
+                break;
+            }
+            continue;
+        }
+
+        // Пустой запрос тоже получает ответ: клиент его ждет
+        line[strcspn(line, "\r\n")] = '\0';
+
+        pthread_mutex_lock(&state->lock);
+        int stopping = state->stopping;
+        if (!stopping) {
+            state->active++;
+        }
+        pthread_mutex_unlock(&state->lock);
+
+        if (stopping) {
+            dprintf(fd, "ERROR сервер останавливается\n");
+            break;
+        }
+
+        ArenaMark mark = arena_mark(arena);
+        handle_request(state, line, response, sizeof(response));
+        arena_rewind(arena, mark);
+
+        pthread_mutex_lock(&state->lock);
+        state->active--;
+        pthread_cond_broadcast(&state->idle);
+        pthread_mutex_unlock(&state->lock);
+
+        if (dprintf(fd, "%s", response) < 0) {
+            break;
+        }
+    }
+
+    arena_enter(NULL);
+    arena_destroy(arena);
+    fclose(input);
+    return NULL;
+}
+
+int daemon_run(const char* socket_path, const Execution* execution) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        fprintf(
+            stderr,
+            "[Error] Слишком длинный путь к сокету '%s'\n",
+            socket_path
+        );
+        return 1;
+    }
+    strcpy(address.sun_path, socket_path);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        fprintf(stderr, "[Error] Не удалось создать сокет\n");
+        return 1;
+    }
+
+    // Оставшийся от прошлого запуска файл сокета мешает bind
+    unlink(socket_path);
+    if (bind(
+            listener,
+            (struct sockaddr*)&address,
+            sizeof(address)
+        ) != 0 ||
+        listen(listener, SOMAXCONN) != 0) {
+        fprintf(
+            stderr,
+            "[Error] Не удалось открыть сокет '%s': %s\n",
+            socket_path,
+            strerror(errno)
+        );
+        close(listener);
+        return 1;
+    }
+
+    // Сигнал может прийти в любой поток, поэтому основной поток
+    // проверяет флаг остановки периодически. Закрытое клиентом
+    // соединение не должно завершать процесс
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = on_stop_signal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    // Потоки соединений могут пережить возврат из функции,
+    // поэтому состояние не на стеке
+    static DaemonState state;
+    state.execution = execution;
+    state.active = 0;
+    state.stopping = 0;
+    pthread_mutex_init(&state.lock, NULL);
+    pthread_cond_init(&state.idle, NULL);
+
+    printf(
+        "[Info] Сервер слушает '%s', потоков: %d\n",
+        socket_path,
+        scheduler_workers(execution->scheduler)
+    );
+    fflush(stdout);
+
+    while (!stop_requested) {
+        struct pollfd waiting = { listener, POLLIN, 0 };
+        if (poll(&waiting, 1, DAEMON_POLL_INTERVAL) <= 0) {
+            continue;
+        }
+
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(
+                stderr,
+                "[Error] Ошибка accept: %s\n",
+                strerror(errno)
+            );
+            break;
+        }
+
+        Connection* connection =
+            (Connection*)malloc(sizeof(Connection));
+        pthread_t thread;
+        if (!connection) {
+            close(fd);
+            continue;
+        }
+        connection->state = &state;
+        connection->fd = fd;
+
+        if (pthread_create(
+                &thread,
+                NULL,
+                connection_main,
+                connection
+            ) != 0) {
+            free(connection);
+            close(fd);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+
+    close(listener);
+    unlink(socket_path);
+
+    // Ждём завершения начатых запросов. Простаивающие
+    // соединения закрываются вместе с процессом
+    pthread_mutex_lock(&state.lock);
+    state.stopping = 1;
+    while (state.active > 0) {
+        pthread_cond_wait(&state.idle, &state.lock);
+    }
+    pthread_mutex_unlock(&state.lock);
+
+    printf("[Info] Сервер остановлен\n");
+    return 0;
+}
+
+#endif // _WIN32
@@ -0,0 +1,304 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dag.h"
+#include "defines.h"
+#include "paths.h"
+
+// Стадия дерева: один фильтр и всё, что из него выходит
+typedef struct _DagNode {
+    Filter filter; // Фильтр стадии (у корня не используется)
+    const char** outputs; // Файлы, сохраняемые после стадии
+    int output_count;
+    struct _DagNode** children;
+    int child_count;
+} DagNode;
+
+struct _Dag {
+    DagNode root; // Входное изображение
+    Filter** chains; // Копии цепочек для планирования области
+    int chain_count;
+    int stages;
+    int requested;
+};
+
+Dag* dag_create(void) {
+    return (Dag*)calloc(1, sizeof(Dag));
+}
+
+static void free_node(DagNode* node) {
+    for (int i = 0; i < node->child_count; i++) {
+        free_node(node->children[i]);
+        free(node->children[i]);
+    }
+    free(node->children);
+    free(node->outputs);
+}
+
+void dag_free(Dag* dag) {
+    if (!dag) {
+        return;
+    }
+
+    free_node(&dag->root);
+    for (int i = 0; i < dag->chain_count; i++) {
+        free_filter_list(dag->chains[i]);
+    }
+    free(dag->chains);
+    free(dag);
+}
+
+// Фильтры совпадают, если совпадают тип и все параметры
+static int same_filter(const Filter* a, const Filter* b) {
+    return a->type == b->type &&
+           a->param_count == b->param_count &&
+           memcmp(
+               a->params,
+               b->params,
+               a->param_count * sizeof(int)
+           ) == 0;
+}
+
+// Дочерняя стадия node с фильтром filter, созданная при
+// необходимости
+static DagNode*
+child_for(Dag* dag, DagNode* node, const Filter* filter) {
+    for (int i = 0; i < node->child_count; i++) {
+        if (same_filter(&node->children[i]->filter, filter)) {
+            return node->children[i];
+        }
+    }
+
+    DagNode** grown = (DagNode**)realloc(
+        node->children,
+        (node->child_count + 1) * sizeof(DagNode*)
+    );
+    if (!grown) {
+        return NULL;
+    }
+    node->children = grown;
+
+    DagNode* child = (DagNode*)calloc(1, sizeof(DagNode));
+    if (!child) {
+        return NULL;
+    }
+    child->filter = *filter;
+    child->filter.next = NULL;
+    node->children[node->child_count++] = child;
+    dag->stages++;
+    return child;
+}
+
+// Копия цепочки фильтров. Узлы выделяются так же, как при
+// разборе аргументов, и освобождаются free_filter_list
+static Filter* copy_chain(const Filter* chain, int* error) {
+    Filter* head = NULL;
+    Filter** tail = &head;
+    for (; chain; chain = chain->next) {
+        Filter* copy = (Filter*)malloc(sizeof(Filter));
+        if (!copy) {
+            *error = 1;
+            break;
+        }
+        *copy = *chain;
+        copy->next = NULL;
+        *tail = copy;
+        tail = &copy->next;
+    }
+    return head;
+}
+
+int dag_add(Dag* dag, const char* output, const Filter* chain) {
+    DagNode* node = &dag->root;
+    for (const Filter* f = chain; f; f = f->next) {
+        node = child_for(dag, node, f);
+        if (!node) {
+            return 1;
+        }
+        dag->requested++;
+    }
+
+    const char** outputs = (const char**)realloc(
+        node->outputs,
+        (node->output_count + 1) * sizeof(const char*)
+    );
+    Filter** chains = (Filter**)realloc(
+        dag->chains,
+        (dag->chain_count + 1) * sizeof(Filter*)
+    );
+    if (outputs) {
+        node->outputs = outputs;
+    }
+    if (chains) {
+        dag->chains = chains;
+    }
+    if (!outputs || !chains) {
+        return 1;
+    }
+
+    int error = 0;
+    dag->chains[dag->chain_count++] = copy_chain(chain, &error);
+    node->outputs[node->output_count++] = output;
+    return error;
+}
+
+void dag_stats(const Dag* dag, int* stages, int* requested) {
+    *stages = dag->stages;
+    *requested = dag->requested;
+}
+
+BMPImage* dag_load(
+    const Dag* dag,
+    const char* filename,
+    RoiWindow* window,
+    BMPRegion* region
+) {
+    BMPFileHeader file_header;
+    BMPInfoHeader info_header;
+    if (bmp_read_headers(filename, &file_header, &info_header) !=
+        ALL_OK) {
+        return NULL;
+    }
+
+    int32_t width = info_header.width;
+    int32_t height = abs(info_header.height);
+
+    // Объединение областей, нужных каждой цепочке
+    int32_t left = width, top = height, right = 0, bottom = 0;
+    for (int i = 0; i < dag->chain_count; i++) {
+        BMPRegion needed;
+        roi_plan(dag->chains[i], width, height, &needed);
+
+        if (needed.x < left) {
+            left = needed.x;
+        }
+        if (needed.y < top) {
+            top = needed.y;
+        }
+        if (needed.x + needed.width > right) {
+            right = needed.x + needed.width;
+        }
+        if (needed.y + needed.height > bottom) {
+            bottom = needed.y + needed.height;
+        }
+    }
+    if (right <= left || bottom <= top) {
+        left = top = 0;
+        right = width;
+        bottom = height;
+    }
+
+    region->x = left;
+    region->y = top;
+    region->width = right - left;
+    region->height = bottom - top;
+
+    window->x = left;
+    window->y = top;
+    window->frame_width = width;
+    window->frame_height = height;
+
+    return bmp_load_region(filename, region);
+}
+
+static int count_outputs(const DagNode* node) {
+    int count = node->output_count;
+    for (int i = 0; i < node->child_count; i++) {
+        count += count_outputs(node->children[i]);
+    }
+    return count;
+}
+
+// Сохранение результата стадии с созданием каталогов
+static int save_output(BMPImage* image, const char* path) {
+    char directory_buffer[1024];
+    char* directory = get_directory_from_path(
+        path,
+        directory_buffer,
+        sizeof(directory_buffer)
+    );
+    if (directory && strcmp(directory, path) != 0 &&
+        create_output_directory_recursive(directory) != 0) {
+        fprintf(
+            stderr,
+            "[Error] Не удалось создать директорию '%s'\n",
+            directory
+        );
+        return 1;
+    }
+
+    int result = bmp_save(image, path);
+    if (result != ALL_OK) {
+        fprintf(
+            stderr,
+            "[Error] Ошибка сохранения '%s' (код: %d)\n",
+            path,
+            result
+        );
+        return 1;
+    }
+
+    printf("[Success] Сохранено '%s'\n", path);
+    return 0;
+}
+
+// Выполнение поддерева node над его входом image (забирается во
+// владение). Стадии без ветвления и без выходов выполняются
+// одним отрезком цепочки, чтобы сохранить слияние по тайлам.
+// Возвращает число неудавшихся выходов
+static int evaluate(
+    DagNode* node,
+    BMPImage* image,
+    const RoiWindow* window,
+    const Execution* execution
+) {
+    int failed = 0;
+    for (int i = 0; i < node->output_count; i++) {
+        failed += save_output(image, node->outputs[i]);
+    }
+
+    for (int i = 0; i < node->child_count; i++) {
+        // Последняя ветвь забирает буфер, остальные работают с
+        // копией
+        int last = i == node->child_count - 1;
+        BMPImage* input = last ? image : bmp_copy(image);
+        DagNode* start = node->children[i];
+
+        // Отрезок до следующего ветвления или выхода
+        DagNode* end = start;
+        while (end->child_count == 1 && end->output_count == 0) {
+            end->filter.next = &end->children[0]->filter;
+            end = end->children[0];
+        }
+        end->filter.next = NULL;
+
+        RoiWindow branch = *window;
+        if (!input || apply_filters_window(
+                          &input,
+                          &start->filter,
+                          &branch,
+                          execution
+                      ) < 0) {
+            bmp_free(input);
+            failed += count_outputs(start);
+            continue;
+        }
+
+        failed += evaluate(end, input, &branch, execution);
+    }
+
+    if (node->child_count == 0) {
+        bmp_free(image);
+    }
+    return failed;
+}
+
+int dag_run(
+    Dag* dag,
+    BMPImage* image,
+    const RoiWindow* window,
+    const Execution* execution
+) {
+    return evaluate(&dag->root, image, window, execution);
+}
@@ -3,9 +3,15 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "arena.h"
 #include "convolution.h"
 #include "defines.h"
+#include "execution.h"
 #include "filters.h"
+#include "registry.h"
+#include "roi.h"
+#include "tiles.h"
+#include "trace.h"
 
 // ==================== ВСПОМОГАТЕЛЬНЫЕ ФУНКЦИИ
 // ====================
@@ -32,9 +38,27 @@ uint8_t clamp_int_to_uint8(int value) {
 
 // ==================== РЕАЛИЗАЦИИ ФИЛЬТРОВ ====================
 
+// Подготовка приёмника: заголовки источника и заданные размеры
+static int prepare_destination(
+    const BMPImage* src,
+    BMPImage* dst,
+    int32_t width,
+    int32_t height
+) {
+    dst->file_header = src->file_header;
+    dst->info_header = src->info_header;
+    return bmp_reshape(dst, width, height);
+}
+
 // Фильтр обрезки (crop)
-BMPImage* filter_crop(BMPImage* image, int width, int height) {
-    if (!image || width <= 0 || height <= 0) {
+BMPImage* filter_crop(
+    BMPImage* image,
+    int x,
+    int y,
+    int width,
+    int height
+) {
+    if (!image || x < 0 || y < 0 || width <= 0 || height <= 0) {
         return NULL;
     }
 
@@ -43,34 +67,22 @@ BMPImage* filter_crop(BMPImage* image, int width, int height) {
     int32_t abs_img_height =
         img_height < 0 ? -img_height : img_height;
 
-    // Если запрошенные размеры больше исходных, используем
-    // доступную часть
-    int crop_width = (width > img_width) ? img_width : width;
-    int crop_height =
-        (height > abs_img_height) ? abs_img_height : height;
-
-    // Создаем новое изображение нужного размера
-    BMPImage* cropped = bmp_create(crop_width, crop_height);
-    if (!cropped) {
+    // Область начинается за пределами изображения
+    if (x >= img_width || y >= abs_img_height) {
         return NULL;
     }
 
-    // Копируем пиксели из верхнего левого угла
-    for (int y = 0; y < crop_height; y++) {
-        for (int x = 0; x < crop_width; x++) {
-            RGBPixel pixel = bmp_get_pixel(image, x, y);
-            bmp_set_pixel(
-                cropped,
-                x,
-                y,
-                pixel.red,
-                pixel.green,
-                pixel.blue
-            );
-        }
-    }
-
-    return cropped;
+    // Если запрошенные размеры больше исходных, используем
+    // доступную часть
+    int crop_width =
+        (width > img_width - x) ? img_width - x : width;
+    int crop_height = (height > abs_img_height - y)
+        ? abs_img_height - y
+        : height;
+
+    // Пиксели не копируются: результат ссылается на буфер
+    // исходного изображения
+    return bmp_create_view(image, x, y, crop_width, crop_height);
 }
 
 // Фильтр оттенков серого (grayscale)
@@ -126,8 +138,8 @@ int filter_negative(BMPImage* image) {
 }
 
 // Фильтр повышения резкости (sharpening)
-int filter_sharpening(BMPImage* image) {
-    if (!image) {
+int filter_sharpening(const BMPImage* image, BMPImage* result) {
+    if (!image || !result) {
         return 1;
     }
 
@@ -146,136 +158,114 @@ int filter_sharpening(BMPImage* image) {
         return 1;
     }
 
-    BMPImage* result = convolute(image, kernel);
-    if (!result) {
-        kernel_free(kernel);
-        return 1;
-    }
+    int error = convolute(image, result, kernel);
+    kernel_free(kernel);
 
-    // Копируем результат обратно в исходное изображение
-    int32_t width = image->info_header.width;
-    int32_t height = image->info_header.height;
-    int32_t abs_height = height < 0 ? -height : height;
+    return error != ALL_OK;
+}
 
-    for (int y = 0; y < abs_height; y++) {
-        for (int x = 0; x < width; x++) {
-            RGBPixel pixel = bmp_get_pixel(result, x, y);
-            bmp_set_pixel(
-                image,
-                x,
-                y,
-                pixel.red,
-                pixel.green,
-                pixel.blue
-            );
-        }
+// Заполнение строки яркостей по строке изображения
+static void fill_luma_row(
+    const BMPImage* image,
+    int32_t row,
+    uint8_t* luma
+) {
+    int32_t width = image->info_header.width;
+    const RGBPixel* pixels = image->pixels[row];
+
+    for (int32_t x = 0; x < width; x++) {
+        luma[x] = (uint8_t)rgb_to_grayscale(
+            pixels[x].red,
+            pixels[x].green,
+            pixels[x].blue
+        );
     }
-
-    bmp_free(result);
-    kernel_free(kernel);
-    return 0;
 }
 
 // Фильтр выделения границ (edge detection)
-BMPImage*
-filter_edge_detection(BMPImage* image, float threshold) {
-    if (!image) {
-        return NULL;
-    }
-
-    // Сначала преобразуем в оттенки серого
-    BMPImage* gray_image = bmp_copy(image);
-    if (!gray_image) {
-        return NULL;
+int filter_edge_detection(
+    const BMPImage* image,
+    BMPImage* edges,
+    float threshold
+) {
+    if (!image || !edges) {
+        return 1;
     }
-    
-    filter_grayscale(gray_image);
 
-    // Матрица для выделения границ
-    float edge_matrix[3][3] = { { 0, -1, 0 },
-                                { -1, 4, -1 },
-                                { 0, -1, 0 } };
+    int32_t width = image->info_header.width;
+    int32_t height = image->info_header.height;
+    int32_t abs_height = height < 0 ? -height : height;
 
-    float* rows[3];
-    for (int i = 0; i < 3; i++) {
-        rows[i] = edge_matrix[i];
+    if (prepare_destination(image, edges, width, height) !=
+        ALL_OK) {
+        return 1;
     }
 
-    Kernel* kernel = kernel_create(3, rows);
-    if (!kernel) {
-        bmp_free(gray_image);
-        return NULL;
+    // Вместо полной черно-белой копии держим скользящее окно
+    // из трех строк яркостей
+    uint8_t* luma = (uint8_t*)scratch_alloc(3 * (size_t)width);
+    if (!luma) {
+        return 1;
     }
 
-    BMPImage* edges = convolute(gray_image, kernel);
-    bmp_free(gray_image);
-    kernel_free(kernel);
+    uint8_t* above = luma;
+    uint8_t* center = luma + width;
+    uint8_t* below = luma + 2 * (size_t)width;
 
-    if (!edges) {
-        return NULL;
-    }
-
-    // Применяем порог
-    int32_t width = edges->info_header.width;
-    int32_t height = edges->info_header.height;
-    int32_t abs_height = height < 0 ? -height : height;
+    fill_luma_row(image, 0, center);
+    memcpy(above, center, width);
 
     float threshold_value = threshold * 255.0f;
 
-    for (int y = 0; y < abs_height; y++) {
-        for (int x = 0; x < width; x++) {
-            RGBPixel pixel = bmp_get_pixel(edges, x, y);
-            float gray = rgb_to_grayscale(
-                pixel.red,
-                pixel.green,
-                pixel.blue
-            );
+    for (int32_t row = 0; row < abs_height; row++) {
+        fill_luma_row(
+            image,
+            row + 1 < abs_height ? row + 1 : row,
+            below
+        );
 
-            if (gray > threshold_value) {
-                bmp_set_pixel(
-                    edges,
-                    x,
-                    y,
-                    255,
-                    255,
-                    255
-                ); // \u0411\u0435\u043b\u044b\u0439
-            } else {
-                bmp_set_pixel(
-                    edges,
-                    x,
-                    y,
-                    0,
-                    0,
-                    0
-                ); // \u0427\u0435\u0440\u043d\u044b\u0439
-            }
+        for (int32_t x = 0; x < width; x++) {
+            int32_t left = x > 0 ? x - 1 : x;
+            int32_t right = x + 1 < width ? x + 1 : x;
+
+            // Лапласиан { 0, -1, 0 }, { -1, 4, -1 }, { 0, -1, 0 }
+            int laplacian = 4 * center[x] - above[x] -
+                below[x] - center[left] - center[right];
+            uint8_t value = clamp_int_to_uint8(laplacian);
+
+            float gray = rgb_to_grayscale(value, value, value);
+            uint8_t color = gray > threshold_value ? 255 : 0;
+
+            edges->pixels[row][x].red = color;
+            edges->pixels[row][x].green = color;
+            edges->pixels[row][x].blue = color;
         }
+
+        // Сдвигаем окно строк на одну вниз
+        uint8_t* recycled = above;
+        above = center;
+        center = below;
+        below = recycled;
     }
 
-    return edges;
+    scratch_free(luma);
+    return 0;
 }
 
+// Наибольший размер ядра Гаусса
+#define GAUSSIAN_MAX_KERNEL 11
+
 // Вспомогательная функция для создания ядра Гаусса
 static Kernel* create_gaussian_kernel(int size, float sigma) {
-    if (size % 2 == 0) {
-        return NULL;
-    }
-
-    float** matrix = (float**)malloc(size * sizeof(float*));
-    if (!matrix) {
+    if (size % 2 == 0 || size > GAUSSIAN_MAX_KERNEL) {
         return NULL;
     }
 
+    // Временная матрица на стеке: размер ядра ограничен
+    float values[GAUSSIAN_MAX_KERNEL][GAUSSIAN_MAX_KERNEL];
+    float* matrix[GAUSSIAN_MAX_KERNEL];
     for (int i = 0; i < size; i++) {
-        matrix[i] = (float*)malloc(size * sizeof(float));
-        if (!matrix[i]) {
-            for (int j = 0; j < i; j++) {
-                free(matrix[j]);
-            }
-            free(matrix);
-            return NULL;
-        }
+        matrix[i] = values[i];
     }
 
     float sum = 0.0f;
@@ -297,39 +287,42 @@ static Kernel* create_gaussian_kernel(int size, float sigma) {
         }
     }
 
-    Kernel* kernel = kernel_create(size, matrix);
+    return kernel_create(size, matrix);
+}
 
-    // Освобождаем временную матрицу
-    for (int i = 0; i < size; i++) {
-        free(matrix[i]);
-    }
-    free(matrix);
+// Размер ядра Гаусса для заданного sigma
+int filter_gaussian_kernel_size(float sigma) {
+    // Определяем размер ядра (минимум 3x3, максимум 11x11)
+    int kernel_size = (int)(sigma * 6) | 1; // Нечетное число
+    if (kernel_size < 3)
+        kernel_size = 3;
+    if (kernel_size > GAUSSIAN_MAX_KERNEL)
+        kernel_size = GAUSSIAN_MAX_KERNEL;
 
-    return kernel;
+    return kernel_size;
 }
 
 // Фильтр Гауссова размытия (gaussian blur)
-BMPImage* filter_gaussian_blur(BMPImage* image, float sigma) {
-    if (!image || sigma <= 0) {
-        return NULL;
+int filter_gaussian_blur(
+    const BMPImage* image,
+    BMPImage* blurred,
+    float sigma
+) {
+    if (!image || !blurred || sigma <= 0) {
+        return 1;
     }
 
-    // Определяем размер ядра (минимум 3x3, максимум 11x11)
-    int kernel_size = (int)(sigma * 6) | 1; // Нечетное число
-    if (kernel_size < 3)
-        kernel_size = 3;
-    if (kernel_size > 11)
-        kernel_size = 11;
+    int kernel_size = filter_gaussian_kernel_size(sigma);
 
     Kernel* kernel = create_gaussian_kernel(kernel_size, sigma);
     if (!kernel) {
-        return NULL;
+        return 1;
     }
 
-    BMPImage* blurred = convolute(image, kernel);
+    int error = convolute(image, blurred, kernel);
     kernel_free(kernel);
 
-    return blurred;
+    return error != ALL_OK;
 }
 
 // Вспомогательная функция для сравнения значений (для медианного
@@ -339,38 +332,36 @@ static int compare_uint8(const void* a, const void* b) {
 }
 
 // Фильтр медианной фильтрации (median filter)
-BMPImage* filter_median(BMPImage* image, int window) {
-    if (!image || window % 2 == 0 || window < 3) {
-        return NULL;
-    }
-
-    BMPImage* result = bmp_copy(image);
-    if (!result) {
-        return NULL;
+int filter_median(
+    const BMPImage* image,
+    BMPImage* result,
+    int window
+) {
+    if (!image || !result || window % 2 == 0 || window < 3) {
+        return 1;
     }
 
     int32_t width = image->info_header.width;
     int32_t height = image->info_header.height;
     int32_t abs_height = height < 0 ? -height : height;
 
+    if (prepare_destination(image, result, width, height) !=
+        ALL_OK) {
+        return 1;
+    }
+
     int half = window / 2;
     int total_pixels = window * window;
 
-    // Выделяем память для массивов значений
-    uint8_t* reds =
-        (uint8_t*)malloc(total_pixels * sizeof(uint8_t));
-    uint8_t* greens =
-        (uint8_t*)malloc(total_pixels * sizeof(uint8_t));
-    uint8_t* blues =
-        (uint8_t*)malloc(total_pixels * sizeof(uint8_t));
-
-    if (!reds || !greens || !blues) {
-        free(reds);
-        free(greens);
-        free(blues);
-        bmp_free(result);
-        return NULL;
+    // Массивы значений каналов - один блок временной памяти
+    uint8_t* reds = (uint8_t*)scratch_alloc(
+        3 * total_pixels * sizeof(uint8_t)
+    );
+    if (!reds) {
+        return 1;
     }
+    uint8_t* greens = reds + total_pixels;
+    uint8_t* blues = greens + total_pixels;
 
     for (int y = 0; y < abs_height; y++) {
         for (int x = 0; x < width; x++) {
@@ -421,11 +412,9 @@ BMPImage* filter_median(BMPImage* image, int window) {
         }
     }
 
-    free(reds);
-    free(greens);
-    free(blues);
+    scratch_free(reds);
 
-    return result;
+    return 0;
 }
 
 // Структура для хранения центра ячейки и среднего цвета
@@ -442,21 +431,130 @@ static float pseudo_random(int seed) {
     return ((seed * (seed * seed * 15731 + 789221) + 1376312589) & 0x7FFFFFFF) / 2147483648.0f;
 }
 
-// Фильтр кристаллизации (Crystallize)
-BMPImage* filter_crystallize(BMPImage* image, float center_x, float center_y, float radius) {
-    if (!image || radius <= 0) {
-        return NULL;
+// Строк изображения в одной задаче кристаллизации
+#define CRYSTAL_TASK_ROWS 16
+
+// Общие данные задач кристаллизации
+typedef struct {
+    const BMPImage* image;
+    BMPImage* result;
+    const CrystalCell* cells;
+    int cells_x;
+    int cells_y;
+    int cell_size;
+    int32_t width;
+    int32_t abs_height;
+    int32_t first_row; // Первая строка волны (первый проход)
+    int* nearest;      // Ближайшие ячейки пикселей волны
+} CrystalJob;
+
+// Поиск ближайшего центра ячейки. Центр смещён от угла своей
+// ячейки не больше чем на 0.15 ее размера, поэтому ближайший
+// центр всегда среди ячеек сетки со сдвигом -1..+2 от пикселя, а
+// любой центр за их пределами строго дальше. Ячейки
+// перебираются в том же порядке, что и при полном переборе, так
+// что при равных расстояниях выбирается та же ячейка
+static int crystal_nearest(const CrystalJob* job, int x, int y) {
+    int gx = x / job->cell_size;
+    int gy = y / job->cell_size;
+    int cx_from = gx > 0 ? gx - 1 : 0;
+    int cy_from = gy > 0 ? gy - 1 : 0;
+    int cx_to = gx + 2 < job->cells_x ? gx + 2 : job->cells_x - 1;
+    int cy_to = gy + 2 < job->cells_y ? gy + 2 : job->cells_y - 1;
+
+    float min_dist = 1e10f;
+    int nearest_idx = 0;
+
+    for (int cy = cy_from; cy <= cy_to; cy++) {
+        for (int cx = cx_from; cx <= cx_to; cx++) {
+            int idx = cy * job->cells_x + cx;
+            float dx = x - job->cells[idx].center_x;
+            float dy = y - job->cells[idx].center_y;
+            float dist = dx * dx + dy * dy;
+
+            if (dist < min_dist) {
+                min_dist = dist;
+                nearest_idx = idx;
+            }
+        }
     }
 
-    BMPImage* result = bmp_create(image->info_header.width, image->info_header.height);
-    if (!result) {
-        return NULL;
+    return nearest_idx;
+}
+
+// Задача первого прохода: ближайшие ячейки для полосы строк
+// текущей волны
+static void crystal_find_task(void* context, int index, int worker) {
+    (void)worker;
+    CrystalJob* job = (CrystalJob*)context;
+
+    int32_t from = job->first_row + index * CRYSTAL_TASK_ROWS;
+    int32_t to = from + CRYSTAL_TASK_ROWS;
+    if (to > job->abs_height) {
+        to = job->abs_height;
+    }
+
+    for (int32_t y = from; y < to; y++) {
+        int* nearest =
+            job->nearest + (size_t)(y - job->first_row) * job->width;
+        for (int32_t x = 0; x < job->width; x++) {
+            nearest[x] = crystal_nearest(job, x, y);
+        }
+    }
+}
+
+// Задача второго прохода: заполнение полосы строк средними
+// цветами ячеек
+static void crystal_fill_task(void* context, int index, int worker) {
+    (void)worker;
+    CrystalJob* job = (CrystalJob*)context;
+
+    int32_t from = index * CRYSTAL_TASK_ROWS;
+    int32_t to = from + CRYSTAL_TASK_ROWS;
+    if (to > job->abs_height) {
+        to = job->abs_height;
+    }
+
+    for (int32_t y = from; y < to; y++) {
+        for (int32_t x = 0; x < job->width; x++) {
+            const CrystalCell* cell =
+                &job->cells[crystal_nearest(job, x, y)];
+
+            // Используем средний цвет ячейки
+            bmp_set_pixel(
+                job->result,
+                x,
+                y,
+                (uint8_t)cell->sum_r,
+                (uint8_t)cell->sum_g,
+                (uint8_t)cell->sum_b
+            );
+        }
+    }
+}
+
+// Фильтр кристаллизации (Crystallize)
+int filter_crystallize(
+    const BMPImage* image,
+    BMPImage* result,
+    float center_x,
+    float center_y,
+    float radius,
+    Scheduler* scheduler
+) {
+    if (!image || !result || radius <= 0) {
+        return 1;
     }
 
     int32_t width = image->info_header.width;
     int32_t height = image->info_header.height;
     int32_t abs_height = height < 0 ? -height : height;
 
+    if (prepare_destination(image, result, width, height) !=
+        ALL_OK) {
+        return 1;
+    }
+
     // Если центр не указан, используем центр изображения
     if (center_x < 0) center_x = width / 2.0f;
     if (center_y < 0) center_y = abs_height / 2.0f;
@@ -464,29 +562,50 @@ BMPImage* filter_crystallize(BMPImage* image, float center_x, float center_y, fl
     // Вычисляем размер сетки ячеек на основе радиуса
     int cell_size = (int)(radius * 2.0f);
     if (cell_size < 2) cell_size = 2;
-    
+
     // Количество ячеек по горизонтали и вертикали
     int cells_x = (width + cell_size - 1) / cell_size + 1;
     int cells_y = (abs_height + cell_size - 1) / cell_size + 1;
-    
+
+    // Первый проход идёт волнами: потоки находят ближайшие ячейки
+    // для нескольких полос, а суммы цветов накапливаются в
+    // исходном порядке пикселей, чтобы результат не зависел от
+    // числа потоков
+    int wave_tasks = scheduler_workers(scheduler) * 2;
+    int32_t wave_rows = wave_tasks * CRYSTAL_TASK_ROWS;
+    if (wave_rows > abs_height) {
+        wave_rows = abs_height;
+    }
+
     // Выделяем память для ячеек
-    CrystalCell* cells = (CrystalCell*)calloc(cells_x * cells_y, sizeof(CrystalCell));
-    if (!cells) {
-        bmp_free(result);
-        return NULL;
+    CrystalCell* cells = (CrystalCell*)scratch_calloc(
+        cells_x * cells_y,
+        sizeof(CrystalCell)
+    );
+    int* nearest = (int*)scratch_alloc(
+        (size_t)wave_rows * width * sizeof(int)
+    );
+    if (!cells || !nearest) {
+        scratch_free(nearest);
+        scratch_free(cells);
+        return 1;
     }
 
-    // Инициализируем центры ячеек с небольшими случайными смещениями
+    // Инициализируем центры ячеек с небольшими случайными
+    // смещениями
     for (int cy = 0; cy < cells_y; cy++) {
         for (int cx = 0; cx < cells_x; cx++) {
             int idx = cy * cells_x + cx;
             float base_x = cx * cell_size;
             float base_y = cy * cell_size;
-            
-            // Добавляем случайное смещение для более естественного вида
-            float offset_x = (pseudo_random(cx * 1000 + cy) - 0.5f) * cell_size * 0.3f;
-            float offset_y = (pseudo_random(cy * 1000 + cx) - 0.5f) * cell_size * 0.3f;
-            
+
+            // Добавляем случайное смещение для более естественного
+            // вида
+            float offset_x = (pseudo_random(cx * 1000 + cy) - 0.5f) *
+                cell_size * 0.3f;
+            float offset_y = (pseudo_random(cy * 1000 + cx) - 0.5f) *
+                cell_size * 0.3f;
+
             cells[idx].center_x = base_x + offset_x;
             cells[idx].center_y = base_y + offset_y;
             cells[idx].sum_r = 0;
@@ -496,33 +615,36 @@ BMPImage* filter_crystallize(BMPImage* image, float center_x, float center_y, fl
         }
     }
 
+    CrystalJob job = { image,      result, cells, cells_x,
+                       cells_y,    cell_size,     width,
+                       abs_height, 0,      nearest };
+
     // Первый проход: собираем цвета пикселей для каждой ячейки
-    for (int y = 0; y < abs_height; y++) {
-        for (int x = 0; x < width; x++) {
-            // Находим ближайший центр ячейки
-            float min_dist = 1e10f;
-            int nearest_idx = 0;
-            
-            for (int cy = 0; cy < cells_y; cy++) {
-                for (int cx = 0; cx < cells_x; cx++) {
-                    int idx = cy * cells_x + cx;
-                    float dx = x - cells[idx].center_x;
-                    float dy = y - cells[idx].center_y;
-                    float dist = dx * dx + dy * dy;
-                    
-                    if (dist < min_dist) {
-                        min_dist = dist;
-                        nearest_idx = idx;
-                    }
-                }
+    for (int32_t first = 0; first < abs_height;
+         first += wave_rows) {
+        int32_t rows = abs_height - first < wave_rows
+            ? abs_height - first
+            : wave_rows;
+
+        job.first_row = first;
+        scheduler_parallel_for(
+            scheduler,
+            (rows + CRYSTAL_TASK_ROWS - 1) / CRYSTAL_TASK_ROWS,
+            crystal_find_task,
+            &job
+        );
+
+        for (int32_t y = first; y < first + rows; y++) {
+            const int* row =
+                nearest + (size_t)(y - first) * width;
+            for (int32_t x = 0; x < width; x++) {
+                // Добавляем цвет пикселя к ячейке
+                RGBPixel pixel = bmp_get_pixel(image, x, y);
+                cells[row[x]].sum_r += pixel.red;
+                cells[row[x]].sum_g += pixel.green;
+                cells[row[x]].sum_b += pixel.blue;
+                cells[row[x]].count++;
             }
-            
-            // Добавляем цвет пикселя к ячейке
-            RGBPixel pixel = bmp_get_pixel(image, x, y);
-            cells[nearest_idx].sum_r += pixel.red;
-            cells[nearest_idx].sum_g += pixel.green;
-            cells[nearest_idx].sum_b += pixel.blue;
-            cells[nearest_idx].count++;
         }
     }
 
@@ -536,47 +658,319 @@ BMPImage* filter_crystallize(BMPImage* image, float center_x, float center_y, fl
     }
 
     // Второй проход: заполняем результат средними цветами ячеек
-    for (int y = 0; y < abs_height; y++) {
-        for (int x = 0; x < width; x++) {
-            // Находим ближайший центр ячейки
-            float min_dist = 1e10f;
-            int nearest_idx = 0;
-            
-            for (int cy = 0; cy < cells_y; cy++) {
-                for (int cx = 0; cx < cells_x; cx++) {
-                    int idx = cy * cells_x + cx;
-                    float dx = x - cells[idx].center_x;
-                    float dy = y - cells[idx].center_y;
-                    float dist = dx * dx + dy * dy;
-                    
-                    if (dist < min_dist) {
-                        min_dist = dist;
-                        nearest_idx = idx;
-                    }
-                }
-            }
-            
-            // Используем средний цвет ячейки
-            uint8_t r = (uint8_t)cells[nearest_idx].sum_r;
-            uint8_t g = (uint8_t)cells[nearest_idx].sum_g;
-            uint8_t b = (uint8_t)cells[nearest_idx].sum_b;
-            
-            bmp_set_pixel(result, x, y, r, g, b);
-        }
+    scheduler_parallel_for(
+        scheduler,
+        (abs_height + CRYSTAL_TASK_ROWS - 1) / CRYSTAL_TASK_ROWS,
+        crystal_fill_task,
+        &job
+    );
+
+    scratch_free(nearest);
+    scratch_free(cells);
+    return 0;
+}
+
+// Память кристаллизации сверх приёмника: ячейки и ближайшие
+// ячейки пикселей одной волны
+uint64_t filter_crystallize_workspace(
+    int32_t width,
+    int32_t height,
+    float radius,
+    int workers
+) {
+    int cell_size = (int)(radius * 2.0f);
+    if (cell_size < 2) cell_size = 2;
+
+    uint64_t cells_x = (width + cell_size - 1) / cell_size + 1;
+    uint64_t cells_y = (height + cell_size - 1) / cell_size + 1;
+
+    int32_t wave_rows = workers * 2 * CRYSTAL_TASK_ROWS;
+    if (wave_rows > height) {
+        wave_rows = height;
     }
 
-    free(cells);
-    return result;
+    return cells_x * cells_y * sizeof(CrystalCell) +
+           (uint64_t)wave_rows * width * sizeof(int);
 }
 
 // ==================== ОСНОВНАЯ ФУНКЦИЯ ПРИМЕНЕНИЯ ФИЛЬТРОВ
 // ====================
 
 int apply_filters(BMPImage** image, Filter* filter_list) {
+    return apply_filters_window(image, filter_list, NULL, NULL);
+}
+
+// Выделение второго буфера по размеру текущего изображения. В
+// нескольких потоках буфер впервые затрагивают полосами те
+// потоки, которые потом пишут в эти полосы тайлы
+static BMPImage*
+create_scratch(const BMPImage* source, Scheduler* scheduler) {
+    int32_t width = source->info_header.width;
+    int32_t height = abs(source->info_header.height);
+    if (scheduler_workers(scheduler) == 1) {
+        return bmp_create(width, height);
+    }
+
+    BMPImage* scratch = bmp_create_uninitialized(width, height);
+    if (scratch) {
+        tiles_first_touch(scratch, scheduler);
+    }
+    return scratch;
+}
+
+// Выполнение отрезка цепочки по тайлам с записью в scratch.
+// Возвращает 0 при успехе, иначе номер стадии отрезка (с 1),
+// на которой произошла ошибка
+static int apply_tiled_segment(
+    BMPImage* source,
+    BMPImage* scratch,
+    Filter* start,
+    int length,
+    RoiWindow* window,
+    Scheduler* scheduler,
+    int tile_size
+) {
+    TileStage* stages =
+        (TileStage*)scratch_alloc(length * sizeof(TileStage));
+    if (!stages) {
+        return 1;
+    }
+
+    // Обрезки переводятся в координаты буфера заранее, как это
+    // делается при обычном выполнении
+    int32_t buffer_width = source->info_header.width;
+    int32_t buffer_height = abs(source->info_header.height);
+    Filter* current = start;
+
+    for (int k = 0; k < length; k++, current = current->next) {
+        stages[k].filter = current;
+        stages[k].descriptor = filter_registry_get(current->type);
+
+        if (!stages[k].descriptor->resizes) {
+            continue;
+        }
+
+        BMPRegion region;
+        if (stages[k].descriptor->output_region(
+                current,
+                window->frame_width,
+                window->frame_height,
+                &region
+            ) != 0 ||
+            roi_crop_window(
+                window,
+                buffer_width,
+                buffer_height,
+                &region,
+                &stages[k].crop
+            ) != 0) {
+            scratch_free(stages);
+            return k + 1;
+        }
+
+        buffer_width = stages[k].crop.width;
+        buffer_height = stages[k].crop.height;
+    }
+
+    int error = tiles_apply(
+        source,
+        stages,
+        length,
+        tile_size,
+        scheduler,
+        scratch
+    );
+    scratch_free(stages);
+
+    return error ? length : 0;
+}
+
+// Название стадии профиля: фильтры отрезка с параметрами,
+// например "-blur 1.5 | -med 3"
+static void profile_stage_name(
+    char* name,
+    size_t size,
+    const Filter* start,
+    int length
+) {
+    size_t used = 0;
+    name[0] = '\0';
+
+    for (int k = 0; k < length && used < size; k++) {
+        const FilterDescriptor* descriptor =
+            filter_registry_get(start->type);
+        used += snprintf(
+            name + used,
+            size - used,
+            "%s%s",
+            k ? " | " : "",
+            descriptor ? descriptor->name : "?"
+        );
+
+        for (int p = 0; descriptor && p < descriptor->param_count &&
+             used < size;
+             p++) {
+            if (descriptor->params[p].type == FILTER_PARAM_FIXED) {
+                used += snprintf(
+                    name + used,
+                    size - used,
+                    " %g",
+                    start->params[p] / (double)FILTER_FIXED_SCALE
+                );
+            } else {
+                used += snprintf(
+                    name + used,
+                    size - used,
+                    " %d",
+                    start->params[p]
+                );
+            }
+        }
+        start = start->next;
+    }
+}
+
+// Завершение замера стадии из length фильтров, начиная со start
+static void profile_stage_end(
+    Profile* profile,
+    const Filter* start,
+    int length,
+    int tiled,
+    const BMPImage* source
+) {
+    char name[PROFILE_NAME_SIZE];
+    profile_stage_name(name, sizeof(name), start, length);
+    if (tiled) {
+        size_t used = strlen(name);
+        snprintf(name + used, sizeof(name) - used, " (тайлы)");
+    }
+
+    profile_end(
+        profile,
+        name,
+        (int64_t)source->info_header.width *
+            abs(source->info_header.height)
+    );
+}
+
+// Ключи всех префиксов цепочки для буфера image в окне window:
+// ключ k описывает результат первых k + 1 фильтров. Возвращает
+// массив ключей (освобождается free) или NULL
+static CacheKey* prefix_keys(
+    const BMPImage* image,
+    const RoiWindow* window,
+    const Filter* filter_list,
+    int* length
+) {
+    int count = 0;
+    for (const Filter* f = filter_list; f; f = f->next) {
+        count++;
+    }
+
+    CacheKey* keys =
+        (CacheKey*)scratch_alloc(count * sizeof(CacheKey));
+    if (!keys) {
+        return NULL;
+    }
+
+    int32_t width = image->info_header.width;
+    int32_t height = abs(image->info_header.height);
+
+    CacheHasher hasher;
+    cache_hasher_init(&hasher);
+    cache_hasher_update(&hasher, "stage", 5);
+    cache_hasher_int(&hasher, IC_CACHE_VERSION);
+    cache_hasher_int(&hasher, window->x);
+    cache_hasher_int(&hasher, window->y);
+    cache_hasher_int(&hasher, window->frame_width);
+    cache_hasher_int(&hasher, window->frame_height);
+    cache_hasher_int(&hasher, width);
+    cache_hasher_int(&hasher, image->info_header.height);
+    cache_hasher_headers(
+        &hasher,
+        &image->file_header,
+        &image->info_header
+    );
+    for (int32_t y = 0; y < height; y++) {
+        cache_hasher_update(
+            &hasher,
+            image->pixels[y],
+            (size_t)width * sizeof(RGBPixel)
+        );
+    }
+
+    // Ключи префиксов получаются продолжением одного хеша
+    int k = 0;
+    for (const Filter* f = filter_list; f; f = f->next, k++) {
+        cache_hasher_filter(&hasher, f);
+        cache_hasher_key(&hasher, &keys[k]);
+        keys[k].pixels = (int64_t)width * height;
+    }
+
+    *length = count;
+    return keys;
+}
+
+// Восстановление результата самого длинного префикса из кэша.
+// Прежнее изображение становится вторым буфером. Возвращает
+// число пропущенных фильтров
+static int resume_from_cache(
+    StageCache* stages,
+    const CacheKey* keys,
+    int length,
+    BMPImage** image,
+    RoiWindow* window,
+    BMPImage** scratch
+) {
+    for (int k = length; k > 0; k--) {
+        RoiWindow restored_window;
+        BMPImage* restored = stage_cache_lookup(
+            stages,
+            &keys[k - 1],
+            &restored_window
+        );
+        if (!restored) {
+            continue;
+        }
+
+        // Следующие стадии не больше восстановленной, поэтому
+        // прежний буфер годится в приёмники
+        BMPImage* source = *image;
+        *scratch = source->parent ? bmp_detach_view(source) : source;
+        *image = restored;
+        *window = restored_window;
+        return k;
+    }
+    return 0;
+}
+
+int apply_filters_window(
+    BMPImage** image,
+    Filter* filter_list,
+    RoiWindow* window,
+    const Execution* execution
+) {
     if (!image || !*image) {
         return 0;
     }
 
+    Scheduler* scheduler = execution ? execution->scheduler : NULL;
+    int parallel = scheduler_workers(scheduler) > 1;
+    int quiet = execution && execution->quiet;
+    Profile* profile = execution ? execution->profile : NULL;
+    int tile_size = execution && execution->tile_size > 0
+        ? execution->tile_size
+        : IC_TILE_SIZE;
+
+    // Без окна буфер совпадает с полным кадром
+    RoiWindow full_window = { 0,
+                              0,
+                              (*image)->info_header.width,
+                              abs((*image)->info_header.height) };
+    if (!window) {
+        window = &full_window;
+    }
+
     if (!filter_list) {
         return 0; // Список фильтров пустой
     }
@@ -584,154 +978,273 @@ int apply_filters(BMPImage** image, Filter* filter_list) {
     Filter* current = filter_list;
     int count = 0;
 
-    while (current) {
-        count++;
+    // Второй буфер для попеременной записи (ping-pong). Фильтры
+    // лишь сохраняют или уменьшают размер изображения, поэтому
+    // буфера размером с текущее изображение хватает на все
+    // последующие стадии
+    BMPImage* scratch = NULL;
+
+    // С кэшем стадий выполнение продолжается после самого
+    // длинного уже посчитанного префикса цепочки
+    StageCache* stages = execution ? execution->stages : NULL;
+    CacheKey* keys = NULL;
+    if (stages) {
+        int64_t start = trace_begin();
+        if (profile) {
+            profile_begin(profile);
+        }
 
-        switch (current->type) {
-            case ARGV_TYPE_FILTER_CROP: {
-                int width = current->params[0];
-                int height = current->params[1];
-                BMPImage* cropped =
-                    filter_crop(*image, width, height);
+        int length = 0;
+        keys = prefix_keys(*image, window, filter_list, &length);
+        int resumed = keys ? resume_from_cache(
+                                 stages,
+                                 keys,
+                                 length,
+                                 image,
+                                 window,
+                                 &scratch
+                             )
+                           : 0;
+
+        if (profile) {
+            profile_end(
+                profile,
+                "stage cache",
+                keys ? keys->pixels : 0
+            );
+        }
+        trace_end("stage cache", start, resumed);
 
-                if (!cropped) {
-                    fprintf(
-                        stderr,
-                        "[Error] Не удалось применить "
-                        "фильтр " IC_ARGV_FILTER_CROP "\n"
-                    );
-                    return -count;
-                }
+        for (; count < resumed; count++) {
+            current = current->next;
+        }
+        if (resumed == 1 && !quiet) {
+            printf("[Info] Фильтр #1 взят из кэша стадий\n");
+        } else if (resumed > 1 && !quiet) {
+            printf(
+                "[Info] Фильтры #1-#%d взяты из кэша стадий\n",
+                resumed
+            );
+        }
+    }
 
-                bmp_free(*image);
-                *image = cropped;
-                break;
+    while (current) {
+        // Несколько фильтров подряд выполняются по тайлам, без
+        // промежуточных изображений целиком
+        int length = tiles_segment_length(current, parallel);
+
+        // Результат каждой стадии нужен кэшу целиком, поэтому
+        // стадии не сливаются; тайлы остаются единицами работы
+        // для потоков
+        if (keys && length > 0) {
+            length = parallel ? 1 : 0;
+        }
+        if (length > 0) {
+            BMPImage* source = *image;
+            int64_t start = trace_begin();
+            if (profile) {
+                profile_begin(profile);
             }
 
-            case ARGV_TYPE_FILTER_GS: {
-                if (filter_grayscale(*image) != 0) {
+            if (!scratch &&
+                !(scratch = create_scratch(source, scheduler))) {
+                if (!quiet) {
                     fprintf(
                         stderr,
-                        "[Error] Не удалось применить "
-                        "фильтр " IC_ARGV_FILTER_GS " \n"
+                        "[Error] Не удалось выделить буфер для "
+                        "фильтра #%d\n",
+                        count + 1
                     );
-                    return -count;
                 }
-                break;
+                scratch_free(keys);
+                return -(count + 1);
             }
 
-            case ARGV_TYPE_FILTER_NEG: {
-                if (filter_negative(*image) != 0) {
+            int failed = apply_tiled_segment(
+                source,
+                scratch,
+                current,
+                length,
+                window,
+                scheduler,
+                tile_size
+            );
+            if (failed) {
+                if (!quiet) {
                     fprintf(
                         stderr,
-                        "[Error] Не удалось применить "
-                        "фильтр " IC_ARGV_FILTER_NEG "\n"
+                        "[Error] Не удалось применить фильтры "
+                        "#%d-#%d\n",
+                        count + 1,
+                        count + length
                     );
-                    return -count;
                 }
-                break;
+                bmp_free(scratch);
+                scratch_free(keys);
+                return -(count + failed);
             }
 
-            case ARGV_TYPE_FILTER_SHARP: {
-                if (filter_sharpening(*image) != 0) {
-                    fprintf(
-                        stderr,
-                        "[Error] Не удалось применить "
-                        "фильтр " IC_ARGV_FILTER_SHARP "\n"
-                    );
-                    return -count;
-                }
-                break;
+            if (profile) {
+                profile_stage_end(
+                    profile,
+                    current,
+                    length,
+                    1,
+                    source
+                );
             }
+            trace_end("tiles", start, count + 1);
 
-            case ARGV_TYPE_FILTER_EDGE: {
-                float threshold = current->params[0] / 1000.0f;
-                BMPImage* edges =
-                    filter_edge_detection(*image, threshold);
+            *image = scratch;
+            scratch = source->parent ? bmp_detach_view(source)
+                                     : source;
 
-                if (!edges) {
-                    fprintf(
-                        stderr,
-                        "[Error] Не удалось применить "
-                        "фильтр " IC_ARGV_FILTER_EDGE "\n"
-                    );
-                    return -count;
+            for (int k = 0; k < length; k++) {
+                count++;
+                if (!quiet) {
+                    printf("[Info] Применен фильтр #%d\n", count);
                 }
-
-                bmp_free(*image);
-                *image = edges;
-                break;
+                current = current->next;
+            }
+            if (keys) {
+                stage_cache_store(
+                    stages,
+                    &keys[count - 1],
+                    *image,
+                    window
+                );
             }
+            continue;
+        }
 
-            case ARGV_TYPE_FILTER_BLUR: {
-                float sigma = current->params[0] / 1000.0f;
-                BMPImage* blurred =
-                    filter_gaussian_blur(*image, sigma);
+        count++;
 
-                if (!blurred) {
-                    fprintf(
-                        stderr,
-                        "[Error] Не удалось применить "
-                        "фильтр " IC_ARGV_FILTER_BLUR "-blur\n"
-                    );
-                    return -count;
-                }
+        BMPImage* source = *image;
+        const FilterDescriptor* descriptor =
+            filter_registry_get(current->type);
 
-                bmp_free(*image);
-                *image = blurred;
-                break;
+        if (!descriptor) {
+            if (!quiet) {
+                fprintf(
+                    stderr,
+                    "[Error] Неизвестный тип фильтра: %d\n",
+                    current->type
+                );
             }
+            bmp_free(scratch);
+            scratch_free(keys);
+            return -count;
+        }
 
-            case ARGV_TYPE_FILTER_MED: {
-                int window = current->params[0];
-                BMPImage* median = filter_median(*image, window);
+        int in_place = descriptor->in_place;
+        int64_t start = trace_begin();
+        if (profile) {
+            profile_begin(profile);
+        }
 
-                if (!median) {
+        if (!in_place && !scratch) {
+            scratch = create_scratch(source, scheduler);
+            if (!scratch) {
+                if (!quiet) {
                     fprintf(
                         stderr,
-                        "[Error] Не удалось применить "
-                        "фильтр " IC_ARGV_FILTER_MED "\n"
+                        "[Error] Не удалось выделить буфер для "
+                        "фильтра #%d\n",
+                        count
                     );
-                    return -count;
                 }
-
-                bmp_free(*image);
-                *image = median;
-                break;
+                scratch_free(keys);
+                return -count;
             }
+        }
 
-            case ARGV_TYPE_FILTER_CRYSTAL: {
-                float center_x = current->params[0] / 1000.0f;
-                float center_y = current->params[1] / 1000.0f;
-                float radius = current->params[2] / 1000.0f;
-                BMPImage* crystallized = filter_crystallize(*image, center_x, center_y, radius);
-
-                if (!crystallized) {
-                    fprintf(
-                        stderr,
-                        "[Error] Не удалось применить "
-                        "фильтр " IC_ARGV_FILTER_CRYSTAL "\n"
-                    );
-                    return -count;
-                }
+        int error = 0;
+
+        if (descriptor->resizes) {
+            // Результат - представление области входа
+            BMPRegion region;
+            BMPRegion view;
+            BMPImage* cropped = NULL;
+
+            if (descriptor->output_region(
+                    current,
+                    window->frame_width,
+                    window->frame_height,
+                    &region
+                ) == 0 &&
+                roi_crop_window(
+                    window,
+                    source->info_header.width,
+                    abs(source->info_header.height),
+                    &region,
+                    &view
+                ) == 0) {
+                cropped = filter_crop(
+                    source,
+                    view.x,
+                    view.y,
+                    view.width,
+                    view.height
+                );
+            }
 
-                bmp_free(*image);
-                *image = crystallized;
-                break;
+            error = !cropped;
+            if (cropped) {
+                *image = cropped;
             }
+        } else if (in_place) {
+            error = descriptor->apply_in_place(source, current);
+        } else {
+            error = descriptor->apply(
+                source,
+                scratch,
+                current,
+                scheduler
+            );
+        }
 
-            default:
+        if (error) {
+            if (!quiet) {
                 fprintf(
                     stderr,
-                    "[Error] Неизвестный тип фильтра: %d\n",
-                    current->type
+                    "[Error] Не удалось применить фильтр %s\n",
+                    descriptor->name
                 );
-                return -count;
+            }
+            bmp_free(scratch);
+            scratch_free(keys);
+            return -count;
+        }
+
+        if (profile) {
+            profile_stage_end(profile, current, 1, 0, source);
+        }
+        trace_end(descriptor->name, start, count);
+
+        // Результат оказался в приёмнике: меняем буферы ролями.
+        // Представление после обрезки в приёмники не годится,
+        // поэтому в роли буфера используется его владелец
+        if (!in_place) {
+            *image = scratch;
+            scratch = source->parent ? bmp_detach_view(source)
+                                     : source;
         }
 
-        printf("[Info] Применен фильтр #%d\n", count);
+        if (!quiet) {
+            printf("[Info] Применен фильтр #%d\n", count);
+        }
+        if (keys) {
+            stage_cache_store(
+                stages,
+                &keys[count - 1],
+                *image,
+                window
+            );
+        }
         current = current->next;
     }
 
+    bmp_free(scratch);
+    scratch_free(keys);
     return count;
 }
@@ -0,0 +1,137 @@
+#include <string.h>
+
+#include "hash.h"
+
+#define PRIME1 0x9E3779B185EBCA87ULL
+#define PRIME2 0xC2B2AE3D27D4EB4FULL
+#define PRIME3 0x165667B19E3779F9ULL
+#define PRIME4 0x85EBCA77C2B2AE63ULL
+#define PRIME5 0x27D4EB2F165667C5ULL
+
+static uint64_t rotl(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// Чтение в порядке little-endian, независимо от платформы
+static uint64_t read64(const uint8_t* p) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+static uint32_t read32(const uint8_t* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 |
+           (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint64_t round64(uint64_t lane, uint64_t input) {
+    lane += input * PRIME2;
+    lane = rotl(lane, 31);
+    return lane * PRIME1;
+}
+
+static uint64_t merge_round(uint64_t acc, uint64_t lane) {
+    acc ^= round64(0, lane);
+    return acc * PRIME1 + PRIME4;
+}
+
+// Обработка полного 32-байтного блока
+static void consume(uint64_t lanes[4], const uint8_t* block) {
+    lanes[0] = round64(lanes[0], read64(block));
+    lanes[1] = round64(lanes[1], read64(block + 8));
+    lanes[2] = round64(lanes[2], read64(block + 16));
+    lanes[3] = round64(lanes[3], read64(block + 24));
+}
+
+void hash64_init(Hash64* state, uint64_t seed) {
+    memset(state, 0, sizeof(*state));
+    state->seed = seed;
+    state->lanes[0] = seed + PRIME1 + PRIME2;
+    state->lanes[1] = seed + PRIME2;
+    state->lanes[2] = seed;
+    state->lanes[3] = seed - PRIME1;
+}
+
+void hash64_update(
+    Hash64* state,
+    const void* data,
+    size_t size
+) {
+    const uint8_t* p = (const uint8_t*)data;
+    state->total_length += size;
+
+    // Дополняем начатый блок
+    if (state->buffered) {
+        size_t take = 32 - state->buffered;
+        if (take > size) {
+            take = size;
+        }
+        memcpy(state->buffer + state->buffered, p, take);
+        state->buffered += (uint32_t)take;
+        p += take;
+        size -= take;
+
+        if (state->buffered < 32) {
+            return;
+        }
+        consume(state->lanes, state->buffer);
+        state->buffered = 0;
+    }
+
+    for (; size >= 32; p += 32, size -= 32) {
+        consume(state->lanes, p);
+    }
+
+    memcpy(state->buffer, p, size);
+    state->buffered = (uint32_t)size;
+}
+
+uint64_t hash64_digest(const Hash64* state) {
+    uint64_t acc;
+    if (state->total_length >= 32) {
+        const uint64_t* lanes = state->lanes;
+        acc = rotl(lanes[0], 1) + rotl(lanes[1], 7) +
+              rotl(lanes[2], 12) + rotl(lanes[3], 18);
+        for (int i = 0; i < 4; i++) {
+            acc = merge_round(acc, lanes[i]);
+        }
+    } else {
+        acc = state->seed + PRIME5;
+    }
+    acc += state->total_length;
+
+    // Хвост: по 8, 4 и 1 байту
+    const uint8_t* p = state->buffer;
+    uint32_t left = state->buffered;
+    for (; left >= 8; p += 8, left -= 8) {
+        acc ^= round64(0, read64(p));
+        acc = rotl(acc, 27) * PRIME1 + PRIME4;
+    }
+    if (left >= 4) {
+        acc ^= (uint64_t)read32(p) * PRIME1;
+        acc = rotl(acc, 23) * PRIME2 + PRIME3;
+        p += 4;
+        left -= 4;
+    }
+    for (; left > 0; p++, left--) {
+        acc ^= *p * PRIME5;
+        acc = rotl(acc, 11) * PRIME1;
+    }
+
+    // Перемешивание итогового значения
+    acc ^= acc >> 33;
+    acc *= PRIME2;
+    acc ^= acc >> 29;
+    acc *= PRIME3;
+    acc ^= acc >> 32;
+    return acc;
+}
+
+uint64_t hash64(const void* data, size_t size, uint64_t seed) {
+    Hash64 state;
+    hash64_init(&state, seed);
+    hash64_update(&state, data, size);
+    return hash64_digest(&state);
+}
@@ -1,6 +1,5 @@
 #include "core.h"
 
 int main(int argc, char** argv) {
-    imagecraft(argc, argv);
-    return 0;
+    return imagecraft(argc, argv);
 }
@@ -0,0 +1,139 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "args_assistant.h"
+#include "libimagecraft.h"
+#include "paths.h"
+#include "roi.h"
+
+// Максимальное число слов в цепочке фильтров
+#define CHAIN_MAX_WORDS 256
+
+// Параметры выполнения без вывода сообщений
+static Execution quiet_execution(const Execution* execution) {
+    Execution quiet = { NULL, 1, NULL, NULL, 0 };
+    if (execution) {
+        quiet = *execution;
+        quiet.quiet = 1;
+    }
+    return quiet;
+}
+
+int imagecraft_parse_chain(const char* text, Filter** chain) {
+    if (!text || !chain) {
+        return IC_ERROR_INVALID_ARGUMENT;
+    }
+    *chain = NULL;
+
+    // Разбиение на слова в собственной копии строки
+    char* copy = ic_strdup(text);
+    char** words = (char**)malloc(CHAIN_MAX_WORDS * sizeof(char*));
+    if (!copy || !words) {
+        free(copy);
+        free(words);
+        return IC_BMP_ERROR_ALLOCATING_BUFFER;
+    }
+
+    int count = 0;
+    char* p = copy;
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == '\n') {
+            *p++ = '\0';
+        }
+        if (!*p) {
+            break;
+        }
+        if (count == CHAIN_MAX_WORDS) {
+            free(copy);
+            free(words);
+            return IC_ERROR_INVALID_CHAIN;
+        }
+
+        words[count++] = p;
+        while (*p && *p != ' ' && *p != '\t' && *p != '\n') {
+            p++;
+        }
+    }
+
+    int result = parse_filter_chain(count, words, chain);
+    free(copy);
+    free(words);
+
+    return result == IC_ARGS_ASSISTANT_OK ? ALL_OK
+                                          : IC_ERROR_INVALID_CHAIN;
+}
+
+void imagecraft_free_chain(Filter* chain) {
+    free_filter_list(chain);
+}
+
+int imagecraft_apply(
+    BMPImage** image,
+    Filter* chain,
+    const Execution* execution
+) {
+    if (!image || !*image) {
+        return IC_ERROR_INVALID_ARGUMENT;
+    }
+
+    Execution quiet = quiet_execution(execution);
+    return apply_filters_window(image, chain, NULL, &quiet) < 0
+        ? IC_ERROR_FILTER_FAILURE
+        : ALL_OK;
+}
+
+int imagecraft_process_memory(
+    const uint8_t* input,
+    size_t input_size,
+    Filter* chain,
+    const Execution* execution,
+    uint8_t** output,
+    size_t* output_size
+) {
+    if (!input || !output || !output_size) {
+        return IC_ERROR_INVALID_ARGUMENT;
+    }
+
+    BMPImage* image = bmp_decode(input, input_size);
+    if (!image) {
+        return IC_ERROR_DECODING;
+    }
+
+    int result = imagecraft_apply(&image, chain, execution);
+    if (result == ALL_OK) {
+        result = bmp_encode(image, output, output_size);
+    }
+
+    bmp_free(image);
+    return result;
+}
+
+int imagecraft_process_file(
+    const char* input,
+    const char* output,
+    Filter* chain,
+    const Execution* execution
+) {
+    if (!input || !output) {
+        return IC_ERROR_INVALID_ARGUMENT;
+    }
+
+    BMPRegion region;
+    RoiWindow window;
+    BMPImage* image =
+        roi_load(input, chain, &window, &region, NULL);
+    if (!image) {
+        return IC_ERROR_DECODING;
+    }
+
+    Execution quiet = quiet_execution(execution);
+    int result = ALL_OK;
+    if (apply_filters_window(&image, chain, &window, &quiet) < 0) {
+        result = IC_ERROR_FILTER_FAILURE;
+    } else {
+        result = bmp_save(image, output);
+    }
+
+    bmp_free(image);
+    return result;
+}
@@ -62,19 +62,23 @@ int create_output_directory_recursive(const char* path) {
     return 0;
 }
 
-// Функция для извлечения директории из пути к файлу
-// Возвращает NULL, если путь не содержит директории
-char* get_directory_from_path(const char* filepath) {
-    static char dir[1024];
+// Функция для извлечения директории из пути к файлу в буфер
+// dir размером size. Возвращает NULL, если путь не содержит
+// директории
+char* get_directory_from_path(
+    const char* filepath,
+    char* dir,
+    size_t size
+) {
     char* last_slash;
 
-    if (!filepath) {
+    if (!filepath || !dir || size == 0) {
         return NULL;
     }
 
     // Копируем путь
-    strncpy(dir, filepath, sizeof(dir) - 1);
-    dir[sizeof(dir) - 1] = '\0';
+    strncpy(dir, filepath, size - 1);
+    dir[size - 1] = '\0';
 
     // Ищем последний разделитель
     last_slash = strrchr(dir, '/');
@@ -0,0 +1,188 @@
+#define _DEFAULT_SOURCE
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "pool.h"
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+// Наименьший класс и выравнивание малых блоков
+#define POOL_MIN_BLOCK 64
+
+// Блоки от этого размера отображаются в память напрямую
+#define POOL_MAP_THRESHOLD ((size_t)128 * 1024)
+
+// Наибольшее число удерживаемых блоков
+#define POOL_MAX_BLOCKS 64
+
+typedef struct {
+    void* block;
+    size_t size;
+} PoolBlock;
+
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static PoolBlock pool_blocks[POOL_MAX_BLOCKS];
+static int pool_count = 0;
+static size_t pool_retained = 0;
+static size_t pool_limit =
+    (size_t)IC_POOL_LIMIT_MB * 1024 * 1024;
+
+size_t pool_block_size(size_t bytes) {
+    if (bytes >= IC_POOL_HUGE_PAGE) {
+        return (bytes + IC_POOL_HUGE_PAGE - 1) /
+               IC_POOL_HUGE_PAGE * IC_POOL_HUGE_PAGE;
+    }
+
+    size_t size = POOL_MIN_BLOCK;
+    while (size < bytes) {
+        size *= 2;
+    }
+    return size;
+}
+
+static void* system_alloc(size_t size) {
+#ifdef _WIN32
+    size_t alignment = size >= IC_POOL_HUGE_PAGE
+        ? IC_POOL_HUGE_PAGE
+        : POOL_MIN_BLOCK;
+    return _aligned_malloc(size, alignment);
+#else
+    if (size < POOL_MAP_THRESHOLD) {
+        void* block = NULL;
+        if (posix_memalign(&block, POOL_MIN_BLOCK, size) != 0) {
+            return NULL;
+        }
+        return block;
+    }
+
+    // Большие блоки отображаются напрямую: возвращенные
+    // системе, они не дробят кучу. Для выравнивания по большой
+    // странице отображение берется с запасом, лишнее снимается
+    size_t alignment =
+        size >= IC_POOL_HUGE_PAGE ? IC_POOL_HUGE_PAGE : 0;
+    uint8_t* mapped = (uint8_t*)mmap(
+        NULL,
+        size + alignment,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS,
+        -1,
+        0
+    );
+    if (mapped == MAP_FAILED) {
+        return NULL;
+    }
+    if (!alignment) {
+        return mapped;
+    }
+
+    size_t head = (alignment - (uintptr_t)mapped % alignment) %
+                  alignment;
+    if (head) {
+        munmap(mapped, head);
+    }
+    if (alignment - head) {
+        munmap(mapped + head + size, alignment - head);
+    }
+#ifdef MADV_HUGEPAGE
+    // Выровненный блок целиком покрывается большими страницами,
+    // если ядро их допускает
+    madvise(mapped + head, size, MADV_HUGEPAGE);
+#endif
+    return mapped + head;
+#endif
+}
+
+static void system_free(void* block, size_t size) {
+    if (!block) {
+        return;
+    }
+#ifdef _WIN32
+    (void)size;
+    _aligned_free(block);
+#else
+    if (size < POOL_MAP_THRESHOLD) {
+        free(block);
+    } else {
+        munmap(block, size);
+    }
+#endif
+}
+
+void* pool_acquire(size_t bytes) {
+    size_t size = pool_block_size(bytes);
+
+    // Последний возвращенный блок скорее всего еще в кэше
+    pthread_mutex_lock(&pool_mutex);
+    for (int i = pool_count - 1; i >= 0; i--) {
+        if (pool_blocks[i].size == size) {
+            void* block = pool_blocks[i].block;
+            pool_count--;
+            for (int j = i; j < pool_count; j++) {
+                pool_blocks[j] = pool_blocks[j + 1];
+            }
+            pool_retained -= size;
+            pthread_mutex_unlock(&pool_mutex);
+            return block;
+        }
+    }
+    pthread_mutex_unlock(&pool_mutex);
+
+    return system_alloc(size);
+}
+
+void pool_release(void* block, size_t bytes) {
+    if (!block) {
+        return;
+    }
+
+    size_t size = pool_block_size(bytes);
+    pthread_mutex_lock(&pool_mutex);
+    if (pool_count < POOL_MAX_BLOCKS &&
+        pool_retained + size <= pool_limit) {
+        pool_blocks[pool_count].block = block;
+        pool_blocks[pool_count].size = size;
+        pool_count++;
+        pool_retained += size;
+        block = NULL;
+    }
+    pthread_mutex_unlock(&pool_mutex);
+
+    system_free(block, size);
+}
+
+// Возврат системе давно не использованных блоков сверх
+// предела. Вызывается под pool_mutex
+static void shrink_locked(void) {
+    while (pool_count > 0 && pool_retained > pool_limit) {
+        PoolBlock* oldest = &pool_blocks[0];
+        system_free(oldest->block, oldest->size);
+        pool_retained -= oldest->size;
+        pool_count--;
+        for (int i = 0; i < pool_count; i++) {
+            pool_blocks[i] = pool_blocks[i + 1];
+        }
+    }
+}
+
+void pool_set_limit(size_t bytes) {
+    pthread_mutex_lock(&pool_mutex);
+    pool_limit = bytes;
+    shrink_locked();
+    pthread_mutex_unlock(&pool_mutex);
+}
+
+void pool_trim(void) {
+    pthread_mutex_lock(&pool_mutex);
+    for (int i = 0; i < pool_count; i++) {
+        system_free(pool_blocks[i].block, pool_blocks[i].size);
+    }
+    pool_count = 0;
+    pool_retained = 0;
+    pthread_mutex_unlock(&pool_mutex);
+}
@@ -0,0 +1,426 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "profile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <time.h>
+#endif
+
+#if defined(__GLIBC__) &&                                       \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#include <malloc.h>
+#define PROFILE_HAS_MALLINFO2
+#endif
+
+// Ширина столбца с названием стадии в таблице
+#define PROFILE_NAME_COLUMN 36
+
+// Время по часам в миллисекундах
+static double wall_clock_ms(void) {
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart * 1000.0 / frequency.QuadPart;
+#else
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+#endif
+}
+
+// Процессорное время всех потоков процесса в миллисекундах
+static double cpu_clock_ms(void) {
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(
+            GetCurrentProcess(),
+            &creation,
+            &exit,
+            &kernel,
+            &user
+        )) {
+        return 0.0;
+    }
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (k.QuadPart + u.QuadPart) / 10000.0; // По 100 нс
+#else
+    struct timespec time;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+    return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+#endif
+}
+
+// Занятая куча в байтах, включая блоки, выделенные через mmap
+static int64_t heap_in_use(void) {
+#ifdef PROFILE_HAS_MALLINFO2
+    struct mallinfo2 info = mallinfo2();
+    return (int64_t)(info.uordblks + info.hblkhd);
+#else
+    return PROFILE_UNKNOWN;
+#endif
+}
+
+// Пиковый RSS процесса в КБ
+int64_t profile_peak_rss_kb(void) {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!K32GetProcessMemoryInfo(
+            GetCurrentProcess(),
+            &counters,
+            sizeof(counters)
+        )) {
+        return PROFILE_UNKNOWN;
+    }
+    return (int64_t)(counters.PeakWorkingSetSize / 1024);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return PROFILE_UNKNOWN;
+    }
+#ifdef __APPLE__
+    return (int64_t)(usage.ru_maxrss / 1024); // В байтах
+#else
+    return (int64_t)usage.ru_maxrss;
+#endif
+#endif
+}
+
+void profile_init(Profile* profile) {
+    memset(profile, 0, sizeof(*profile));
+}
+
+void profile_free(Profile* profile) {
+    free(profile->stages);
+    profile_init(profile);
+}
+
+void profile_begin(Profile* profile) {
+    if (profile->hardware) {
+        counters_read(&profile->hardware_start);
+    }
+    profile->heap_start = heap_in_use();
+    profile->cpu_start = cpu_clock_ms();
+    profile->wall_start = wall_clock_ms();
+}
+
+int profile_end(
+    Profile* profile,
+    const char* name,
+    int64_t pixels
+) {
+    double wall = wall_clock_ms();
+    double cpu = cpu_clock_ms();
+    int64_t heap = heap_in_use();
+    CounterValues hardware;
+    if (profile->hardware) {
+        counters_read(&hardware);
+    }
+
+    if (profile->count == profile->capacity) {
+        int capacity =
+            profile->capacity ? profile->capacity * 2 : 8;
+        ProfileStage* stages = (ProfileStage*)realloc(
+            profile->stages,
+            capacity * sizeof(ProfileStage)
+        );
+        if (!stages) {
+            return 1;
+        }
+        profile->stages = stages;
+        profile->capacity = capacity;
+    }
+
+    ProfileStage* stage = &profile->stages[profile->count++];
+    snprintf(stage->name, sizeof(stage->name), "%s", name);
+    stage->wall_ms = wall - profile->wall_start;
+    stage->cpu_ms = cpu - profile->cpu_start;
+    stage->heap_bytes = heap == PROFILE_UNKNOWN ||
+            profile->heap_start == PROFILE_UNKNOWN
+        ? PROFILE_UNKNOWN
+        : heap - profile->heap_start;
+    stage->peak_rss_kb = profile_peak_rss_kb();
+    stage->pixels = pixels;
+
+    stage->has_hardware = profile->hardware;
+    if (profile->hardware) {
+        const CounterValues* start = &profile->hardware_start;
+        stage->hardware.cycles = hardware.cycles - start->cycles;
+        stage->hardware.instructions =
+            hardware.instructions - start->instructions;
+        stage->hardware.cache_misses =
+            hardware.cache_misses - start->cache_misses;
+        stage->hardware.branch_misses =
+            hardware.branch_misses - start->branch_misses;
+    }
+    return 0;
+}
+
+// Мегапикселей в секунду (0, если время не измерено)
+static double megapixels_per_second(int64_t pixels, double ms) {
+    return ms > 0.0 ? pixels / (ms * 1000.0) : 0.0;
+}
+
+// Длина строки UTF-8 в символах
+static int text_length(const char* text) {
+    int length = 0;
+    for (const char* c = text; *c; c++) {
+        length += ((unsigned char)*c & 0xC0) != 0x80;
+    }
+    return length;
+}
+
+// Вывод text с дополнением пробелами до width символов
+static void print_padded(const char* text, int width, int right) {
+    int length = text_length(text);
+    int padding = length < width ? width - length : 0;
+    if (right) {
+        printf("%*s%s", padding, "", text);
+    } else {
+        printf("%s%*s", text, padding, "");
+    }
+}
+
+// Строка таблицы с числами
+static void print_row(
+    const char* name,
+    double wall_ms,
+    double cpu_ms,
+    int64_t heap_bytes,
+    int64_t rss_kb,
+    int64_t pixels
+) {
+    char cell[64];
+
+    // Длинное название занимает отдельную строку
+    printf("          ");
+    if (text_length(name) > PROFILE_NAME_COLUMN) {
+        printf("%s\n          ", name);
+        name = "";
+    }
+    print_padded(name, PROFILE_NAME_COLUMN, 0);
+    printf(" %10.3f %10.3f", wall_ms, cpu_ms);
+
+    if (heap_bytes == PROFILE_UNKNOWN) {
+        snprintf(cell, sizeof(cell), "-");
+    } else {
+        snprintf(
+            cell,
+            sizeof(cell),
+            "%+.1f",
+            heap_bytes / 1024.0
+        );
+    }
+    printf(" %11s", cell);
+
+    if (rss_kb == PROFILE_UNKNOWN) {
+        snprintf(cell, sizeof(cell), "-");
+    } else {
+        snprintf(cell, sizeof(cell), "%.1f", rss_kb / 1024.0);
+    }
+    printf(" %12s", cell);
+
+    if (pixels > 0) {
+        printf(
+            " %10.2f\n",
+            megapixels_per_second(pixels, wall_ms)
+        );
+    } else {
+        printf(" %10s\n", "-");
+    }
+}
+
+// Событий счётчика на пиксель
+static double per_pixel(uint64_t count, int64_t pixels) {
+    return pixels > 0 ? (double)count / pixels : 0.0;
+}
+
+// Таблица аппаратных счётчиков: хватает ли стадии вычислений
+// (IPC) или она упирается в память (промахи кэша)
+static void print_hardware(const Profile* profile) {
+    static const char* headers[] = { "IPC",
+                                     "Такты/пикс",
+                                     "LLC промахи/пикс",
+                                     "Ветвл. промахи/пикс" };
+    static const int widths[] = { 8, 12, 18, 21 };
+
+    printf("[Counters] ");
+    print_padded("Стадия", PROFILE_NAME_COLUMN - 1, 0);
+    for (int c = 0; c < 4; c++) {
+        printf(" ");
+        print_padded(headers[c], widths[c], 1);
+    }
+    printf("\n");
+
+    for (int s = 0; s < profile->count; s++) {
+        const ProfileStage* stage = &profile->stages[s];
+        const CounterValues* hardware = &stage->hardware;
+
+        printf("          ");
+        if (text_length(stage->name) > PROFILE_NAME_COLUMN) {
+            printf("%s\n          ", stage->name);
+            print_padded("", PROFILE_NAME_COLUMN, 0);
+        } else {
+            print_padded(stage->name, PROFILE_NAME_COLUMN, 0);
+        }
+
+        printf(
+            " %8.2f %12.2f %18.4f %21.4f\n",
+            hardware->cycles
+                ? (double)hardware->instructions / hardware->cycles
+                : 0.0,
+            per_pixel(hardware->cycles, stage->pixels),
+            per_pixel(hardware->cache_misses, stage->pixels),
+            per_pixel(hardware->branch_misses, stage->pixels)
+        );
+    }
+}
+
+void profile_print(const Profile* profile) {
+    static const char* headers[] = { "Время, мс",
+                                     "ЦП, мс",
+                                     "Куча, КБ",
+                                     "Пик RSS, МБ",
+                                     "Мпикс/с" };
+    static const int widths[] = { 10, 10, 11, 12, 10 };
+
+    printf("[Profile] ");
+    print_padded("Стадия", PROFILE_NAME_COLUMN, 0);
+    for (int c = 0; c < 5; c++) {
+        printf(" ");
+        print_padded(headers[c], widths[c], 1);
+    }
+    printf("\n");
+
+    double wall_ms = 0.0;
+    double cpu_ms = 0.0;
+    int64_t heap_bytes = 0;
+    int64_t rss_kb = PROFILE_UNKNOWN;
+
+    for (int s = 0; s < profile->count; s++) {
+        const ProfileStage* stage = &profile->stages[s];
+        print_row(
+            stage->name,
+            stage->wall_ms,
+            stage->cpu_ms,
+            stage->heap_bytes,
+            stage->peak_rss_kb,
+            stage->pixels
+        );
+
+        wall_ms += stage->wall_ms;
+        cpu_ms += stage->cpu_ms;
+        if (stage->heap_bytes == PROFILE_UNKNOWN ||
+            heap_bytes == PROFILE_UNKNOWN) {
+            heap_bytes = PROFILE_UNKNOWN;
+        } else {
+            heap_bytes += stage->heap_bytes;
+        }
+        if (stage->peak_rss_kb > rss_kb) {
+            rss_kb = stage->peak_rss_kb;
+        }
+    }
+
+    print_row("Итого", wall_ms, cpu_ms, heap_bytes, rss_kb, 0);
+
+    if (profile->hardware) {
+        print_hardware(profile);
+    }
+}
+
+// Вывод строки в JSON с экранированием
+static void write_json_string(FILE* file, const char* text) {
+    fputc('"', file);
+    for (const unsigned char* c = (const unsigned char*)text; *c;
+         c++) {
+        if (*c == '"' || *c == '\\') {
+            fprintf(file, "\\%c", *c);
+        } else if (*c < 0x20) {
+            fprintf(file, "\\u%04x", *c);
+        } else {
+            fputc(*c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+// Вывод целого или null, если значение неизвестно
+static void write_json_integer(FILE* file, int64_t value) {
+    if (value == PROFILE_UNKNOWN) {
+        fprintf(file, "null");
+    } else {
+        fprintf(file, "%lld", (long long)value);
+    }
+}
+
+int profile_write_json(const Profile* profile, const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        return 1;
+    }
+
+    double wall_ms = 0.0;
+    double cpu_ms = 0.0;
+
+    fprintf(file, "{\n  \"stages\": [\n");
+    for (int s = 0; s < profile->count; s++) {
+        const ProfileStage* stage = &profile->stages[s];
+
+        fprintf(file, "    {\"name\": ");
+        write_json_string(file, stage->name);
+        fprintf(
+            file,
+            ", \"wall_ms\": %.3f, \"cpu_ms\": %.3f, "
+            "\"heap_bytes\": ",
+            stage->wall_ms,
+            stage->cpu_ms
+        );
+        write_json_integer(file, stage->heap_bytes);
+        fprintf(file, ", \"peak_rss_kb\": ");
+        write_json_integer(file, stage->peak_rss_kb);
+        fprintf(
+            file,
+            ", \"pixels\": %lld, \"megapixels_per_second\": %.3f",
+            (long long)stage->pixels,
+            megapixels_per_second(stage->pixels, stage->wall_ms)
+        );
+        if (stage->has_hardware) {
+            const CounterValues* hardware = &stage->hardware;
+            fprintf(
+                file,
+                ", \"cycles\": %llu, \"instructions\": %llu, "
+                "\"llc_misses\": %llu, \"branch_misses\": %llu",
+                (unsigned long long)hardware->cycles,
+                (unsigned long long)hardware->instructions,
+                (unsigned long long)hardware->cache_misses,
+                (unsigned long long)hardware->branch_misses
+            );
+        }
+        fprintf(file, "}%s\n", s + 1 < profile->count ? "," : "");
+
+        wall_ms += stage->wall_ms;
+        cpu_ms += stage->cpu_ms;
+    }
+    fprintf(
+        file,
+        "  ],\n  \"total\": {\"wall_ms\": %.3f, \"cpu_ms\": "
+        "%.3f}\n}\n",
+        wall_ms,
+        cpu_ms
+    );
+
+    return fclose(file) != 0;
+}
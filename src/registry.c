@@ -0,0 +1,299 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "filters.h"
+#include "registry.h"
+
+// Реестр фильтров. Чтобы добавить фильтр, нужно написать его
+// реализацию (filters.c, filters.h), завести номер
+// ARGV_TYPE_FILTER_* в filters.h и добавить описание с именем
+// аргумента в таблицу ниже: разбор аргументов, применение
+// цепочки и планировщики берут всё необходимое из описания
+
+// ==================== ПАРАМЕТРЫ ФИЛЬТРОВ ====================
+
+static float fixed_param(const Filter* filter, int index) {
+    return filter->params[index] / (float)FILTER_FIXED_SCALE;
+}
+
+// ==================== АДАПТЕРЫ ФИЛЬТРОВ ====================
+
+static int crop_output_region(
+    const Filter* filter,
+    int32_t frame_width,
+    int32_t frame_height,
+    BMPRegion* region
+) {
+    int32_t x = filter->params[0];
+    int32_t y = filter->params[1];
+
+    // Область начинается за пределами изображения
+    if (x < 0 || y < 0 || x >= frame_width || y >= frame_height) {
+        return 1;
+    }
+
+    // Если запрошенные размеры больше исходных, используем
+    // доступную часть
+    region->x = x;
+    region->y = y;
+    region->width = filter->params[2] < frame_width - x
+        ? filter->params[2]
+        : frame_width - x;
+    region->height = filter->params[3] < frame_height - y
+        ? filter->params[3]
+        : frame_height - y;
+    return 0;
+}
+
+static int grayscale_apply(BMPImage* image, const Filter* filter) {
+    (void)filter;
+    return filter_grayscale(image);
+}
+
+static int negative_apply(BMPImage* image, const Filter* filter) {
+    (void)filter;
+    return filter_negative(image);
+}
+
+static int kernel3_radius(const Filter* filter) {
+    (void)filter;
+    return 1; // Ядро 3x3
+}
+
+static int sharpening_apply(
+    const BMPImage* image,
+    BMPImage* result,
+    const Filter* filter,
+    Scheduler* scheduler
+) {
+    (void)scheduler;
+    (void)filter;
+    return filter_sharpening(image, result);
+}
+
+static int edge_apply(
+    const BMPImage* image,
+    BMPImage* result,
+    const Filter* filter,
+    Scheduler* scheduler
+) {
+    (void)scheduler;
+    return filter_edge_detection(
+        image,
+        result,
+        fixed_param(filter, 0)
+    );
+}
+
+static int blur_radius(const Filter* filter) {
+    return filter_gaussian_kernel_size(fixed_param(filter, 0)) /
+        2;
+}
+
+static int blur_apply(
+    const BMPImage* image,
+    BMPImage* result,
+    const Filter* filter,
+    Scheduler* scheduler
+) {
+    (void)scheduler;
+    return filter_gaussian_blur(
+        image,
+        result,
+        fixed_param(filter, 0)
+    );
+}
+
+static int median_radius(const Filter* filter) {
+    return filter->params[0] / 2;
+}
+
+static int median_apply(
+    const BMPImage* image,
+    BMPImage* result,
+    const Filter* filter,
+    Scheduler* scheduler
+) {
+    (void)scheduler;
+    return filter_median(image, result, filter->params[0]);
+}
+
+static int crystallize_apply(
+    const BMPImage* image,
+    BMPImage* result,
+    const Filter* filter,
+    Scheduler* scheduler
+) {
+    return filter_crystallize(
+        image,
+        result,
+        fixed_param(filter, 0),
+        fixed_param(filter, 1),
+        fixed_param(filter, 2),
+        scheduler
+    );
+}
+
+static uint64_t crystallize_workspace(
+    const Filter* filter,
+    int32_t width,
+    int32_t height,
+    int workers
+) {
+    return filter_crystallize_workspace(
+        width,
+        height,
+        fixed_param(filter, 2),
+        workers
+    );
+}
+
+// ==================== ТАБЛИЦА ФИЛЬТРОВ ====================
+
+static const FilterDescriptor registry[] = {
+    {
+        .name = "-crop",
+        .type = ARGV_TYPE_FILTER_CROP,
+        .param_count = 4,
+        .min_param_count = 2,
+        .params = {
+            { "x", FILTER_PARAM_INT, FILTER_PARAM_NON_NEGATIVE },
+            { "y", FILTER_PARAM_INT, FILTER_PARAM_NON_NEGATIVE },
+            { "width", FILTER_PARAM_INT, FILTER_PARAM_POSITIVE },
+            { "height", FILTER_PARAM_INT, FILTER_PARAM_POSITIVE },
+        },
+        .kind = FILTER_KIND_POINT,
+        .in_place = 1,
+        .resizes = 1,
+        .output_region = crop_output_region,
+    },
+    {
+        .name = "-gs",
+        .type = ARGV_TYPE_FILTER_GS,
+        .kind = FILTER_KIND_POINT,
+        .in_place = 1,
+        .apply_in_place = grayscale_apply,
+    },
+    {
+        .name = "-neg",
+        .type = ARGV_TYPE_FILTER_NEG,
+        .kind = FILTER_KIND_POINT,
+        .in_place = 1,
+        .apply_in_place = negative_apply,
+    },
+    {
+        .name = "-sharp",
+        .type = ARGV_TYPE_FILTER_SHARP,
+        .kind = FILTER_KIND_NEIGHBORHOOD,
+        .radius = kernel3_radius,
+        .apply = sharpening_apply,
+    },
+    {
+        .name = "-edge",
+        .type = ARGV_TYPE_FILTER_EDGE,
+        .param_count = 1,
+        .min_param_count = 1,
+        .params = {
+            { "threshold", FILTER_PARAM_FIXED, FILTER_PARAM_ANY },
+        },
+        .kind = FILTER_KIND_NEIGHBORHOOD,
+        .radius = kernel3_radius,
+        .apply = edge_apply,
+    },
+    {
+        .name = "-blur",
+        .type = ARGV_TYPE_FILTER_BLUR,
+        .param_count = 1,
+        .min_param_count = 1,
+        .params = {
+            { "sigma", FILTER_PARAM_FIXED, FILTER_PARAM_POSITIVE },
+        },
+        .kind = FILTER_KIND_NEIGHBORHOOD,
+        .radius = blur_radius,
+        .apply = blur_apply,
+    },
+    {
+        .name = "-med",
+        .type = ARGV_TYPE_FILTER_MED,
+        .param_count = 1,
+        .min_param_count = 1,
+        .params = {
+            { "window",
+              FILTER_PARAM_INT,
+              FILTER_PARAM_POSITIVE | FILTER_PARAM_ODD,
+              3 },
+        },
+        .kind = FILTER_KIND_NEIGHBORHOOD,
+        .radius = median_radius,
+        .apply = median_apply,
+    },
+    {
+        .name = "-crystal",
+        .type = ARGV_TYPE_FILTER_CRYSTAL,
+        .param_count = 3,
+        .min_param_count = 3,
+        .params = {
+            { "center_x", FILTER_PARAM_FIXED, FILTER_PARAM_ANY },
+            { "center_y", FILTER_PARAM_FIXED, FILTER_PARAM_ANY },
+            { "radius", FILTER_PARAM_FIXED, FILTER_PARAM_POSITIVE },
+        },
+        // Средние цвета ячеек считаются по всему изображению
+        .kind = FILTER_KIND_GLOBAL,
+        .apply = crystallize_apply,
+        .workspace = crystallize_workspace,
+    },
+};
+
+#define REGISTRY_SIZE (int)(sizeof(registry) / sizeof(registry[0]))
+
+// ==================== ПОИСК В РЕЕСТРЕ ====================
+
+const FilterDescriptor* filter_registry_find(const char* name) {
+    if (!name) {
+        return NULL;
+    }
+
+    for (int i = 0; i < REGISTRY_SIZE; i++) {
+        if (strcmp(registry[i].name, name) == 0) {
+            return &registry[i];
+        }
+    }
+    return NULL;
+}
+
+const FilterDescriptor* filter_registry_get(int type) {
+    for (int i = 0; i < REGISTRY_SIZE; i++) {
+        if (registry[i].type == type) {
+            return &registry[i];
+        }
+    }
+    return NULL;
+}
+
+int filter_registry_count(void) {
+    return REGISTRY_SIZE;
+}
+
+const FilterDescriptor* filter_registry_at(int index) {
+    if (index < 0 || index >= REGISTRY_SIZE) {
+        return NULL;
+    }
+    return &registry[index];
+}
+
+int filter_radius(const Filter* filter) {
+    const FilterDescriptor* descriptor =
+        filter_registry_get(filter->type);
+    if (!descriptor) {
+        return 0;
+    }
+
+    switch (descriptor->kind) {
+        case FILTER_KIND_NEIGHBORHOOD:
+            return descriptor->radius(filter);
+        case FILTER_KIND_GLOBAL:
+            return FILTER_RADIUS_GLOBAL;
+        default:
+            return 0;
+    }
+}
@@ -0,0 +1,274 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "defines.h"
+#include "filters.h"
+#include "registry.h"
+#include "roi.h"
+
+static int32_t min_i32(int32_t a, int32_t b) {
+    return a < b ? a : b;
+}
+
+static int32_t max_i32(int32_t a, int32_t b) {
+    return a > b ? a : b;
+}
+
+// Расширение области на радиус с обрезкой по границам кадра
+void roi_grow_region(
+    BMPRegion* region,
+    int radius,
+    int32_t frame_width,
+    int32_t frame_height
+) {
+    int32_t x0 = max_i32(region->x - radius, 0);
+    int32_t y0 = max_i32(region->y - radius, 0);
+    int32_t x1 =
+        min_i32(region->x + region->width + radius, frame_width);
+    int32_t y1 = min_i32(
+        region->y + region->height + radius,
+        frame_height
+    );
+
+    region->x = x0;
+    region->y = y0;
+    region->width = x1 - x0;
+    region->height = y1 - y0;
+}
+
+// Планирование области для части результата
+int roi_plan_area(
+    const Filter* head,
+    int32_t width,
+    int32_t height,
+    const BMPRegion* area,
+    BMPRegion* region,
+    int32_t* result_width,
+    int32_t* result_height
+) {
+    int count = 0;
+    for (const Filter* f = head; f; f = f->next) {
+        count++;
+    }
+
+    // Список односвязный, для обратного обхода собираем массив
+    // стадий и размеры кадров после каждой из них
+    const Filter** stages = (const Filter**)scratch_alloc(
+        (count + 1) * sizeof(Filter*)
+    );
+    BMPRegion* frames = (BMPRegion*)scratch_alloc(
+        (count + 1) * sizeof(BMPRegion)
+    );
+    BMPRegion* crops = (BMPRegion*)scratch_alloc(
+        (count + 1) * sizeof(BMPRegion)
+    );
+    if (!stages || !frames || !crops) {
+        scratch_free(crops);
+        scratch_free(frames);
+        scratch_free(stages);
+        return 1;
+    }
+
+    // Прямой проход: размеры кадров
+    BMPRegion full = { 0, 0, width, height };
+    frames[0] = full;
+    int k = 0;
+    for (const Filter* f = head; f; f = f->next, k++) {
+        stages[k] = f;
+        frames[k + 1] = frames[k];
+
+        const FilterDescriptor* descriptor =
+            filter_registry_get(f->type);
+
+        // Ошибки в цепочке сообщит apply_filters
+        if (!descriptor ||
+            (descriptor->resizes &&
+             descriptor->output_region(
+                 f,
+                 frames[k].width,
+                 frames[k].height,
+                 &crops[k]
+             ) != 0)) {
+            scratch_free(crops);
+            scratch_free(frames);
+            scratch_free(stages);
+            return 1;
+        }
+
+        if (descriptor->resizes) {
+            frames[k + 1].width = crops[k].width;
+            frames[k + 1].height = crops[k].height;
+        }
+    }
+
+    if (result_width) {
+        *result_width = frames[count].width;
+    }
+    if (result_height) {
+        *result_height = frames[count].height;
+    }
+
+    // Обратный проход: от нужной части результата к нужной
+    // области каждого входа
+    BMPRegion need = area ? *area : frames[count];
+    for (k = count - 1; k >= 0; k--) {
+        const Filter* f = stages[k];
+        int32_t frame_width = frames[k].width;
+        int32_t frame_height = frames[k].height;
+
+        if (filter_registry_get(f->type)->resizes) {
+            need.x += crops[k].x;
+            need.y += crops[k].y;
+            continue;
+        }
+
+        int radius = filter_radius(f);
+        if (radius == FILTER_RADIUS_GLOBAL) {
+            need = frames[k];
+        } else if (radius > 0) {
+            roi_grow_region(
+                &need,
+                radius,
+                frame_width,
+                frame_height
+            );
+        }
+    }
+
+    scratch_free(crops);
+    scratch_free(frames);
+    scratch_free(stages);
+
+    *region = need;
+    return 0;
+}
+
+// Планирование области интереса
+int roi_plan(
+    const Filter* head,
+    int32_t width,
+    int32_t height,
+    BMPRegion* region
+) {
+    BMPRegion full = { 0, 0, width, height };
+    if (roi_plan_area(
+            head,
+            width,
+            height,
+            NULL,
+            region,
+            NULL,
+            NULL
+        ) != 0) {
+        *region = full;
+        return 0;
+    }
+
+    return region->width < width || region->height < height;
+}
+
+// Обрезка в окне
+int roi_crop_window(
+    RoiWindow* window,
+    int32_t buffer_width,
+    int32_t buffer_height,
+    const BMPRegion* crop,
+    BMPRegion* view
+) {
+    // Пересечение области кадра с тем, что есть в буфере
+    int32_t x0 = max_i32(crop->x, window->x);
+    int32_t y0 = max_i32(crop->y, window->y);
+    int32_t x1 = min_i32(
+        crop->x + crop->width,
+        window->x + buffer_width
+    );
+    int32_t y1 = min_i32(
+        crop->y + crop->height,
+        window->y + buffer_height
+    );
+
+    if (x1 <= x0 || y1 <= y0) {
+        return 1;
+    }
+
+    view->x = x0 - window->x;
+    view->y = y0 - window->y;
+    view->width = x1 - x0;
+    view->height = y1 - y0;
+
+    window->x = x0 - crop->x;
+    window->y = y0 - crop->y;
+    window->frame_width = crop->width;
+    window->frame_height = crop->height;
+
+    return 0;
+}
+
+// Загрузка изображения с учетом области интереса
+BMPImage* roi_load(
+    const char* filename,
+    const Filter* head,
+    RoiWindow* window,
+    BMPRegion* region,
+    Scheduler* scheduler
+) {
+    BMPFileHeader file_header;
+    BMPInfoHeader info_header;
+
+    if (bmp_read_headers(filename, &file_header, &info_header) !=
+        ALL_OK) {
+        return NULL;
+    }
+
+    window->frame_width = info_header.width;
+    window->frame_height = abs(info_header.height);
+
+    roi_plan(
+        head,
+        window->frame_width,
+        window->frame_height,
+        region
+    );
+    window->x = region->x;
+    window->y = region->y;
+
+    return bmp_load_parallel(filename, region, scheduler);
+}
+
+BMPImage* roi_decode(
+    const uint8_t* data,
+    size_t size,
+    const Filter* head,
+    RoiWindow* window,
+    BMPRegion* region
+) {
+    BMPFileHeader file_header;
+    BMPInfoHeader info_header;
+    if (size < sizeof(BMPFileHeader) + sizeof(BMPInfoHeader)) {
+        return NULL;
+    }
+    memcpy(&file_header, data, sizeof(BMPFileHeader));
+    memcpy(
+        &info_header,
+        data + sizeof(BMPFileHeader),
+        sizeof(BMPInfoHeader)
+    );
+    if (info_header.width <= 0 || info_header.height == 0) {
+        return NULL;
+    }
+
+    window->frame_width = info_header.width;
+    window->frame_height = abs(info_header.height);
+
+    roi_plan(
+        head,
+        window->frame_width,
+        window->frame_height,
+        region
+    );
+    window->x = region->x;
+    window->y = region->y;
+
+    return bmp_decode_region(data, size, region);
+}
@@ -0,0 +1,589 @@
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "arena.h"
+#include "counters.h"
+#include "scheduler.h"
+#include "trace.h"
+
+// Начальная вместимость очереди рабочего потока
+#define DEQUE_INITIAL_CAPACITY 64
+
+// Наибольшее число узлов NUMA при привязке потоков
+#define SCHEDULER_MAX_NODES 64
+
+// Группа задач одного вызова scheduler_parallel_for
+typedef struct {
+    int remaining; // Число невыполненных задач
+    int finished;  // Последняя задача завершилась (под lock)
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+} TaskGroup;
+
+typedef struct {
+    TaskFunction function;
+    void* context;
+    int index;
+    TaskGroup* group;
+} Task;
+
+// Двусторонняя очередь задач рабочего потока (кольцевой буфер)
+typedef struct {
+    pthread_mutex_t lock;
+    Task* tasks;
+    int capacity;
+    int head;  // Отсюда крадут другие потоки
+    int count; // Хвост - head + count, отсюда берёт владелец
+} TaskDeque;
+
+struct Scheduler {
+    int workers;
+    pthread_t* threads;
+    TaskDeque* deques;
+
+    // Сон простаивающих потоков
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle;
+    int pending; // Задачи в очередях
+    int stopping;
+
+    unsigned int next_deque; // Очередь для задач внешних потоков
+};
+
+// Номер рабочего потока и планировщик, которому он принадлежит
+static __thread int current_worker = -1;
+static __thread Scheduler* current_scheduler = NULL;
+
+typedef struct {
+    Scheduler* scheduler;
+    int worker;
+} WorkerStart;
+
+// ==================== ОЧЕРЕДИ ====================
+
+static int deque_init(TaskDeque* deque) {
+    deque->tasks =
+        (Task*)malloc(DEQUE_INITIAL_CAPACITY * sizeof(Task));
+    if (!deque->tasks) {
+        return 1;
+    }
+    deque->capacity = DEQUE_INITIAL_CAPACITY;
+    deque->head = 0;
+    deque->count = 0;
+    pthread_mutex_init(&deque->lock, NULL);
+    return 0;
+}
+
+static void deque_free(TaskDeque* deque) {
+    pthread_mutex_destroy(&deque->lock);
+    free(deque->tasks);
+}
+
+// Добавление задачи в хвост. Возвращает 0 при успехе
+static int deque_push(TaskDeque* deque, const Task* task) {
+    pthread_mutex_lock(&deque->lock);
+
+    if (deque->count == deque->capacity) {
+        int capacity = deque->capacity * 2;
+        Task* tasks = (Task*)malloc(capacity * sizeof(Task));
+        if (!tasks) {
+            pthread_mutex_unlock(&deque->lock);
+            return 1;
+        }
+
+        for (int i = 0; i < deque->count; i++) {
+            tasks[i] =
+                deque->tasks[(deque->head + i) % deque->capacity];
+        }
+        free(deque->tasks);
+        deque->tasks = tasks;
+        deque->capacity = capacity;
+        deque->head = 0;
+    }
+
+    int tail = (deque->head + deque->count) % deque->capacity;
+    deque->tasks[tail] = *task;
+    deque->count++;
+
+    pthread_mutex_unlock(&deque->lock);
+    return 0;
+}
+
+// Владелец берёт последнюю добавленную задачу (LIFO)
+static int deque_pop(TaskDeque* deque, Task* task) {
+    int found = 0;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->count > 0) {
+        deque->count--;
+        *task = deque->tasks
+                    [(deque->head + deque->count) % deque->capacity];
+        found = 1;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+// Другие потоки крадут самую старую задачу (FIFO)
+static int deque_steal(TaskDeque* deque, Task* task) {
+    int found = 0;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->count > 0) {
+        *task = deque->tasks[deque->head];
+        deque->head = (deque->head + 1) % deque->capacity;
+        deque->count--;
+        found = 1;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+// ==================== ВЫПОЛНЕНИЕ ЗАДАЧ ====================
+
+// Генератор xorshift для выбора жертвы кражи
+static uint32_t next_random(uint32_t* state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+// Поиск задачи: сначала своя очередь, затем кража у случайных
+// соседей
+static int take_task(
+    Scheduler* scheduler,
+    int worker,
+    uint32_t* random,
+    Task* task
+) {
+    if (deque_pop(&scheduler->deques[worker], task)) {
+        __atomic_sub_fetch(&scheduler->pending, 1, __ATOMIC_ACQ_REL);
+        return 1;
+    }
+
+    int workers = scheduler->workers;
+    int start = (int)(next_random(random) % (uint32_t)workers);
+    for (int i = 0; i < workers; i++) {
+        int victim = (start + i) % workers;
+        if (victim != worker &&
+            deque_steal(&scheduler->deques[victim], task)) {
+            __atomic_sub_fetch(
+                &scheduler->pending,
+                1,
+                __ATOMIC_ACQ_REL
+            );
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// Отметка о завершении задачи группы. Группа живёт на стеке
+// ожидающего потока, поэтому последнее обращение к ней -
+// освобождение мьютекса
+static void finish_task(TaskGroup* group) {
+    if (__atomic_sub_fetch(&group->remaining, 1, __ATOMIC_ACQ_REL) ==
+        0) {
+        pthread_mutex_lock(&group->lock);
+        group->finished = 1;
+        pthread_cond_broadcast(&group->done);
+        pthread_mutex_unlock(&group->lock);
+    }
+}
+
+// Выполнение задачи. Её временная память возвращается арене
+// потока сразу по завершении
+static void run_function(
+    TaskFunction function,
+    void* context,
+    int index,
+    int worker
+) {
+    Arena* arena = arena_current();
+    ArenaMark mark = arena_mark(arena);
+    function(context, index, worker);
+    arena_rewind(arena, mark);
+}
+
+static void run_task(const Task* task, int worker) {
+    run_function(
+        task->function,
+        task->context,
+        task->index,
+        worker
+    );
+    finish_task(task->group);
+}
+
+static void* worker_main(void* argument) {
+    WorkerStart* start = (WorkerStart*)argument;
+    Scheduler* scheduler = start->scheduler;
+    int worker = start->worker;
+    free(start);
+
+    current_worker = worker;
+    current_scheduler = scheduler;
+
+    char name[32];
+    snprintf(name, sizeof(name), "worker %d", worker);
+    trace_thread_name(name);
+    counters_attach_thread();
+    uint32_t random = 2654435761u * (uint32_t)(worker + 1);
+
+    // Без арены временная память берется у системы
+    Arena* arena = arena_create(0);
+    arena_enter(arena);
+
+    for (;;) {
+        Task task;
+        if (take_task(scheduler, worker, &random, &task)) {
+            run_task(&task, worker);
+            continue;
+        }
+
+        // Задач нет: засыпаем до появления новых
+        pthread_mutex_lock(&scheduler->idle_lock);
+        while (!scheduler->stopping &&
+               __atomic_load_n(
+                   &scheduler->pending,
+                   __ATOMIC_ACQUIRE
+               ) == 0) {
+            pthread_cond_wait(
+                &scheduler->idle,
+                &scheduler->idle_lock
+            );
+        }
+        int stopping = scheduler->stopping;
+        pthread_mutex_unlock(&scheduler->idle_lock);
+
+        if (stopping) {
+            break;
+        }
+    }
+
+    arena_enter(NULL);
+    arena_destroy(arena);
+    return NULL;
+}
+
+// ==================== ИНТЕРФЕЙС ====================
+
+int scheduler_online_workers(void) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    return online > 0 ? (int)online : 1;
+}
+
+Scheduler* scheduler_create(int workers) {
+    if (workers <= 0) {
+        workers = scheduler_online_workers();
+    }
+
+    Scheduler* scheduler = (Scheduler*)calloc(1, sizeof(Scheduler));
+    if (!scheduler) {
+        return NULL;
+    }
+
+    scheduler->workers = workers;
+    scheduler->threads =
+        (pthread_t*)calloc(workers, sizeof(pthread_t));
+    scheduler->deques =
+        (TaskDeque*)calloc(workers, sizeof(TaskDeque));
+    if (!scheduler->threads || !scheduler->deques) {
+        free(scheduler->threads);
+        free(scheduler->deques);
+        free(scheduler);
+        return NULL;
+    }
+
+    pthread_mutex_init(&scheduler->idle_lock, NULL);
+    pthread_cond_init(&scheduler->idle, NULL);
+
+    // Очереди готовы до запуска потоков: любой поток может
+    // сразу начать красть у любого другого
+    int ready = 0;
+    while (ready < workers &&
+           deque_init(&scheduler->deques[ready]) == 0) {
+        ready++;
+    }
+
+    int created = 0;
+    while (ready == workers && created < workers) {
+        WorkerStart* start =
+            (WorkerStart*)malloc(sizeof(WorkerStart));
+        if (!start) {
+            break;
+        }
+        start->scheduler = scheduler;
+        start->worker = created;
+
+        if (pthread_create(
+                &scheduler->threads[created],
+                NULL,
+                worker_main,
+                start
+            ) != 0) {
+            free(start);
+            break;
+        }
+        created++;
+    }
+
+    if (created < workers) {
+        // Останавливаем уже запущенные потоки
+        pthread_mutex_lock(&scheduler->idle_lock);
+        scheduler->stopping = 1;
+        pthread_cond_broadcast(&scheduler->idle);
+        pthread_mutex_unlock(&scheduler->idle_lock);
+
+        for (int i = 0; i < created; i++) {
+            pthread_join(scheduler->threads[i], NULL);
+        }
+        for (int i = 0; i < ready; i++) {
+            deque_free(&scheduler->deques[i]);
+        }
+
+        pthread_cond_destroy(&scheduler->idle);
+        pthread_mutex_destroy(&scheduler->idle_lock);
+        free(scheduler->threads);
+        free(scheduler->deques);
+        free(scheduler);
+        return NULL;
+    }
+
+    return scheduler;
+}
+
+void scheduler_destroy(Scheduler* scheduler) {
+    if (!scheduler) {
+        return;
+    }
+
+    pthread_mutex_lock(&scheduler->idle_lock);
+    scheduler->stopping = 1;
+    pthread_cond_broadcast(&scheduler->idle);
+    pthread_mutex_unlock(&scheduler->idle_lock);
+
+    // Очереди освобождаются, когда красть из них уже некому
+    for (int i = 0; i < scheduler->workers; i++) {
+        pthread_join(scheduler->threads[i], NULL);
+    }
+    for (int i = 0; i < scheduler->workers; i++) {
+        deque_free(&scheduler->deques[i]);
+    }
+
+    pthread_cond_destroy(&scheduler->idle);
+    pthread_mutex_destroy(&scheduler->idle_lock);
+    free(scheduler->threads);
+    free(scheduler->deques);
+    free(scheduler);
+}
+
+int scheduler_workers(const Scheduler* scheduler) {
+    return scheduler ? scheduler->workers : 1;
+}
+
+int scheduler_current_worker(void) {
+    return current_worker;
+}
+
+// Выполнение группы задач. При bands задача index внешнего
+// потока попадает в очередь index * workers / count, иначе
+// очереди выбираются по кругу
+static void parallel_run(
+    Scheduler* scheduler,
+    int count,
+    TaskFunction function,
+    void* context,
+    int bands
+) {
+    if (count <= 0) {
+        return;
+    }
+
+    // Без планировщика (или с одним потоком и вызовом снаружи)
+    // выполняем задачи на месте
+    int nested = current_scheduler == scheduler && scheduler;
+    if (!scheduler || (scheduler->workers == 1 && !nested)) {
+        for (int i = 0; i < count; i++) {
+            run_function(function, context, i, 0);
+        }
+        return;
+    }
+
+    TaskGroup group;
+    group.remaining = count;
+    group.finished = 0;
+    pthread_mutex_init(&group.lock, NULL);
+    pthread_cond_init(&group.done, NULL);
+
+    // Вложенные задачи остаются в очереди вызвавшего потока и
+    // расходятся по соседям кражей, внешние раздаются по кругу
+    int pushed = 0;
+    for (int i = 0; i < count; i++) {
+        Task task = { function, context, i, &group };
+        int target;
+
+        if (nested) {
+            target = current_worker;
+        } else if (bands) {
+            target =
+                (int)((int64_t)i * scheduler->workers / count);
+        } else {
+            unsigned int next = __atomic_fetch_add(
+                &scheduler->next_deque,
+                1u,
+                __ATOMIC_RELAXED
+            );
+            target = (int)(next % (unsigned int)scheduler->workers);
+        }
+
+        if (deque_push(&scheduler->deques[target], &task) != 0) {
+            // Очередь не растёт: выполняем задачу сами
+            run_function(
+                function,
+                context,
+                i,
+                nested ? current_worker : 0
+            );
+            finish_task(&group);
+            continue;
+        }
+        pushed++;
+    }
+
+    pthread_mutex_lock(&scheduler->idle_lock);
+    __atomic_add_fetch(&scheduler->pending, pushed, __ATOMIC_ACQ_REL);
+    pthread_cond_broadcast(&scheduler->idle);
+    pthread_mutex_unlock(&scheduler->idle_lock);
+
+    if (nested) {
+        // Рабочий поток не блокируется, а помогает выполнять
+        // задачи, пока группа не завершится
+        uint32_t random = 2166136261u ^ (uint32_t)current_worker;
+        while (__atomic_load_n(&group.remaining, __ATOMIC_ACQUIRE) >
+               0) {
+            Task task;
+            if (take_task(scheduler, current_worker, &random, &task)) {
+                run_task(&task, current_worker);
+            } else {
+                sched_yield();
+            }
+        }
+    }
+
+    pthread_mutex_lock(&group.lock);
+    while (!group.finished) {
+        pthread_cond_wait(&group.done, &group.lock);
+    }
+    pthread_mutex_unlock(&group.lock);
+
+    pthread_cond_destroy(&group.done);
+    pthread_mutex_destroy(&group.lock);
+}
+
+void scheduler_parallel_for(
+    Scheduler* scheduler,
+    int count,
+    TaskFunction function,
+    void* context
+) {
+    parallel_run(scheduler, count, function, context, 0);
+}
+
+void scheduler_parallel_bands(
+    Scheduler* scheduler,
+    int count,
+    TaskFunction function,
+    void* context
+) {
+    parallel_run(scheduler, count, function, context, 1);
+}
+
+#ifdef __linux__
+// Процессоры узла NUMA из списка вида "0-3,8-11". Возвращает 0
+// при успехе
+static int read_node_cpus(int node, cpu_set_t* set) {
+    char path[64];
+    snprintf(
+        path,
+        sizeof(path),
+        "/sys/devices/system/node/node%d/cpulist",
+        node
+    );
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return 1;
+    }
+
+    CPU_ZERO(set);
+    int found = 0;
+    int first;
+    while (fscanf(file, "%d", &first) == 1) {
+        int last = first;
+        int separator = fgetc(file);
+        if (separator == '-') {
+            if (fscanf(file, "%d", &last) != 1) {
+                break;
+            }
+            separator = fgetc(file);
+        }
+
+        for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE;
+             cpu++) {
+            CPU_SET(cpu, set);
+            found = 1;
+        }
+        if (separator != ',') {
+            break;
+        }
+    }
+
+    fclose(file);
+    return !found;
+}
+#endif
+
+int scheduler_bind_numa(Scheduler* scheduler) {
+#ifdef __linux__
+    if (!scheduler) {
+        return 0;
+    }
+
+    // Узлы без процессоров (только память) заканчивают перечень
+    cpu_set_t sets[SCHEDULER_MAX_NODES];
+    int nodes = 0;
+    while (nodes < SCHEDULER_MAX_NODES &&
+           read_node_cpus(nodes, &sets[nodes]) == 0) {
+        nodes++;
+    }
+    if (nodes < 2) {
+        return 0;
+    }
+
+    // Соседние потоки получают соседние полосы, поэтому и узел у
+    // них общий
+    for (int w = 0; w < scheduler->workers; w++) {
+        int node =
+            (int)((int64_t)w * nodes / scheduler->workers);
+        if (pthread_setaffinity_np(
+                scheduler->threads[w],
+                sizeof(cpu_set_t),
+                &sets[node]
+            ) != 0) {
+            return 0;
+        }
+    }
+    return nodes;
+#else
+    (void)scheduler;
+    return 0;
+#endif
+}
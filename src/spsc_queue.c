@@ -0,0 +1,144 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "spsc_queue.h"
+#include "trace.h"
+
+struct SpscQueue {
+    void** items;
+    unsigned int mask; // Вместимость - степень двойки
+
+    // Счётчики растут неограниченно, индекс - по маске. head
+    // пишет только потребитель, tail - только производитель
+    unsigned int head;
+    unsigned int tail;
+    int closed;
+
+    // Ожидание на пустой (потребитель) или полной
+    // (производитель) очереди
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    int consumer_waiting;
+    int producer_waiting;
+};
+
+SpscQueue* spsc_queue_create(int capacity) {
+    unsigned int size = 2;
+    while ((int)size < capacity) {
+        size *= 2;
+    }
+
+    SpscQueue* queue = (SpscQueue*)calloc(1, sizeof(SpscQueue));
+    if (!queue) {
+        return NULL;
+    }
+
+    queue->items = (void**)calloc(size, sizeof(void*));
+    if (!queue->items) {
+        free(queue);
+        return NULL;
+    }
+
+    queue->mask = size - 1;
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->changed, NULL);
+    return queue;
+}
+
+void spsc_queue_free(SpscQueue* queue) {
+    if (!queue) {
+        return;
+    }
+
+    pthread_cond_destroy(&queue->changed);
+    pthread_mutex_destroy(&queue->lock);
+    free(queue->items);
+    free(queue);
+}
+
+// Пробуждение другой стороны, если она уснула. Флаг ожидания
+// выставляется под мьютексом до повторной проверки очереди,
+// поэтому сигнал не теряется
+static void wake(SpscQueue* queue, int* waiting) {
+    if (__atomic_load_n(waiting, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&queue->lock);
+        pthread_cond_broadcast(&queue->changed);
+        pthread_mutex_unlock(&queue->lock);
+    }
+}
+
+void spsc_queue_push(SpscQueue* queue, void* item) {
+    unsigned int tail = queue->tail;
+
+    if (tail - __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE) >
+        queue->mask) {
+        int64_t start = trace_begin();
+        pthread_mutex_lock(&queue->lock);
+        __atomic_store_n(
+            &queue->producer_waiting,
+            1,
+            __ATOMIC_SEQ_CST
+        );
+        while (tail - __atomic_load_n(
+                          &queue->head,
+                          __ATOMIC_SEQ_CST
+                      ) >
+               queue->mask) {
+            pthread_cond_wait(&queue->changed, &queue->lock);
+        }
+        __atomic_store_n(
+            &queue->producer_waiting,
+            0,
+            __ATOMIC_RELAXED
+        );
+        pthread_mutex_unlock(&queue->lock);
+        trace_end("queue wait", start, -1);
+    }
+
+    queue->items[tail & queue->mask] = item;
+    __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_SEQ_CST);
+    wake(queue, &queue->consumer_waiting);
+}
+
+int spsc_queue_try_pop(SpscQueue* queue, void** item) {
+    unsigned int head = queue->head;
+
+    if (head == __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+
+    *item = queue->items[head & queue->mask];
+    __atomic_store_n(&queue->head, head + 1, __ATOMIC_SEQ_CST);
+    wake(queue, &queue->producer_waiting);
+    return 1;
+}
+
+int spsc_queue_pop(SpscQueue* queue, void** item) {
+    if (spsc_queue_try_pop(queue, item)) {
+        return 1;
+    }
+
+    int64_t start = trace_begin();
+    pthread_mutex_lock(&queue->lock);
+    __atomic_store_n(&queue->consumer_waiting, 1, __ATOMIC_SEQ_CST);
+    while (queue->head ==
+               __atomic_load_n(&queue->tail, __ATOMIC_SEQ_CST) &&
+           !__atomic_load_n(&queue->closed, __ATOMIC_SEQ_CST)) {
+        pthread_cond_wait(&queue->changed, &queue->lock);
+    }
+    __atomic_store_n(&queue->consumer_waiting, 0, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&queue->lock);
+    trace_end("queue wait", start, -1);
+
+    // Закрытая очередь отдаёт оставшиеся элементы
+    return spsc_queue_try_pop(queue, item);
+}
+
+void spsc_queue_close(SpscQueue* queue) {
+    pthread_mutex_lock(&queue->lock);
+    __atomic_store_n(&queue->closed, 1, __ATOMIC_SEQ_CST);
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+}
@@ -0,0 +1,281 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "defines.h"
+#include "paths.h"
+#include "stage_cache.h"
+
+// Запись на диске - BMP изображение, за которым следует окно
+#define STAGE_TRAILER_MAGIC "ICSW"
+#define STAGE_TRAILER_SIZE 20
+
+// Запись в памяти
+typedef struct {
+    CacheKey key;
+    BMPImage* image;
+    RoiWindow window;
+    uint64_t bytes;
+    uint64_t used; // Отметка последнего обращения
+} StageEntry;
+
+struct _StageCache {
+    pthread_mutex_t lock;
+    StageEntry* entries;
+    int count;
+    int capacity;
+    uint64_t bytes;
+    uint64_t memory_bytes;
+    uint64_t clock; // Счётчик обращений для вытеснения
+    char* directory;
+    uint64_t disk_bytes;
+};
+
+StageCache* stage_cache_create(
+    uint64_t memory_bytes,
+    const char* directory,
+    uint64_t disk_bytes
+) {
+    StageCache* cache =
+        (StageCache*)calloc(1, sizeof(StageCache));
+    if (!cache) {
+        return NULL;
+    }
+
+    if (directory && !(cache->directory = ic_strdup(directory))) {
+        free(cache);
+        return NULL;
+    }
+    pthread_mutex_init(&cache->lock, NULL);
+    cache->memory_bytes = memory_bytes;
+    cache->disk_bytes = disk_bytes;
+    return cache;
+}
+
+void stage_cache_destroy(StageCache* cache) {
+    if (!cache) {
+        return;
+    }
+
+    for (int i = 0; i < cache->count; i++) {
+        bmp_free(cache->entries[i].image);
+    }
+    free(cache->entries);
+    free(cache->directory);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+static uint64_t image_bytes(const BMPImage* image) {
+    return (uint64_t)image->info_header.width *
+           abs(image->info_header.height) * sizeof(RGBPixel);
+}
+
+static int find_entry(const StageCache* cache, const CacheKey* key) {
+    for (int i = 0; i < cache->count; i++) {
+        if (strcmp(cache->entries[i].key.hex, key->hex) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Добавление записи в память с вытеснением давно не
+// использованных. Забирает image во владение
+static void insert_entry(
+    StageCache* cache,
+    const CacheKey* key,
+    BMPImage* image,
+    const RoiWindow* window
+) {
+    uint64_t bytes = image_bytes(image);
+
+    pthread_mutex_lock(&cache->lock);
+
+    // Та же стадия могла быть посчитана параллельно
+    if (find_entry(cache, key) >= 0) {
+        pthread_mutex_unlock(&cache->lock);
+        bmp_free(image);
+        return;
+    }
+
+    while (cache->count > 0 &&
+           cache->bytes + bytes > cache->memory_bytes) {
+        int oldest = 0;
+        for (int i = 1; i < cache->count; i++) {
+            if (cache->entries[i].used <
+                cache->entries[oldest].used) {
+                oldest = i;
+            }
+        }
+        cache->bytes -= cache->entries[oldest].bytes;
+        bmp_free(cache->entries[oldest].image);
+        cache->entries[oldest] = cache->entries[--cache->count];
+    }
+
+    if (cache->count == cache->capacity) {
+        int capacity =
+            cache->capacity ? cache->capacity * 2 : 16;
+        StageEntry* grown = (StageEntry*)realloc(
+            cache->entries,
+            capacity * sizeof(StageEntry)
+        );
+        if (!grown) {
+            pthread_mutex_unlock(&cache->lock);
+            bmp_free(image);
+            return;
+        }
+        cache->entries = grown;
+        cache->capacity = capacity;
+    }
+
+    StageEntry* entry = &cache->entries[cache->count++];
+    entry->key = *key;
+    entry->image = image;
+    entry->window = *window;
+    entry->bytes = bytes;
+    entry->used = ++cache->clock;
+    cache->bytes += bytes;
+
+    pthread_mutex_unlock(&cache->lock);
+}
+
+static void write_int(uint8_t* p, int32_t value) {
+    uint32_t bits = (uint32_t)value;
+    for (int i = 0; i < 4; i++) {
+        p[i] = (uint8_t)(bits >> (8 * i));
+    }
+}
+
+static int32_t read_int(const uint8_t* p) {
+    return (int32_t)((uint32_t)p[0] | (uint32_t)p[1] << 8 |
+                     (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+}
+
+// Чтение записи с диска
+static BMPImage* load_entry(
+    const StageCache* cache,
+    const CacheKey* key,
+    RoiWindow* window
+) {
+    uint8_t* data;
+    size_t size;
+    if (cache_read(cache->directory, key, &data, &size) != 0) {
+        return NULL;
+    }
+
+    BMPImage* image = NULL;
+    if (size > STAGE_TRAILER_SIZE &&
+        memcmp(
+            data + size - STAGE_TRAILER_SIZE,
+            STAGE_TRAILER_MAGIC,
+            4
+        ) == 0) {
+        const uint8_t* trailer = data + size - STAGE_TRAILER_SIZE;
+        image = bmp_decode(data, size - STAGE_TRAILER_SIZE);
+        window->x = read_int(trailer + 4);
+        window->y = read_int(trailer + 8);
+        window->frame_width = read_int(trailer + 12);
+        window->frame_height = read_int(trailer + 16);
+    }
+
+    free(data);
+    return image;
+}
+
+// Запись на диск: BMP и окно в конце файла
+static void save_entry(
+    const StageCache* cache,
+    const CacheKey* key,
+    const BMPImage* image,
+    const RoiWindow* window
+) {
+    uint8_t* data;
+    size_t size;
+    if (bmp_encode(image, &data, &size) != ALL_OK) {
+        return;
+    }
+
+    uint8_t* grown =
+        (uint8_t*)realloc(data, size + STAGE_TRAILER_SIZE);
+    if (!grown) {
+        free(data);
+        return;
+    }
+    data = grown;
+
+    uint8_t* trailer = data + size;
+    memcpy(trailer, STAGE_TRAILER_MAGIC, 4);
+    write_int(trailer + 4, window->x);
+    write_int(trailer + 8, window->y);
+    write_int(trailer + 12, window->frame_width);
+    write_int(trailer + 16, window->frame_height);
+
+    cache_write(
+        cache->directory,
+        key,
+        data,
+        size + STAGE_TRAILER_SIZE,
+        cache->disk_bytes
+    );
+    free(data);
+}
+
+BMPImage* stage_cache_lookup(
+    StageCache* cache,
+    const CacheKey* key,
+    RoiWindow* window
+) {
+    if (!cache) {
+        return NULL;
+    }
+
+    // Копия снимается под блокировкой, чтобы запись не вытеснили
+    // во время копирования
+    pthread_mutex_lock(&cache->lock);
+    int index = find_entry(cache, key);
+    if (index >= 0) {
+        StageEntry* entry = &cache->entries[index];
+        entry->used = ++cache->clock;
+        *window = entry->window;
+        BMPImage* copy = bmp_copy(entry->image);
+        pthread_mutex_unlock(&cache->lock);
+        return copy;
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    if (!cache->directory) {
+        return NULL;
+    }
+
+    BMPImage* image = load_entry(cache, key, window);
+    if (image && cache->memory_bytes > 0) {
+        BMPImage* copy = bmp_copy(image);
+        if (copy) {
+            insert_entry(cache, key, copy, window);
+        }
+    }
+    return image;
+}
+
+void stage_cache_store(
+    StageCache* cache,
+    const CacheKey* key,
+    const BMPImage* image,
+    const RoiWindow* window
+) {
+    if (!cache) {
+        return;
+    }
+
+    if (image_bytes(image) <= cache->memory_bytes) {
+        BMPImage* copy = bmp_copy(image);
+        if (copy) {
+            insert_entry(cache, key, copy, window);
+        }
+    }
+
+    if (cache->directory) {
+        save_entry(cache, key, image, window);
+    }
+}
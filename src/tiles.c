@@ -0,0 +1,406 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "defines.h"
+#include "pool.h"
+#include "roi.h"
+#include "tiles.h"
+#include "trace.h"
+
+// Длина отрезка цепочки для выполнения по тайлам
+int tiles_segment_length(const Filter* start, int parallel) {
+    int length = 0;
+    int computing = 0;
+    int neighborhood = 0;
+
+    for (const Filter* f = start; f; f = f->next) {
+        const FilterDescriptor* descriptor =
+            filter_registry_get(f->type);
+
+        // Глобальный фильтр требует целого кадра
+        if (!descriptor || descriptor->kind == FILTER_KIND_GLOBAL) {
+            break;
+        }
+
+        length++;
+        if (!descriptor->resizes) {
+            computing++;
+        }
+        if (descriptor->kind == FILTER_KIND_NEIGHBORHOOD) {
+            neighborhood++;
+        }
+    }
+
+    // При нескольких потоках тайлы - это ещё и единицы работы
+    // для планировщика, поэтому подходит любая вычисляющая стадия
+    if (parallel) {
+        return computing >= 1 ? length : 0;
+    }
+
+    return computing >= 2 && neighborhood >= 1 ? length : 0;
+}
+
+// Копирование изображения в буфер той же ориентации
+static int copy_into(const BMPImage* src, BMPImage* dst) {
+    int32_t width = src->info_header.width;
+    int32_t height = src->info_header.height;
+    int32_t abs_height = height < 0 ? -height : height;
+
+    dst->file_header = src->file_header;
+    dst->info_header = src->info_header;
+    if (bmp_reshape(dst, width, height) != ALL_OK) {
+        return 1;
+    }
+
+    for (int32_t i = 0; i < abs_height; i++) {
+        memcpy(
+            dst->pixels[i],
+            src->pixels[i],
+            width * sizeof(RGBPixel)
+        );
+    }
+    return 0;
+}
+
+// Прогон одного тайла через все стадии. needs[k] - область
+// кадра входа стадии k, нужная для тайла (needs[count] - сам
+// тайл). Результат - представление view, покрывающее тайл
+static int run_tile(
+    const BMPImage* input,
+    const TileStage* stages,
+    int count,
+    const BMPRegion* needs,
+    BMPImage* buffers[2],
+    RGBPixel** rows,
+    BMPImage* view,
+    const BMPImage** result
+) {
+    bmp_borrow_view(view, rows, input, &needs[0]);
+    BMPImage* current = view;
+    int owner = -1; // Буфер, в котором лежит current (-1 - вход)
+
+    for (int k = 0; k < count; k++) {
+        const TileStage* stage = &stages[k];
+        const FilterDescriptor* descriptor = stage->descriptor;
+
+        // Обрезка - это сдвиг представления внутри буфера
+        if (descriptor->resizes) {
+            BMPRegion region = {
+                needs[k + 1].x + stage->crop.x - needs[k].x,
+                needs[k + 1].y + stage->crop.y - needs[k].y,
+                needs[k + 1].width,
+                needs[k + 1].height
+            };
+            bmp_borrow_view(view, rows, current, &region);
+            current = view;
+            continue;
+        }
+
+        // Вход общий для всех тайлов, поэтому перед изменением на
+        // месте он копируется в буфер тайла
+        if (descriptor->in_place) {
+            if (owner < 0) {
+                if (copy_into(current, buffers[0]) != 0) {
+                    return 1;
+                }
+                current = buffers[0];
+                owner = 0;
+            }
+
+            if (descriptor->apply_in_place(current, stage->filter)) {
+                return 1;
+            }
+            continue;
+        }
+
+        int target = owner == 0 ? 1 : 0;
+        if (descriptor->apply(
+                current,
+                buffers[target],
+                stage->filter,
+                NULL
+            )) {
+            return 1;
+        }
+
+        // Дальше нужна только область следующей стадии, края
+        // буфера с неточной обработкой границ отбрасываются
+        BMPRegion region = { needs[k + 1].x - needs[k].x,
+                             needs[k + 1].y - needs[k].y,
+                             needs[k + 1].width,
+                             needs[k + 1].height };
+        bmp_borrow_view(view, rows, buffers[target], &region);
+        current = view;
+        owner = target;
+    }
+
+    *result = current;
+    return 0;
+}
+
+// Рабочие буферы тайла, свои у каждого рабочего потока
+typedef struct {
+    BMPImage* buffers[2];
+    RGBPixel** rows;
+    BMPRegion* needs;
+    BMPImage view;
+} TileWorkspace;
+
+// Общие данные задач-тайлов
+typedef struct {
+    const BMPImage* input;
+    const TileStage* stages;
+    int count;
+    const BMPRegion* frames;
+    int tile_size;
+    int32_t tiles_x;
+    int32_t buffer_width;
+    int32_t buffer_height;
+    BMPImage* output;
+    TileWorkspace* workspaces;
+    int error;
+} TileJob;
+
+// Задача планировщика: один тайл результата
+static void tile_task(void* context, int index, int worker) {
+    TileJob* job = (TileJob*)context;
+    if (__atomic_load_n(&job->error, __ATOMIC_RELAXED)) {
+        return;
+    }
+
+    int64_t start = trace_begin();
+    const TileStage* stages = job->stages;
+    int count = job->count;
+    const BMPRegion* frames = job->frames;
+    TileWorkspace* workspace = &job->workspaces[worker];
+
+    // Буферы создаются при первом тайле рабочего потока. Они
+    // переживают задачу, поэтому берутся из пула, а не из арены
+    // потока
+    if (!workspace->needs) {
+        workspace->buffers[0] =
+            bmp_create(job->buffer_width, job->buffer_height);
+        workspace->buffers[1] =
+            bmp_create(job->buffer_width, job->buffer_height);
+        workspace->rows = (RGBPixel**)pool_acquire(
+            job->buffer_height * sizeof(RGBPixel*)
+        );
+        workspace->needs = (BMPRegion*)pool_acquire(
+            (count + 1) * sizeof(BMPRegion)
+        );
+
+        if (!workspace->buffers[0] || !workspace->buffers[1] ||
+            !workspace->rows || !workspace->needs) {
+            pool_release(
+                workspace->needs,
+                (count + 1) * sizeof(BMPRegion)
+            );
+            workspace->needs = NULL;
+            __atomic_store_n(&job->error, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+
+    BMPRegion* needs = workspace->needs;
+
+    int32_t tx = (index % job->tiles_x) * job->tile_size;
+    int32_t ty = (index / job->tiles_x) * job->tile_size;
+    int32_t out_width = frames[count].width;
+    int32_t out_height = frames[count].height;
+
+    // Обратный проход: какая область нужна каждой стадии
+    needs[count].x = tx;
+    needs[count].y = ty;
+    needs[count].width = out_width - tx < job->tile_size
+        ? out_width - tx
+        : job->tile_size;
+    needs[count].height = out_height - ty < job->tile_size
+        ? out_height - ty
+        : job->tile_size;
+
+    for (int k = count - 1; k >= 0; k--) {
+        needs[k] = needs[k + 1];
+        if (stages[k].descriptor->resizes) {
+            needs[k].x += stages[k].crop.x;
+            needs[k].y += stages[k].crop.y;
+        } else {
+            roi_grow_region(
+                &needs[k],
+                filter_radius(stages[k].filter),
+                frames[k].width,
+                frames[k].height
+            );
+        }
+    }
+
+    const BMPImage* tile = NULL;
+    if (run_tile(
+            job->input,
+            stages,
+            count,
+            needs,
+            workspace->buffers,
+            workspace->rows,
+            &workspace->view,
+            &tile
+        ) != 0) {
+        __atomic_store_n(&job->error, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    // Запись готового тайла в результат. Тайлы не пересекаются,
+    // поэтому потоки пишут в разные места
+    for (int32_t i = 0; i < needs[count].height; i++) {
+        memcpy(
+            job->output->pixels[ty + i] + tx,
+            tile->pixels[i],
+            needs[count].width * sizeof(RGBPixel)
+        );
+    }
+
+    trace_end("tile", start, index);
+}
+
+// Выполнение отрезка цепочки по тайлам
+int tiles_apply(
+    const BMPImage* input,
+    const TileStage* stages,
+    int count,
+    int tile_size,
+    Scheduler* scheduler,
+    BMPImage* output
+) {
+    if (!input || !stages || count <= 0 || !output ||
+        tile_size <= 0) {
+        return 1;
+    }
+
+    int32_t width = input->info_header.width;
+    int32_t height = input->info_header.height;
+    int32_t abs_height = height < 0 ? -height : height;
+
+    BMPRegion* frames = (BMPRegion*)scratch_alloc(
+        (count + 1) * sizeof(BMPRegion)
+    );
+    if (!frames) {
+        return 1;
+    }
+
+    // Размеры кадров стадий и суммарная ширина полей
+    BMPRegion full = { 0, 0, width, abs_height };
+    frames[0] = full;
+    int halo = 0;
+    for (int k = 0; k < count; k++) {
+        frames[k + 1] = frames[k];
+        if (stages[k].descriptor->resizes) {
+            frames[k + 1].width = stages[k].crop.width;
+            frames[k + 1].height = stages[k].crop.height;
+        } else {
+            halo += filter_radius(stages[k].filter);
+        }
+    }
+
+    int32_t out_width = frames[count].width;
+    int32_t out_height = frames[count].height;
+    int32_t tiles_x = (out_width + tile_size - 1) / tile_size;
+    int32_t tiles_y = (out_height + tile_size - 1) / tile_size;
+    int tiles = tiles_x * tiles_y;
+
+    // Буферы тайла вмещают тайл вместе с полями всех стадий
+    int32_t buffer_width = tile_size + 2 * halo;
+    int32_t buffer_height = tile_size + 2 * halo;
+    if (buffer_width > width) {
+        buffer_width = width;
+    }
+    if (buffer_height > abs_height) {
+        buffer_height = abs_height;
+    }
+
+    // Буферы по номеру рабочего потока: задачи могут попасть в
+    // любой поток планировщика
+    int workers = scheduler_workers(scheduler);
+    TileWorkspace* workspaces = (TileWorkspace*)scratch_calloc(
+        workers,
+        sizeof(TileWorkspace)
+    );
+    int error = !workspaces;
+
+    if (!error) {
+        output->file_header = input->file_header;
+        output->info_header = input->info_header;
+        error = bmp_reshape(
+                    output,
+                    out_width,
+                    height < 0 ? -out_height : out_height
+                ) != ALL_OK;
+    }
+
+    if (!error) {
+        TileJob job = { input,         stages,        count,
+                        frames,        tile_size,     tiles_x,
+                        buffer_width,  buffer_height, output,
+                        workspaces,    0 };
+
+        // Тайлы идут по строкам, поэтому соседние номера - это
+        // полоса результата, закрепленная за одним потоком
+        scheduler_parallel_bands(
+            scheduler,
+            tiles,
+            tile_task,
+            &job
+        );
+        error = job.error;
+    }
+
+    for (int w = 0; workspaces && w < workers; w++) {
+        bmp_free(workspaces[w].buffers[0]);
+        bmp_free(workspaces[w].buffers[1]);
+        pool_release(
+            workspaces[w].rows,
+            buffer_height * sizeof(RGBPixel*)
+        );
+        pool_release(
+            workspaces[w].needs,
+            (count + 1) * sizeof(BMPRegion)
+        );
+    }
+    scratch_free(workspaces);
+    scratch_free(frames);
+
+    return error;
+}
+
+// Полосы первого касания буфера
+typedef struct {
+    BMPImage* image;
+    int bands;
+} TouchJob;
+
+// Задача первого касания: обнуление одной полосы строк
+static void touch_task(void* context, int index, int worker) {
+    (void)worker;
+    TouchJob* job = (TouchJob*)context;
+    BMPImage* image = job->image;
+    int32_t width = image->info_header.width;
+    int32_t height = abs(image->info_header.height);
+
+    int32_t first =
+        (int32_t)((int64_t)index * height / job->bands);
+    int32_t last =
+        (int32_t)((int64_t)(index + 1) * height / job->bands);
+    for (int32_t row = first; row < last; row++) {
+        memset(image->pixels[row], 0, width * sizeof(RGBPixel));
+    }
+}
+
+// Первое касание буфера полосами
+void tiles_first_touch(BMPImage* image, Scheduler* scheduler) {
+    TouchJob job = { image, scheduler_workers(scheduler) };
+    scheduler_parallel_bands(
+        scheduler,
+        job.bands,
+        touch_task,
+        &job
+    );
+}
@@ -0,0 +1,243 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "trace.h"
+
+// Событий в буфере потока (степень двойки)
+#define TRACE_BUFFER_EVENTS (1 << 15)
+#define TRACE_NAME_SIZE 32
+
+typedef struct {
+    const char* name;
+    int64_t start;
+    int64_t duration;
+    int arg;
+} TraceEvent;
+
+// Буфер потока. events и written пишет только владелец
+typedef struct TraceBuffer {
+    TraceEvent* events;
+    uint64_t written;
+    int thread_id;
+    char thread_name[TRACE_NAME_SIZE];
+    struct TraceBuffer* next;
+} TraceBuffer;
+
+static int enabled;
+static unsigned int generation;
+static int64_t origin;
+
+// Список буферов всех потоков
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static TraceBuffer* buffers;
+static int thread_count;
+
+// Буфер текущего потока и поколение записи, к которому он
+// относится: после trace_stop буфер освобождён
+static __thread TraceBuffer* local_buffer;
+static __thread unsigned int local_generation;
+static __thread char local_name[TRACE_NAME_SIZE];
+
+static int64_t now_ns(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (int64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+// Буфер текущего потока, создаётся при первом событии
+static TraceBuffer* thread_buffer(void) {
+    unsigned int current =
+        __atomic_load_n(&generation, __ATOMIC_ACQUIRE);
+    if (local_buffer && local_generation == current) {
+        return local_buffer;
+    }
+
+    TraceBuffer* buffer =
+        (TraceBuffer*)calloc(1, sizeof(TraceBuffer));
+    if (!buffer) {
+        return NULL;
+    }
+    buffer->events = (TraceEvent*)malloc(
+        TRACE_BUFFER_EVENTS * sizeof(TraceEvent)
+    );
+    if (!buffer->events) {
+        free(buffer);
+        return NULL;
+    }
+    memcpy(buffer->thread_name, local_name, TRACE_NAME_SIZE);
+
+    pthread_mutex_lock(&registry_lock);
+    buffer->thread_id = ++thread_count;
+    buffer->next = buffers;
+    buffers = buffer;
+    pthread_mutex_unlock(&registry_lock);
+
+    local_buffer = buffer;
+    local_generation = current;
+    return buffer;
+}
+
+void trace_start(void) {
+    trace_stop();
+
+    origin = now_ns();
+    __atomic_store_n(&enabled, 1, __ATOMIC_RELEASE);
+}
+
+int64_t trace_begin(void) {
+    if (!__atomic_load_n(&enabled, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+    return now_ns();
+}
+
+void trace_end(const char* name, int64_t start, int arg) {
+    if (start == 0 ||
+        !__atomic_load_n(&enabled, __ATOMIC_RELAXED)) {
+        return;
+    }
+
+    int64_t end = now_ns();
+    TraceBuffer* buffer = thread_buffer();
+    if (!buffer) {
+        return;
+    }
+
+    uint64_t written = buffer->written;
+    TraceEvent* event =
+        &buffer->events[written & (TRACE_BUFFER_EVENTS - 1)];
+    event->name = name;
+    event->start = start;
+    event->duration = end - start;
+    event->arg = arg;
+    __atomic_store_n(
+        &buffer->written,
+        written + 1,
+        __ATOMIC_RELEASE
+    );
+}
+
+void trace_thread_name(const char* name) {
+    snprintf(local_name, sizeof(local_name), "%s", name);
+
+    if (local_buffer &&
+        local_generation ==
+            __atomic_load_n(&generation, __ATOMIC_ACQUIRE)) {
+        memcpy(
+            local_buffer->thread_name,
+            local_name,
+            TRACE_NAME_SIZE
+        );
+    }
+}
+
+// Вывод строки в JSON с экранированием
+static void write_json_string(FILE* file, const char* text) {
+    fputc('"', file);
+    for (const unsigned char* c = (const unsigned char*)text; *c;
+         c++) {
+        if (*c == '"' || *c == '\\') {
+            fprintf(file, "\\%c", *c);
+        } else if (*c < 0x20) {
+            fprintf(file, "\\u%04x", *c);
+        } else {
+            fputc(*c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+int trace_write(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        return 1;
+    }
+
+    pthread_mutex_lock(&registry_lock);
+
+    fprintf(file, "{\"traceEvents\": [\n");
+    int first = 1;
+    uint64_t dropped = 0;
+
+    for (TraceBuffer* buffer = buffers; buffer;
+         buffer = buffer->next) {
+        // Название потока - событие метаданных
+        fprintf(
+            file,
+            "%s{\"name\": \"thread_name\", \"ph\": \"M\", "
+            "\"pid\": 1, \"tid\": %d, \"args\": {\"name\": ",
+            first ? "" : ",\n",
+            buffer->thread_id
+        );
+        if (buffer->thread_name[0]) {
+            write_json_string(file, buffer->thread_name);
+        } else {
+            fprintf(file, "\"thread %d\"", buffer->thread_id);
+        }
+        fprintf(file, "}}");
+        first = 0;
+
+        // Из переполненного буфера выводятся последние события
+        uint64_t written =
+            __atomic_load_n(&buffer->written, __ATOMIC_ACQUIRE);
+        uint64_t begin = written > TRACE_BUFFER_EVENTS
+            ? written - TRACE_BUFFER_EVENTS
+            : 0;
+        dropped += begin;
+
+        for (uint64_t e = begin; e < written; e++) {
+            const TraceEvent* event =
+                &buffer->events[e & (TRACE_BUFFER_EVENTS - 1)];
+
+            fprintf(file, ",\n{\"name\": ");
+            write_json_string(file, event->name);
+            fprintf(
+                file,
+                ", \"cat\": \"imagecraft\", \"ph\": \"X\", "
+                "\"pid\": 1, \"tid\": %d, \"ts\": %.3f, "
+                "\"dur\": %.3f",
+                buffer->thread_id,
+                (event->start - origin) / 1000.0,
+                event->duration / 1000.0
+            );
+            if (event->arg >= 0) {
+                fprintf(
+                    file,
+                    ", \"args\": {\"index\": %d}",
+                    event->arg
+                );
+            }
+            fprintf(file, "}");
+        }
+    }
+
+    fprintf(
+        file,
+        "\n], \"displayTimeUnit\": \"ms\", \"otherData\": "
+        "{\"dropped_events\": %llu}}\n",
+        (unsigned long long)dropped
+    );
+
+    pthread_mutex_unlock(&registry_lock);
+    return fclose(file) != 0;
+}
+
+void trace_stop(void) {
+    __atomic_store_n(&enabled, 0, __ATOMIC_RELEASE);
+
+    pthread_mutex_lock(&registry_lock);
+    while (buffers) {
+        TraceBuffer* next = buffers->next;
+        free(buffers->events);
+        free(buffers);
+        buffers = next;
+    }
+    thread_count = 0;
+    __atomic_add_fetch(&generation, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&registry_lock);
+}
@@ -0,0 +1,460 @@
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "pool.h"
+#include "uring.h"
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#endif
+
+#ifdef IORING_RSRC_REGISTER_SPARSE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// Запросы цепочки слота. Код запроса хранится в младших битах
+// user_data, номер слота - в остальных
+enum { URING_OPEN, URING_TRANSFER, URING_CLOSE, URING_STEPS };
+
+// Состояние слота
+typedef struct {
+    int remaining; // Незавершенные запросы цепочки
+    int64_t error; // Ошибка открытия или 0
+    int64_t result; // Результат чтения или записи
+} UringSlot;
+
+struct _Uring {
+    int fd;
+    int depth;
+    size_t buffer_size;
+    int fixed_buffers; // Буферы зарегистрированы в кольце
+
+    // Очередь отправки
+    void* sq_ring;
+    size_t sq_ring_size;
+    unsigned* sq_tail;
+    unsigned sq_mask;
+    unsigned* sq_array;
+    struct io_uring_sqe* sqes;
+    size_t sqes_size;
+    unsigned tail; // Локальный хвост до отправки
+    unsigned pending; // Поставлено, но не отправлено
+
+    // Очередь завершений
+    void* cq_ring;
+    size_t cq_ring_size;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe* cqes;
+
+    UringSlot* slots;
+    uint8_t* buffers;
+};
+
+static int
+uring_setup(unsigned entries, struct io_uring_params* p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter(
+    int fd,
+    unsigned submit,
+    unsigned complete,
+    unsigned flags
+) {
+    return (int)syscall(
+        __NR_io_uring_enter,
+        fd,
+        submit,
+        complete,
+        flags,
+        NULL,
+        0
+    );
+}
+
+static int uring_register(
+    int fd,
+    unsigned opcode,
+    void* arg,
+    unsigned count
+) {
+    return (int)syscall(
+        __NR_io_uring_register,
+        fd,
+        opcode,
+        arg,
+        count
+    );
+}
+
+// Отображение очередей кольца. Возвращает 0 при успехе
+static int
+map_rings(Uring* ring, const struct io_uring_params* p) {
+    ring->sq_ring_size =
+        p->sq_off.array + p->sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = p->cq_off.cqes +
+        p->cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size =
+        p->sq_entries * sizeof(struct io_uring_sqe);
+
+    ring->sq_ring = mmap(
+        NULL,
+        ring->sq_ring_size,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE,
+        ring->fd,
+        IORING_OFF_SQ_RING
+    );
+    ring->cq_ring = mmap(
+        NULL,
+        ring->cq_ring_size,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE,
+        ring->fd,
+        IORING_OFF_CQ_RING
+    );
+    void* sqes = mmap(
+        NULL,
+        ring->sqes_size,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE,
+        ring->fd,
+        IORING_OFF_SQES
+    );
+    ring->sqes =
+        sqes == MAP_FAILED ? NULL : (struct io_uring_sqe*)sqes;
+    if (ring->sq_ring == MAP_FAILED) {
+        ring->sq_ring = NULL;
+    }
+    if (ring->cq_ring == MAP_FAILED) {
+        ring->cq_ring = NULL;
+    }
+    if (!ring->sq_ring || !ring->cq_ring || !ring->sqes) {
+        return 1;
+    }
+
+    uint8_t* sq = (uint8_t*)ring->sq_ring;
+    ring->sq_tail = (unsigned*)(sq + p->sq_off.tail);
+    ring->sq_mask = *(unsigned*)(sq + p->sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq + p->sq_off.array);
+    ring->tail = *ring->sq_tail;
+
+    uint8_t* cq = (uint8_t*)ring->cq_ring;
+    ring->cq_head = (unsigned*)(cq + p->cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + p->cq_off.tail);
+    ring->cq_mask = *(unsigned*)(cq + p->cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + p->cq_off.cqes);
+    return 0;
+}
+
+// Регистрация слотов файлов и буферов. Без слотов файлов (ядро
+// до 5.19) кольцо непригодно, без буферов - работает с
+// обычными чтением и записью. Возвращает 0 при успехе
+static int register_resources(Uring* ring) {
+    struct io_uring_rsrc_register files;
+    memset(&files, 0, sizeof(files));
+    files.nr = (unsigned)ring->depth;
+    files.flags = IORING_RSRC_REGISTER_SPARSE;
+    if (uring_register(
+            ring->fd,
+            IORING_REGISTER_FILES2,
+            &files,
+            sizeof(files)
+        ) != 0) {
+        return 1;
+    }
+
+    // Закрепление буферов упирается в RLIMIT_MEMLOCK на старых
+    // ядрах, тогда они остаются обычными
+    struct iovec* vectors = (struct iovec*)malloc(
+        ring->depth * sizeof(struct iovec)
+    );
+    if (vectors) {
+        for (int i = 0; i < ring->depth; i++) {
+            vectors[i].iov_base =
+                ring->buffers + (size_t)i * ring->buffer_size;
+            vectors[i].iov_len = ring->buffer_size;
+        }
+        ring->fixed_buffers = uring_register(
+                                  ring->fd,
+                                  IORING_REGISTER_BUFFERS,
+                                  vectors,
+                                  (unsigned)ring->depth
+                              ) == 0;
+        free(vectors);
+    }
+    return 0;
+}
+
+Uring* uring_create(int depth, size_t buffer_size) {
+    if (depth <= 0 || buffer_size == 0) {
+        return NULL;
+    }
+
+    Uring* ring = (Uring*)calloc(1, sizeof(Uring));
+    if (!ring) {
+        return NULL;
+    }
+    ring->fd = -1;
+    ring->depth = depth;
+    ring->buffer_size = buffer_size;
+
+    // Каждый слот ставит в очередь цепочку из URING_STEPS
+    // запросов
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring->fd =
+        uring_setup((unsigned)depth * URING_STEPS, &params);
+
+    ring->slots = (UringSlot*)calloc(depth, sizeof(UringSlot));
+    ring->buffers =
+        (uint8_t*)pool_acquire((size_t)depth * buffer_size);
+    if (ring->fd < 0 || !ring->slots || !ring->buffers ||
+        map_rings(ring, &params) != 0 ||
+        register_resources(ring) != 0) {
+        uring_destroy(ring);
+        return NULL;
+    }
+    return ring;
+}
+
+void uring_destroy(Uring* ring) {
+    if (!ring) {
+        return;
+    }
+
+    // Закрытие кольца отменяет запросы и освобождает слоты
+    // файлов, поэтому буферы возвращаются после него
+    if (ring->fd >= 0) {
+        close(ring->fd);
+    }
+    if (ring->sqes) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_ring) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    if (ring->sq_ring) {
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    }
+    pool_release(
+        ring->buffers,
+        (size_t)ring->depth * ring->buffer_size
+    );
+    free(ring->slots);
+    free(ring);
+}
+
+uint8_t* uring_buffer(Uring* ring, int slot) {
+    return ring->buffers + (size_t)slot * ring->buffer_size;
+}
+
+// Следующий свободный элемент очереди отправки. Слот ставит не
+// больше одной цепочки, поэтому очередь не переполняется
+static struct io_uring_sqe*
+next_sqe(Uring* ring, int slot, int step, unsigned flags) {
+    unsigned index = ring->tail & ring->sq_mask;
+    struct io_uring_sqe* sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->flags = (uint8_t)flags;
+    sqe->user_data = (uint64_t)slot * URING_STEPS + step;
+
+    ring->sq_array[index] = index;
+    ring->tail++;
+    ring->pending++;
+    return sqe;
+}
+
+// Цепочка открытие -> чтение или запись -> закрытие. Ошибка
+// открытия отменяет остальное. Закрытие связано жестко и
+// выполняется и после неполного чтения или записи
+static void queue_chain(
+    Uring* ring,
+    int slot,
+    const char* path,
+    int flags,
+    int write,
+    size_t size
+) {
+    UringSlot* state = &ring->slots[slot];
+    state->remaining = URING_STEPS;
+    state->error = 0;
+    state->result = 0;
+
+    struct io_uring_sqe* sqe =
+        next_sqe(ring, slot, URING_OPEN, IOSQE_IO_LINK);
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (uint64_t)(uintptr_t)path;
+    sqe->len = 0666;
+    sqe->open_flags = (uint32_t)flags;
+    sqe->file_index = (uint32_t)slot + 1;
+
+    sqe = next_sqe(
+        ring,
+        slot,
+        URING_TRANSFER,
+        IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK
+    );
+    if (ring->fixed_buffers) {
+        sqe->opcode =
+            write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+        sqe->buf_index = (uint16_t)slot;
+    } else {
+        sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+    }
+    sqe->fd = slot;
+    sqe->addr = (uint64_t)(uintptr_t)uring_buffer(ring, slot);
+    sqe->len = (uint32_t)size;
+    sqe->off = 0;
+
+    sqe = next_sqe(ring, slot, URING_CLOSE, 0);
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->file_index = (uint32_t)slot + 1;
+}
+
+void uring_queue_read(Uring* ring, int slot, const char* path) {
+    queue_chain(
+        ring,
+        slot,
+        path,
+        O_RDONLY,
+        0,
+        ring->buffer_size
+    );
+}
+
+void uring_queue_write(
+    Uring* ring,
+    int slot,
+    const char* path,
+    size_t size
+) {
+    queue_chain(
+        ring,
+        slot,
+        path,
+        O_WRONLY | O_CREAT | O_TRUNC,
+        1,
+        size
+    );
+}
+
+// Разбор готовых завершений. Возвращает их число
+static int reap(Uring* ring) {
+    unsigned head = *ring->cq_head;
+    unsigned tail =
+        __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    int count = 0;
+
+    for (; head != tail; head++, count++) {
+        struct io_uring_cqe* cqe =
+            &ring->cqes[head & ring->cq_mask];
+        UringSlot* slot =
+            &ring->slots[cqe->user_data / URING_STEPS];
+        int step = (int)(cqe->user_data % URING_STEPS);
+
+        if (step == URING_OPEN && cqe->res < 0) {
+            slot->error = cqe->res;
+        } else if (step == URING_TRANSFER) {
+            slot->result = cqe->res;
+        }
+        slot->remaining--;
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    return count;
+}
+
+int64_t uring_wait(Uring* ring, int slot) {
+    UringSlot* state = &ring->slots[slot];
+
+    // Поставленные элементы становятся видны ядру вместе с
+    // хвостом
+    if (ring->pending) {
+        __atomic_store_n(
+            ring->sq_tail,
+            ring->tail,
+            __ATOMIC_RELEASE
+        );
+    }
+
+    while (state->remaining > 0) {
+        reap(ring);
+        if (state->remaining == 0) {
+            break;
+        }
+
+        unsigned submit = ring->pending;
+        int entered = uring_enter(
+            ring->fd,
+            submit,
+            1,
+            IORING_ENTER_GETEVENTS
+        );
+        if (entered < 0 && errno != EINTR && errno != EAGAIN &&
+            errno != EBUSY) {
+            // Кольцо неработоспособно: слот считается
+            // неудавшимся, его запросы отменит закрытие кольца
+            state->remaining = 0;
+            return -errno;
+        }
+        if (entered > 0) {
+            ring->pending -= (unsigned)entered;
+        }
+    }
+
+    return state->error ? state->error : state->result;
+}
+
+#else
+
+Uring* uring_create(int depth, size_t buffer_size) {
+    (void)depth;
+    (void)buffer_size;
+    return NULL;
+}
+
+void uring_destroy(Uring* ring) {
+    (void)ring;
+}
+
+uint8_t* uring_buffer(Uring* ring, int slot) {
+    (void)ring;
+    (void)slot;
+    return NULL;
+}
+
+void uring_queue_read(Uring* ring, int slot, const char* path) {
+    (void)ring;
+    (void)slot;
+    (void)path;
+}
+
+void uring_queue_write(
+    Uring* ring,
+    int slot,
+    const char* path,
+    size_t size
+) {
+    (void)ring;
+    (void)slot;
+    (void)path;
+    (void)size;
+}
+
+int64_t uring_wait(Uring* ring, int slot) {
+    (void)ring;
+    (void)slot;
+    return -1;
+}
+
+#endif // IORING_RSRC_REGISTER_SPARSE
@@ -0,0 +1,759 @@
+#define _POSIX_C_SOURCE 200809L
+
+// Набор замеров производительности imagecraft. Генерирует
+// синтетические изображения, замеряет каждый фильтр, типичную
+// цепочку, загрузку и сохранение с прогревом и повторами и
+// записывает медиану, p95 и контрольные суммы результатов в JSON.
+// Собирается и запускается через make bench
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef _WIN32
+#include <sys/utsname.h>
+#include <unistd.h>
+#endif
+
+#include "bmp.h"
+#include "defines.h"
+#include "execution.h"
+#include "libimagecraft.h"
+#include "scheduler.h"
+
+#define BENCH_VERSION 1
+#define BENCH_MAX_SIZES 16
+#define BENCH_TEMP_FILE "imagecraft_bench.bmp"
+
+// Фильтры по отдельности и типичная цепочка, которая
+// выполняется по тайлам
+static const char* const bench_chains[] = {
+    "-gs",          "-neg",         "-sharp",
+    "-edge 0.2",    "-blur 2",      "-med 5",
+    "-crystal 5 10 40",             "-crop 64 64 128 128",
+    "-blur 2 -med 3 -gs"
+};
+#define BENCH_CHAIN_COUNT                                       \
+    (int)(sizeof(bench_chains) / sizeof(bench_chains[0]))
+
+// Виды синтетических изображений
+typedef enum {
+    PATTERN_NOISE,
+    PATTERN_GRADIENT,
+    PATTERN_PHOTO,
+    PATTERN_COUNT
+} Pattern;
+
+static const char* const pattern_names[PATTERN_COUNT] = {
+    "noise",
+    "gradient",
+    "photo"
+};
+
+// Параметры запуска
+typedef struct {
+    int sizes[BENCH_MAX_SIZES];
+    int size_count;
+    int patterns[PATTERN_COUNT]; // Включенные виды изображений
+    const char* filter; // Замерять только цепочки с этой
+                        // подстрокой (NULL - все)
+    int repeat;         // Повторов на замер
+    int warmup;         // Прогревочных запусков
+    double budget_ms; // Предел времени замера: после него
+                      // повторы прекращаются (не меньше трех)
+    int threads;
+    const char* output;
+    const char* workdir;
+} BenchConfig;
+
+// Результат одного замера
+typedef struct {
+    const char* kind; // "filter", "load" или "save"
+    const char* name;
+    Pattern pattern;
+    int size;
+    int runs;
+    double median_ms;
+    double p95_ms;
+    double min_ms;
+    double max_ms;
+    double mean_ms;
+    double stddev_ms;
+    uint64_t checksum; // Контрольная сумма результата
+} BenchResult;
+
+static double now_ms(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+}
+
+// ==================== ИЗОБРАЖЕНИЯ ====================
+
+// Генератор xorshift: изображения одинаковы от запуска к запуску
+static uint32_t next_random(uint32_t* state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static uint8_t clamp_byte(float value) {
+    return value < 0.0f ? 0
+        : value > 255.0f ? 255
+                         : (uint8_t)value;
+}
+
+// Синтетическое изображение size x size
+static BMPImage* generate_image(Pattern pattern, int size) {
+    BMPImage* image = bmp_create(size, size);
+    if (!image) {
+        return NULL;
+    }
+
+    uint32_t random = 2463534242u;
+    float scale = 1.0f / size;
+
+    for (int y = 0; y < size; y++) {
+        RGBPixel* row = image->pixels[y];
+
+        for (int x = 0; x < size; x++) {
+            RGBPixel* pixel = &row[x];
+
+            if (pattern == PATTERN_NOISE) {
+                uint32_t value = next_random(&random);
+                pixel->red = (uint8_t)value;
+                pixel->green = (uint8_t)(value >> 8);
+                pixel->blue = (uint8_t)(value >> 16);
+            } else if (pattern == PATTERN_GRADIENT) {
+                pixel->red = (uint8_t)(x * 255 / size);
+                pixel->green = (uint8_t)(y * 255 / size);
+                pixel->blue =
+                    (uint8_t)((x + y) * 255 / (2 * size));
+            } else {
+                // Похоже на фотографию: плавные пятна, резкие
+                // границы объектов и немного шума сенсора
+                float u = x * scale;
+                float v = y * scale;
+                float light = 120.0f + 60.0f * sinf(u * 7.0f) *
+                        cosf(v * 5.0f) +
+                    40.0f * sinf((u + v) * 13.0f);
+                int cell = x / (size / 8 + 1) + y / (size / 6 + 1);
+                int inside = cell % 3 == 0;
+                float noise =
+                    (float)(next_random(&random) % 17) - 8.0f;
+
+                pixel->red = clamp_byte(
+                    light + (inside ? 50.0f : -20.0f) + noise
+                );
+                pixel->green = clamp_byte(light * 0.9f + noise);
+                pixel->blue = clamp_byte(
+                    light * 0.7f + (inside ? -30.0f : 30.0f) +
+                    noise
+                );
+            }
+        }
+    }
+
+    return image;
+}
+
+// Контрольная сумма FNV-1a 64
+static uint64_t checksum_bytes(
+    uint64_t hash,
+    const void* data,
+    size_t size
+) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+#define CHECKSUM_SEED 14695981039346656037ull
+
+// Контрольная сумма размеров и пикселей изображения
+static uint64_t checksum_image(const BMPImage* image) {
+    int32_t width = image->info_header.width;
+    int32_t height = abs(image->info_header.height);
+
+    uint64_t hash = CHECKSUM_SEED;
+    hash = checksum_bytes(hash, &width, sizeof(width));
+    hash = checksum_bytes(hash, &height, sizeof(height));
+    for (int32_t y = 0; y < height; y++) {
+        hash = checksum_bytes(
+            hash,
+            image->pixels[y],
+            width * sizeof(RGBPixel)
+        );
+    }
+    return hash;
+}
+
+// Контрольная сумма содержимого файла
+static uint64_t checksum_file(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return 0;
+    }
+
+    uint64_t hash = CHECKSUM_SEED;
+    uint8_t buffer[65536];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        hash = checksum_bytes(hash, buffer, read);
+    }
+
+    fclose(file);
+    return hash;
+}
+
+// ==================== ЗАМЕРЫ ====================
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Статистика по времени повторов
+static void compute_statistics(
+    BenchResult* result,
+    double* times,
+    int runs
+) {
+    qsort(times, runs, sizeof(double), compare_doubles);
+
+    double sum = 0.0;
+    for (int r = 0; r < runs; r++) {
+        sum += times[r];
+    }
+    double mean = sum / runs;
+
+    double variance = 0.0;
+    for (int r = 0; r < runs; r++) {
+        variance += (times[r] - mean) * (times[r] - mean);
+    }
+
+    int p95 = (int)ceil(0.95 * runs) - 1;
+    result->runs = runs;
+    result->median_ms = runs % 2
+        ? times[runs / 2]
+        : (times[runs / 2 - 1] + times[runs / 2]) / 2.0;
+    result->p95_ms = times[p95 < 0 ? 0 : p95];
+    result->min_ms = times[0];
+    result->max_ms = times[runs - 1];
+    result->mean_ms = mean;
+    result->stddev_ms =
+        runs > 1 ? sqrt(variance / (runs - 1)) : 0.0;
+}
+
+// Замеряемая операция. Возвращает время в мс или отрицательное
+// значение при ошибке, *checksum - контрольная сумма результата
+typedef double (*BenchOperation)(void* context, uint64_t* checksum);
+
+// Прогрев и повторы операции
+static int measure(
+    const BenchConfig* config,
+    BenchOperation operation,
+    void* context,
+    BenchResult* result
+) {
+    for (int w = 0; w < config->warmup; w++) {
+        uint64_t checksum;
+        if (operation(context, &checksum) < 0.0) {
+            return 1;
+        }
+    }
+
+    double* times = (double*)malloc(config->repeat * sizeof(double));
+    if (!times) {
+        return 1;
+    }
+
+    int runs = 0;
+    double total = 0.0;
+    while (runs < config->repeat) {
+        double time = operation(context, &result->checksum);
+        if (time < 0.0) {
+            free(times);
+            return 1;
+        }
+
+        times[runs++] = time;
+        total += time;
+        if (runs >= 3 && total > config->budget_ms) {
+            break;
+        }
+    }
+
+    compute_statistics(result, times, runs);
+    free(times);
+    return 0;
+}
+
+// Применение цепочки к копии входного изображения
+typedef struct {
+    const BMPImage* input;
+    Filter* chain;
+    const Execution* execution;
+} FilterContext;
+
+static double run_filter(void* context, uint64_t* checksum) {
+    FilterContext* job = (FilterContext*)context;
+
+    BMPImage* image = bmp_copy(job->input);
+    if (!image) {
+        return -1.0;
+    }
+
+    double start = now_ms();
+    int error = imagecraft_apply(&image, job->chain, job->execution);
+    double time = now_ms() - start;
+
+    if (error != ALL_OK) {
+        bmp_free(image);
+        return -1.0;
+    }
+
+    *checksum = checksum_image(image);
+    bmp_free(image);
+    return time;
+}
+
+// Загрузка и сохранение через временный файл
+typedef struct {
+    BMPImage* image;
+    const char* path;
+} FileContext;
+
+static double run_save(void* context, uint64_t* checksum) {
+    FileContext* job = (FileContext*)context;
+
+    double start = now_ms();
+    int error = bmp_save(job->image, job->path);
+    double time = now_ms() - start;
+
+    if (error != ALL_OK) {
+        return -1.0;
+    }
+    *checksum = checksum_file(job->path);
+    return time;
+}
+
+static double run_load(void* context, uint64_t* checksum) {
+    FileContext* job = (FileContext*)context;
+
+    double start = now_ms();
+    BMPImage* image = bmp_load(job->path);
+    double time = now_ms() - start;
+
+    if (!image) {
+        return -1.0;
+    }
+    *checksum = checksum_image(image);
+    bmp_free(image);
+    return time;
+}
+
+// ==================== ОТЧЕТ ====================
+
+static void print_result(const BenchResult* result) {
+    double pixels = (double)result->size * result->size;
+    printf(
+        "[Bench] %-6s %-22s %-8s %5dx%-5d median %10.3f мс  "
+        "p95 %10.3f мс  %9.2f Мпикс/с\n",
+        result->kind,
+        result->name,
+        pattern_names[result->pattern],
+        result->size,
+        result->size,
+        result->median_ms,
+        result->p95_ms,
+        result->median_ms > 0.0
+            ? pixels / (result->median_ms * 1000.0)
+            : 0.0
+    );
+}
+
+// Сведения о машине для сравнения результатов между машинами
+static void write_machine(FILE* file, const BenchConfig* config) {
+    char host[128] = "unknown";
+    char system[256] = "unknown";
+    long cpus = 1;
+
+#ifndef _WIN32
+    struct utsname name;
+    if (uname(&name) == 0) {
+        snprintf(host, sizeof(host), "%s", name.nodename);
+        snprintf(
+            system,
+            sizeof(system),
+            "%s %s %s",
+            name.sysname,
+            name.release,
+            name.machine
+        );
+    }
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    snprintf(system, sizeof(system), "Windows");
+#endif
+
+    time_t now = time(NULL);
+    char timestamp[64];
+    strftime(
+        timestamp,
+        sizeof(timestamp),
+        "%Y-%m-%dT%H:%M:%SZ",
+        gmtime(&now)
+    );
+
+    fprintf(
+        file,
+        "  \"version\": %d,\n  \"timestamp\": \"%s\",\n"
+        "  \"machine\": {\"host\": \"%s\", \"system\": \"%s\", "
+        "\"cpus\": %ld},\n"
+        "  \"config\": {\"repeat\": %d, \"warmup\": %d, "
+        "\"threads\": %d, \"budget_ms\": %.0f},\n",
+        BENCH_VERSION,
+        timestamp,
+        host,
+        system,
+        cpus,
+        config->repeat,
+        config->warmup,
+        config->threads,
+        config->budget_ms
+    );
+}
+
+static int write_results(
+    const BenchConfig* config,
+    const BenchResult* results,
+    int count
+) {
+    FILE* file = fopen(config->output, "w");
+    if (!file) {
+        return 1;
+    }
+
+    fprintf(file, "{\n");
+    write_machine(file, config);
+    fprintf(file, "  \"results\": [\n");
+
+    for (int r = 0; r < count; r++) {
+        const BenchResult* result = &results[r];
+        double pixels = (double)result->size * result->size;
+
+        fprintf(
+            file,
+            "    {\"kind\": \"%s\", \"name\": \"%s\", "
+            "\"pattern\": \"%s\", \"width\": %d, \"height\": %d, "
+            "\"runs\": %d, \"median_ms\": %.4f, \"p95_ms\": %.4f, "
+            "\"min_ms\": %.4f, \"max_ms\": %.4f, "
+            "\"mean_ms\": %.4f, \"stddev_ms\": %.4f, "
+            "\"megapixels_per_second\": %.3f, "
+            "\"checksum\": \"%016llx\"}%s\n",
+            result->kind,
+            result->name,
+            pattern_names[result->pattern],
+            result->size,
+            result->size,
+            result->runs,
+            result->median_ms,
+            result->p95_ms,
+            result->min_ms,
+            result->max_ms,
+            result->mean_ms,
+            result->stddev_ms,
+            result->median_ms > 0.0
+                ? pixels / (result->median_ms * 1000.0)
+                : 0.0,
+            (unsigned long long)result->checksum,
+            r + 1 < count ? "," : ""
+        );
+    }
+
+    fprintf(file, "  ]\n}\n");
+    return fclose(file) != 0;
+}
+
+// ==================== ЗАПУСК ====================
+
+static void print_usage(void) {
+    printf(
+        "Использование: imagecraft_bench [-sizes 256,1024] "
+        "[-patterns noise,gradient,photo]\n"
+        "                        [-filter подстрока] [-repeat N] "
+        "[-warmup N] [-budget мс]\n"
+        "                        [-threads N] [-output файл.json] "
+        "[-workdir директория]\n"
+    );
+}
+
+// Разбор списка размеров через запятую
+static int parse_sizes(const char* text, BenchConfig* config) {
+    config->size_count = 0;
+
+    while (*text) {
+        char* end;
+        long size = strtol(text, &end, 10);
+        if (end == text || size < 16 || size > 65536 ||
+            config->size_count == BENCH_MAX_SIZES) {
+            return 1;
+        }
+
+        config->sizes[config->size_count++] = (int)size;
+        text = *end == ',' ? end + 1 : end;
+        if (*end && *end != ',') {
+            return 1;
+        }
+    }
+
+    return config->size_count == 0;
+}
+
+// Разбор списка видов изображений через запятую
+static int parse_patterns(const char* text, BenchConfig* config) {
+    memset(config->patterns, 0, sizeof(config->patterns));
+
+    int found = 0;
+    for (int p = 0; p < PATTERN_COUNT; p++) {
+        const char* name = pattern_names[p];
+        const char* match = strstr(text, name);
+        size_t length = strlen(name);
+
+        if (match && (match == text || match[-1] == ',') &&
+            (match[length] == '\0' || match[length] == ',')) {
+            config->patterns[p] = 1;
+            found++;
+        }
+    }
+
+    return found == 0;
+}
+
+static int parse_config(int argc, char** argv, BenchConfig* config) {
+    static const int default_sizes[] = { 256, 1024 };
+
+    memset(config, 0, sizeof(*config));
+    memcpy(config->sizes, default_sizes, sizeof(default_sizes));
+    config->size_count = 2;
+    for (int p = 0; p < PATTERN_COUNT; p++) {
+        config->patterns[p] = 1;
+    }
+    config->repeat = 5;
+    config->warmup = 1;
+    config->budget_ms = 10000.0;
+    config->output = "bench.json";
+    config->workdir = ".";
+
+    for (int i = 1; i < argc; i++) {
+        const char* option = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(option, "-help") == 0) {
+            print_usage();
+            exit(0);
+        }
+        if (!value) {
+            return 1;
+        }
+        i++;
+
+        if (strcmp(option, "-sizes") == 0) {
+            if (parse_sizes(value, config) != 0) {
+                return 1;
+            }
+        } else if (strcmp(option, "-patterns") == 0) {
+            if (parse_patterns(value, config) != 0) {
+                return 1;
+            }
+        } else if (strcmp(option, "-filter") == 0) {
+            config->filter = value;
+        } else if (strcmp(option, "-repeat") == 0) {
+            config->repeat = atoi(value);
+        } else if (strcmp(option, "-warmup") == 0) {
+            config->warmup = atoi(value);
+        } else if (strcmp(option, "-budget") == 0) {
+            config->budget_ms = atof(value);
+        } else if (strcmp(option, "-threads") == 0) {
+            config->threads = atoi(value);
+        } else if (strcmp(option, "-output") == 0) {
+            config->output = value;
+        } else if (strcmp(option, "-workdir") == 0) {
+            config->workdir = value;
+        } else {
+            return 1;
+        }
+    }
+
+    return config->repeat < 1 || config->warmup < 0 ||
+        config->threads < 0;
+}
+
+// Замеры одного изображения: загрузка, сохранение и цепочки
+static int bench_image(
+    const BenchConfig* config,
+    Pattern pattern,
+    int size,
+    Filter** chains,
+    const Execution* execution,
+    BenchResult* results,
+    int* count
+) {
+    BMPImage* image = generate_image(pattern, size);
+    if (!image) {
+        fprintf(
+            stderr,
+            "[Error] Не удалось создать изображение %dx%d\n",
+            size,
+            size
+        );
+        return 1;
+    }
+
+    char path[1024];
+    snprintf(
+        path,
+        sizeof(path),
+        "%s%s%s",
+        config->workdir,
+        SLASH,
+        BENCH_TEMP_FILE
+    );
+
+    int error = 0;
+    BenchResult base = { NULL, NULL, pattern, size, 0, 0, 0,
+                         0,    0,    0,       0,    0 };
+
+    // Сохранение первым: загрузка читает его результат
+    if (!config->filter) {
+        FileContext file = { image, path };
+        BenchResult* save = &results[(*count)];
+        *save = base;
+        save->kind = "save";
+        save->name = "bmp_save";
+        error = measure(config, run_save, &file, save);
+
+        BenchResult* load = &results[(*count) + 1];
+        *load = base;
+        load->kind = "load";
+        load->name = "bmp_load";
+        error = error || measure(config, run_load, &file, load);
+        remove(path);
+
+        if (error) {
+            fprintf(stderr, "[Error] Ошибка ввода-вывода: %s\n", path);
+            bmp_free(image);
+            return 1;
+        }
+        print_result(save);
+        print_result(load);
+        *count += 2;
+    }
+
+    for (int c = 0; c < BENCH_CHAIN_COUNT; c++) {
+        if (config->filter &&
+            !strstr(bench_chains[c], config->filter)) {
+            continue;
+        }
+
+        FilterContext job = { image, chains[c], execution };
+        BenchResult* result = &results[(*count)];
+        *result = base;
+        result->kind = "filter";
+        result->name = bench_chains[c];
+
+        if (measure(config, run_filter, &job, result) != 0) {
+            fprintf(
+                stderr,
+                "[Error] Ошибка применения цепочки '%s'\n",
+                bench_chains[c]
+            );
+            bmp_free(image);
+            return 1;
+        }
+        print_result(result);
+        (*count)++;
+    }
+
+    bmp_free(image);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    BenchConfig config;
+    if (parse_config(argc, argv, &config) != 0) {
+        fprintf(stderr, "[Error] Некорректные аргументы\n");
+        print_usage();
+        return 1;
+    }
+
+    Filter* chains[BENCH_CHAIN_COUNT] = { NULL };
+    for (int c = 0; c < BENCH_CHAIN_COUNT; c++) {
+        if (imagecraft_parse_chain(bench_chains[c], &chains[c]) !=
+            ALL_OK) {
+            return 1;
+        }
+    }
+
+    Execution execution = { NULL, 1, NULL, NULL, 0 };
+    if (config.threads != 1) {
+        execution.scheduler = scheduler_create(config.threads);
+    }
+
+    int capacity =
+        config.size_count * PATTERN_COUNT * (BENCH_CHAIN_COUNT + 2);
+    BenchResult* results =
+        (BenchResult*)malloc(capacity * sizeof(BenchResult));
+    int count = 0;
+    int error = !results;
+
+    for (int s = 0; !error && s < config.size_count; s++) {
+        for (int p = 0; !error && p < PATTERN_COUNT; p++) {
+            if (config.patterns[p]) {
+                error = bench_image(
+                    &config,
+                    (Pattern)p,
+                    config.sizes[s],
+                    chains,
+                    &execution,
+                    results,
+                    &count
+                );
+            }
+        }
+    }
+
+    if (!error) {
+        if (write_results(&config, results, count) != 0) {
+            fprintf(
+                stderr,
+                "[Error] Не удалось записать '%s'\n",
+                config.output
+            );
+            error = 1;
+        } else {
+            printf(
+                "[Info] Результаты (%d) записаны в '%s'\n",
+                count,
+                config.output
+            );
+        }
+    }
+
+    free(results);
+    scheduler_destroy(execution.scheduler);
+    for (int c = 0; c < BENCH_CHAIN_COUNT; c++) {
+        imagecraft_free_chain(chains[c]);
+    }
+    return error;
+}
@@ -0,0 +1,508 @@
+// Сравнение двух файлов результатов imagecraft_bench. Замедление
+// замера считается значимым, если медиана выросла больше порога,
+// а порог каждого замера не меньше его собственного разброса
+// между повторами. Изменившиеся контрольные суммы означают, что
+// оптимизация изменила пиксели результата.
+//
+// Коды возврата: 0 - регрессий нет, 1 - значимое замедление,
+// 2 - изменились результаты, 8 - замеров нет в новом файле
+// (1, 2 и 8 складываются), 4 - ошибка чтения
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define COMPARE_SLOWDOWN 1
+#define COMPARE_MISMATCH 2
+#define COMPARE_ERROR 4
+#define COMPARE_MISSING 8
+
+#define FIELD_SIZE 64
+
+// Замер из файла результатов
+typedef struct {
+    char kind[FIELD_SIZE];
+    char name[FIELD_SIZE];
+    char pattern[FIELD_SIZE];
+    char checksum[FIELD_SIZE];
+    int width;
+    int height;
+    int runs;
+    double median_ms;
+    double stddev_ms;
+} Benchmark;
+
+typedef struct {
+    Benchmark* items;
+    int count;
+    int capacity;
+} BenchmarkList;
+
+// Параметры сравнения
+typedef struct {
+    double threshold; // Минимальный значимый рост медианы (доля)
+    double sigma;     // Во сколько разбросов рост должен выходить
+    int check_checksums;
+    int allow_missing; // Пропавшие замеры не считаются ошибкой
+} CompareConfig;
+
+// ==================== РАЗБОР JSON ====================
+
+// Разбор ровно того JSON, который пишет imagecraft_bench (с
+// любыми пробелами): объекты массива "results" содержат строки
+// и числа, остальные поля пропускаются
+
+typedef struct {
+    const char* p;
+    int error;
+} Parser;
+
+static void skip_spaces(Parser* parser) {
+    while (isspace((unsigned char)*parser->p)) {
+        parser->p++;
+    }
+}
+
+static int expect(Parser* parser, char c) {
+    skip_spaces(parser);
+    if (*parser->p != c) {
+        parser->error = 1;
+        return 0;
+    }
+    parser->p++;
+    return 1;
+}
+
+// Чтение строки в buffer (обрезается по размеру)
+static void parse_string(Parser* parser, char* buffer, size_t size) {
+    size_t length = 0;
+    if (!expect(parser, '"')) {
+        return;
+    }
+
+    while (*parser->p && *parser->p != '"') {
+        char c = *parser->p++;
+        if (c == '\\' && *parser->p) {
+            c = *parser->p++;
+        }
+        if (buffer && length + 1 < size) {
+            buffer[length++] = c;
+        }
+    }
+    if (buffer) {
+        buffer[length] = '\0';
+    }
+    expect(parser, '"');
+}
+
+static void skip_value(Parser* parser);
+
+// Пропуск объекта или массива
+static void skip_container(Parser* parser, char open, char close) {
+    expect(parser, open);
+    skip_spaces(parser);
+    if (*parser->p == close) {
+        parser->p++;
+        return;
+    }
+
+    while (!parser->error) {
+        if (open == '{') {
+            parse_string(parser, NULL, 0);
+            expect(parser, ':');
+        }
+        skip_value(parser);
+
+        skip_spaces(parser);
+        if (*parser->p == ',') {
+            parser->p++;
+        } else {
+            expect(parser, close);
+            return;
+        }
+    }
+}
+
+static void skip_value(Parser* parser) {
+    skip_spaces(parser);
+    if (*parser->p == '"') {
+        parse_string(parser, NULL, 0);
+    } else if (*parser->p == '{') {
+        skip_container(parser, '{', '}');
+    } else if (*parser->p == '[') {
+        skip_container(parser, '[', ']');
+    } else {
+        char* end;
+        strtod(parser->p, &end);
+        if (end == parser->p) {
+            // true, false, null
+            while (isalpha((unsigned char)*parser->p)) {
+                parser->p++;
+            }
+            if (end == parser->p) {
+                parser->error = 1;
+            }
+        } else {
+            parser->p = end;
+        }
+    }
+}
+
+static double parse_number(Parser* parser) {
+    skip_spaces(parser);
+    char* end;
+    double value = strtod(parser->p, &end);
+    if (end == parser->p) {
+        parser->error = 1;
+    }
+    parser->p = end;
+    return value;
+}
+
+// Разбор одного замера
+static void parse_benchmark(Parser* parser, Benchmark* benchmark) {
+    memset(benchmark, 0, sizeof(*benchmark));
+    expect(parser, '{');
+
+    while (!parser->error) {
+        char key[FIELD_SIZE];
+        parse_string(parser, key, sizeof(key));
+        expect(parser, ':');
+
+        if (strcmp(key, "kind") == 0) {
+            parse_string(parser, benchmark->kind, FIELD_SIZE);
+        } else if (strcmp(key, "name") == 0) {
+            parse_string(parser, benchmark->name, FIELD_SIZE);
+        } else if (strcmp(key, "pattern") == 0) {
+            parse_string(parser, benchmark->pattern, FIELD_SIZE);
+        } else if (strcmp(key, "checksum") == 0) {
+            parse_string(parser, benchmark->checksum, FIELD_SIZE);
+        } else if (strcmp(key, "width") == 0) {
+            benchmark->width = (int)parse_number(parser);
+        } else if (strcmp(key, "height") == 0) {
+            benchmark->height = (int)parse_number(parser);
+        } else if (strcmp(key, "runs") == 0) {
+            benchmark->runs = (int)parse_number(parser);
+        } else if (strcmp(key, "median_ms") == 0) {
+            benchmark->median_ms = parse_number(parser);
+        } else if (strcmp(key, "stddev_ms") == 0) {
+            benchmark->stddev_ms = parse_number(parser);
+        } else {
+            skip_value(parser);
+        }
+
+        skip_spaces(parser);
+        if (*parser->p == ',') {
+            parser->p++;
+        } else {
+            expect(parser, '}');
+            return;
+        }
+    }
+}
+
+static int append_benchmark(
+    BenchmarkList* list,
+    const Benchmark* benchmark
+) {
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 64;
+        Benchmark* items = (Benchmark*)realloc(
+            list->items,
+            capacity * sizeof(Benchmark)
+        );
+        if (!items) {
+            return 1;
+        }
+        list->items = items;
+        list->capacity = capacity;
+    }
+    list->items[list->count++] = *benchmark;
+    return 0;
+}
+
+// Разбор массива результатов
+static void parse_results(Parser* parser, BenchmarkList* list) {
+    expect(parser, '[');
+    skip_spaces(parser);
+    if (*parser->p == ']') {
+        parser->p++;
+        return;
+    }
+
+    while (!parser->error) {
+        Benchmark benchmark;
+        parse_benchmark(parser, &benchmark);
+        if (!parser->error && append_benchmark(list, &benchmark)) {
+            parser->error = 1;
+        }
+
+        skip_spaces(parser);
+        if (*parser->p == ',') {
+            parser->p++;
+        } else {
+            expect(parser, ']');
+            return;
+        }
+    }
+}
+
+// Чтение файла результатов. Возвращает 0 при успехе
+static int load_results(const char* path, BenchmarkList* list) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return 1;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char* text = size >= 0 ? (char*)malloc(size + 1) : NULL;
+    if (!text || fread(text, 1, size, file) != (size_t)size) {
+        free(text);
+        fclose(file);
+        return 1;
+    }
+    text[size] = '\0';
+    fclose(file);
+
+    Parser parser = { text, 0 };
+    int found = 0;
+
+    expect(&parser, '{');
+    while (!parser.error) {
+        char key[FIELD_SIZE];
+        parse_string(&parser, key, sizeof(key));
+        expect(&parser, ':');
+
+        if (strcmp(key, "results") == 0) {
+            parse_results(&parser, list);
+            found = 1;
+        } else {
+            skip_value(&parser);
+        }
+
+        skip_spaces(&parser);
+        if (*parser.p == ',') {
+            parser.p++;
+        } else {
+            expect(&parser, '}');
+            break;
+        }
+    }
+
+    free(text);
+    return parser.error || !found;
+}
+
+// ==================== СРАВНЕНИЕ ====================
+
+static int same_benchmark(const Benchmark* a, const Benchmark* b) {
+    return strcmp(a->kind, b->kind) == 0 &&
+        strcmp(a->name, b->name) == 0 &&
+        strcmp(a->pattern, b->pattern) == 0 &&
+        a->width == b->width && a->height == b->height;
+}
+
+static const Benchmark*
+find_benchmark(const BenchmarkList* list, const Benchmark* key) {
+    for (int i = 0; i < list->count; i++) {
+        if (same_benchmark(&list->items[i], key)) {
+            return &list->items[i];
+        }
+    }
+    return NULL;
+}
+
+// Порог значимости замера: не меньше общего порога и не меньше
+// sigma разбросов времени обоих запусков относительно базовой
+// медианы
+static double noise_threshold(
+    const CompareConfig* config,
+    const Benchmark* base,
+    const Benchmark* candidate
+) {
+    double spread = sqrt(
+        base->stddev_ms * base->stddev_ms +
+        candidate->stddev_ms * candidate->stddev_ms
+    );
+    double noise = config->sigma * spread / base->median_ms;
+    return noise > config->threshold ? noise : config->threshold;
+}
+
+// Вывод text с дополнением пробелами до width символов UTF-8
+static void print_padded(const char* text, int width, int right) {
+    int length = 0;
+    for (const char* c = text; *c; c++) {
+        length += ((unsigned char)*c & 0xC0) != 0x80;
+    }
+
+    int padding = length < width ? width - length : 0;
+    if (right) {
+        printf(" %*s%s", padding, "", text);
+    } else {
+        printf(" %s%*s", text, padding, "");
+    }
+}
+
+static int compare(
+    const CompareConfig* config,
+    const BenchmarkList* base,
+    const BenchmarkList* candidate
+) {
+    int result = 0;
+    int slower = 0, faster = 0, changed = 0, missing = 0;
+
+    static const char* headers[] = { "Вид",    "Замер",
+                                     "Картинка", "Размер",
+                                     "Было, мс", "Стало, мс",
+                                     "Разница", "Порог" };
+    static const int widths[] = { 6, 22, 8, 11, 11, 11, 8, 8 };
+
+    printf("[Compare]");
+    for (int c = 0; c < 8; c++) {
+        print_padded(headers[c], widths[c], c >= 3);
+    }
+    printf("\n");
+
+    for (int i = 0; i < base->count; i++) {
+        const Benchmark* before = &base->items[i];
+        const Benchmark* after = find_benchmark(candidate, before);
+        if (!after) {
+            missing++;
+            continue;
+        }
+
+        char size[32];
+        snprintf(
+            size,
+            sizeof(size),
+            "%dx%d",
+            after->width,
+            after->height
+        );
+
+        double change = before->median_ms > 0.0
+            ? after->median_ms / before->median_ms - 1.0
+            : 0.0;
+        double threshold = before->median_ms > 0.0
+            ? noise_threshold(config, before, after)
+            : config->threshold;
+
+        const char* status = "";
+        if (change > threshold) {
+            status = "  ЗАМЕДЛЕНИЕ";
+            result |= COMPARE_SLOWDOWN;
+            slower++;
+        } else if (change < -threshold) {
+            status = "  ускорение";
+            faster++;
+        }
+
+        if (config->check_checksums &&
+            strcmp(before->checksum, after->checksum) != 0) {
+            status = "  ИЗМЕНИЛСЯ РЕЗУЛЬТАТ";
+            result |= COMPARE_MISMATCH;
+            changed++;
+        }
+
+        printf(
+            "          %-6s %-22s %-8s %11s %11.3f %11.3f %+7.1f%% "
+            "%7.1f%%%s\n",
+            after->kind,
+            after->name,
+            after->pattern,
+            size,
+            before->median_ms,
+            after->median_ms,
+            change * 100.0,
+            threshold * 100.0,
+            status
+        );
+    }
+
+    printf(
+        "[Info] Замедлений: %d, ускорений: %d, изменившихся "
+        "результатов: %d",
+        slower,
+        faster,
+        changed
+    );
+    if (missing > 0) {
+        printf(", нет в новом файле: %d", missing);
+    }
+    printf("\n");
+
+    // Пустой или оборванный файл замеров не должен проходить
+    // сравнение как отсутствие регрессий
+    if (missing > 0 && !config->allow_missing) {
+        result |= COMPARE_MISSING;
+    }
+
+    return result;
+}
+
+static void print_usage(void) {
+    printf(
+        "Использование: imagecraft_bench_compare <было.json> "
+        "<стало.json> [-threshold 0.05]\n"
+        "                                [-sigma 2] "
+        "[-ignore-checksums] [-allow-missing]\n"
+        "Коды возврата: 0 - регрессий нет, 1 - замедление, 2 - "
+        "изменились результаты,\n"
+        "               8 - замеров нет в новом файле "
+        "(1, 2 и 8 складываются), 4 - ошибка\n"
+    );
+}
+
+int main(int argc, char** argv) {
+    CompareConfig config = { 0.05, 2.0, 1, 0 };
+    const char* paths[2] = { NULL, NULL };
+    int path_count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-threshold") == 0 && i + 1 < argc) {
+            config.threshold = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-sigma") == 0 && i + 1 < argc) {
+            config.sigma = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-ignore-checksums") == 0) {
+            config.check_checksums = 0;
+        } else if (strcmp(argv[i], "-allow-missing") == 0) {
+            config.allow_missing = 1;
+        } else if (argv[i][0] != '-' && path_count < 2) {
+            paths[path_count++] = argv[i];
+        } else {
+            print_usage();
+            return COMPARE_ERROR;
+        }
+    }
+
+    if (path_count != 2 || config.threshold < 0.0 ||
+        config.sigma < 0.0) {
+        print_usage();
+        return COMPARE_ERROR;
+    }
+
+    BenchmarkList lists[2] = { { NULL, 0, 0 }, { NULL, 0, 0 } };
+    for (int f = 0; f < 2; f++) {
+        if (load_results(paths[f], &lists[f]) != 0) {
+            fprintf(
+                stderr,
+                "[Error] Не удалось прочитать результаты '%s'\n",
+                paths[f]
+            );
+            free(lists[0].items);
+            free(lists[1].items);
+            return COMPARE_ERROR;
+        }
+    }
+
+    int result = compare(&config, &lists[0], &lists[1]);
+
+    free(lists[0].items);
+    free(lists[1].items);
+    return result;
+}
@@ -28,6 +28,31 @@ if [ ! -f "assets/lenna.bmp" ]; then
     exit 1
 fi
 
+mkdir -p test
+FAILED=0
+
+# Проверка, что два результата совпадают побайтно
+check_same() {
+    if cmp -s "$1" "$2"; then
+        echo "[OK] $3"
+    else
+        echo "[FAIL] $3: $1 и $2 различаются"
+        FAILED=$((FAILED + 1))
+    fi
+}
+
+# Проверка, что команда завершается с ошибкой
+check_fails() {
+    local name="$1"
+    shift
+    if "$@" > /dev/null 2>&1; then
+        echo "[FAIL] $name: ожидалась ошибка"
+        FAILED=$((FAILED + 1))
+    else
+        echo "[OK] $name"
+    fi
+}
+
 echo "=== Тест 1: Обрезка 256x256 -> градации серого -> негатив ==="
 ./imagecraft assets/lenna.bmp test/test1.bmp -crop 256 256 -gs -neg
 echo ""
@@ -52,5 +77,121 @@ echo "=== Тест 6: ОГРОМНЫЕ значения для -crop (100000x100
 ./imagecraft assets/lenna.bmp test/test6.bmp -crop 100000 100000 -gs
 echo ""
 
+echo "=== Тест 7: Короткая и полная форма -crop ==="
+./imagecraft assets/lenna.bmp test/crop_short.bmp -crop 256 256 > /dev/null
+./imagecraft assets/lenna.bmp test/crop_full.bmp -crop 0 0 256 256 > /dev/null
+check_same test/crop_short.bmp test/crop_full.bmp "-crop w h == -crop 0 0 w h"
+echo ""
+
+echo "=== Тест 8: Обрезка обрезки складывает смещения ==="
+./imagecraft assets/lenna.bmp test/crop_chain.bmp -crop 100 100 300 300 -crop 20 30 50 40 > /dev/null
+./imagecraft assets/lenna.bmp test/crop_once.bmp -crop 120 130 50 40 > /dev/null
+check_same test/crop_chain.bmp test/crop_once.bmp "вложенные -crop"
+echo ""
+
+echo "=== Тест 9: Смещение за пределами изображения ==="
+check_fails "-crop 100000 0 10 10" ./imagecraft assets/lenna.bmp test/crop_out.bmp -crop 100000 0 10 10
+echo ""
+
+echo "=== Тест 10: Фильтры окрестности на вырезанной области ==="
+./imagecraft assets/lenna.bmp test/crop_region.bmp -crop 40 60 200 100 > /dev/null
+for chain in "-blur 2" "-med 3" "-sharp" "-edge 0.2"; do
+    ./imagecraft assets/lenna.bmp test/crop_view.bmp -crop 40 60 200 100 $chain > /dev/null
+    ./imagecraft test/crop_region.bmp test/crop_copy.bmp $chain > /dev/null
+    check_same test/crop_view.bmp test/crop_copy.bmp "-crop 40 60 200 100 $chain"
+done
+echo ""
+
+echo "=== Тест 11: Пакетный режим совпадает с отдельными запусками ==="
+rm -rf test/batch_in test/batch_out
+mkdir -p test/batch_in
+for size in 64 96 128 160; do
+    ./imagecraft assets/lenna.bmp test/batch_in/crop_$size.bmp -crop 10 20 $size $size > /dev/null
+done
+./imagecraft -batch test/batch_in test/batch_out -blur 1.5 -med 3 -threads 4 -jobs 2 > /dev/null
+for size in 64 96 128 160; do
+    ./imagecraft test/batch_in/crop_$size.bmp test/batch_single.bmp -blur 1.5 -med 3 > /dev/null
+    check_same test/batch_out/crop_$size.bmp test/batch_single.bmp "-batch crop_$size.bmp"
+done
+echo ""
+
+echo "=== Тест 12: Ошибочные файлы пакета не прерывают остальные ==="
+printf "%s\n" test/batch_in/crop_64.bmp test/batch_in/missing.bmp \
+    test/batch_in/crop_96.bmp > test/batch_list.txt
+rm -rf test/batch_fail
+if ./imagecraft -batch @test/batch_list.txt test/batch_fail/%i.bmp -neg > test/batch_fail.log 2>&1; then
+    echo "[FAIL] пакет с отсутствующим файлом завершился успешно"
+    FAILED=$((FAILED + 1))
+elif grep -q "Обработано изображений: 2 из 3" test/batch_fail.log &&
+     grep -q "Не удалось обработать файлов: 1" test/batch_fail.log &&
+     [ -f test/batch_fail/1.bmp ] && [ -f test/batch_fail/3.bmp ]; then
+    echo "[OK] отсутствующий файл посчитан, остальные обработаны"
+else
+    echo "[FAIL] неверный итог пакета с отсутствующим файлом"
+    FAILED=$((FAILED + 1))
+fi
+echo ""
+
+echo "=== Тест 13: Конвейер пакета сохраняет порядок входов ==="
+order="160 64 128 96 64 160"
+for size in $order; do
+    echo test/batch_in/crop_$size.bmp
+done > test/batch_order.txt
+for extra in "-jobs 1" "-jobs 4 -threads 4" "-jobs 4 -io-uring 4"; do
+    rm -rf test/batch_order
+    ./imagecraft -batch @test/batch_order.txt test/batch_order/%i.bmp -sharp $extra > /dev/null
+    index=1
+    for size in $order; do
+        ./imagecraft test/batch_in/crop_$size.bmp test/batch_single.bmp -sharp > /dev/null
+        check_same test/batch_order/$index.bmp test/batch_single.bmp "$extra: %i=$index <- crop_$size.bmp"
+        index=$((index + 1))
+    done
+done
+echo ""
+
+echo "=== Тест 14: -multi совпадает с отдельными запусками ==="
+./imagecraft -multi assets/lenna.bmp \
+    -o test/multi_thumb.bmp -blur 2 -crop 64 64 \
+    -o test/multi_gray.bmp -blur 2 -gs \
+    -o test/multi_edge.bmp -blur 2 -edge 0.2 \
+    -o test/multi_plain.bmp > /dev/null
+./imagecraft assets/lenna.bmp test/multi_single.bmp -blur 2 -crop 64 64 > /dev/null
+check_same test/multi_thumb.bmp test/multi_single.bmp "-multi -blur 2 -crop 64 64"
+./imagecraft assets/lenna.bmp test/multi_single.bmp -blur 2 -gs > /dev/null
+check_same test/multi_gray.bmp test/multi_single.bmp "-multi -blur 2 -gs"
+./imagecraft assets/lenna.bmp test/multi_single.bmp -blur 2 -edge 0.2 > /dev/null
+check_same test/multi_edge.bmp test/multi_single.bmp "-multi -blur 2 -edge 0.2"
+./imagecraft assets/lenna.bmp test/multi_single.bmp > /dev/null
+check_same test/multi_plain.bmp test/multi_single.bmp "-multi без фильтров"
+echo ""
+
+echo "=== Тест 15: Результат из кэша совпадает с обработкой ==="
+rm -rf test/cache
+./imagecraft assets/lenna.bmp test/cache_plain.bmp -blur 1.5 -neg > /dev/null
+./imagecraft assets/lenna.bmp test/cache_first.bmp -blur 1.5 -neg -cache test/cache > /dev/null
+./imagecraft assets/lenna.bmp test/cache_hit.bmp -blur 1.5 -neg -cache test/cache > test/cache.log
+if grep -q "Результат взят из кэша" test/cache.log; then
+    echo "[OK] повторный запуск берет результат из кэша"
+else
+    echo "[FAIL] повторный запуск не попал в кэш"
+    FAILED=$((FAILED + 1))
+fi
+check_same test/cache_first.bmp test/cache_plain.bmp "-cache, первый запуск"
+check_same test/cache_hit.bmp test/cache_plain.bmp "-cache, попадание"
+
+# Те же пиксели с другим разрешением в заголовке: заголовок
+# копируется в результат, поэтому запись кэша не должна подойти
+cp assets/lenna.bmp test/cache_dpi.bmp
+printf '\x5a' | dd of=test/cache_dpi.bmp bs=1 seek=38 conv=notrunc 2> /dev/null
+./imagecraft test/cache_dpi.bmp test/cache_dpi_plain.bmp -blur 1.5 -neg > /dev/null
+./imagecraft test/cache_dpi.bmp test/cache_dpi_hit.bmp -blur 1.5 -neg -cache test/cache > /dev/null
+check_same test/cache_dpi_hit.bmp test/cache_dpi_plain.bmp "-cache, другой заголовок"
+echo ""
+
 echo "=== Все тесты завершены ==="
 echo "Результаты сохранены в test/"
+
+if [ "$FAILED" -ne 0 ]; then
+    echo "Провалено проверок: $FAILED"
+    exit 1
+fi